@@ -0,0 +1,808 @@
+#ifndef ASSET_MANAGER_HPP
+#define ASSET_MANAGER_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include "MeshCache.hpp"
+#include "MeshOptimize.hpp"
+#include "CompactVertex.hpp"
+#include "BmpLoader.hpp"
+#include "TextureCompress.hpp"
+#include "WorkerPool.hpp"
+#include "Frustum.hpp"
+#include "GLHandle.hpp"
+#include "MeshArena.hpp"
+
+// Size in texels above which the mip levels of a streamed texture are loaded on demand (see
+// AssetManager::textureBudget); the levels this size and smaller are uploaded with the texture and always stay.
+#define TEXTURE_STREAM_TAIL 64
+
+// A texture on the GPU with its full mip chain, RGBA8 or S3TC compressed. An array texture holds one layer per
+// source file, all of the same size, so meshes using different files can be drawn with one texture bound.
+// A streamed texture has only its coarser levels on the GPU at first; GL_TEXTURE_BASE_LEVEL is kept at the
+// finest level it holds, so sampling never reaches a level that isn't there.
+struct TextureAsset {
+    GLTexture id;
+    GLenum target = GL_TEXTURE_2D; // GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY
+    uint32_t width = 0, height = 0;
+    GLenum internalFormat = GL_RGBA8;
+    std::vector<std::string> layers; // Source file of each layer of an array texture
+    uint32_t mipCount = 1;
+    size_t gpuBytes = 0; // When it was loaded; levels streamed in later are counted by the AssetManager
+
+    // The layer of an array texture holding the file at 'path', or -1 if it has none.
+    int layer(const std::string& path) const {
+        auto it = std::find(layers.begin(), layers.end(), path);
+        return it != layers.end() ? (int)(it - layers.begin()) : -1;
+    }
+};
+
+// A mesh on the GPU in its compact form (see CompactVertex.hpp). Its VAO feeds the position to attribute 0,
+// the octahedral normal to attribute 1, the texture coordinates to attribute 2 and the array texture layer to
+// attribute 3 (an unsigned integer), and has the index buffer bound. Only the meshlets stay on the CPU, for culling.
+// A mesh in the shared buffers of a MeshArena (see AssetManager::shareMeshBuffers) has no VAO or buffers of its
+// own; it is read through the arena's VAO, its vertices from 'baseVertex' and its indices from 'firstIndex'.
+struct MeshAsset {
+    GLVertexArray vao;
+    GLBuffer vertexBuffer, indexBuffer;
+    MeshArena* arena = NULL;
+    MeshArena::Range arenaRange;
+    GLint baseVertex = 0;
+    GLuint firstIndex = 0; // In indices of 'indexSize' bytes
+    GLsizei indexCount = 0;
+    GLsizei indexSize = 4; // Bytes per index
+    GLenum indexType = GL_UNSIGNED_INT;
+    glm::vec3 positionOffset = glm::vec3(0.0f), positionScale = glm::vec3(1.0f); // See CompactMesh
+    std::vector<Meshlet> meshlets;
+    size_t gpuBytes = 0;
+
+    MeshAsset() = default;
+    MeshAsset(const MeshAsset&) = delete;
+    MeshAsset& operator=(const MeshAsset&) = delete;
+    // Gives the mesh's room in the arena back
+    ~MeshAsset() {
+        if (arena != NULL) {
+            arena->release(arenaRange);
+        }
+    }
+};
+
+// A linked shader program.
+struct ProgramAsset {
+    GLProgram id;
+};
+
+// Shared, reference-counted handles to assets. An asset is deleted, on the CPU and the GPU, when its last
+// handle goes away: its GL objects are owned by the GLObject members above (see GLHandle.hpp). An empty
+// handle means the asset couldn't be loaded.
+typedef std::shared_ptr<const TextureAsset> TextureHandle;
+typedef std::shared_ptr<const MeshAsset> MeshHandle;
+typedef std::shared_ptr<const ProgramAsset> ProgramHandle;
+
+// Whether an asset loading in the background has been delivered (see AssetManager::update()); its handle is
+// then pending.get(), empty if the asset couldn't be loaded.
+template <typename Handle>
+inline bool isLoaded(const std::shared_future<Handle>& pending) {
+    return pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+// How many pixels wide a texture mapped once over 'mesh' appears on screen, to pass to
+// AssetManager::requestTexture(): the mesh's diameter seen at the distance of its closest cluster inside
+// 'frustum' (built from the mesh's MVP matrix, so its eye is in mesh space). 'focalPixels' is the viewport
+// height divided by 2 tan(fovY / 2) and 'nearDistance' the near plane distance. 0 if no cluster is in view.
+inline float textureDemand(const MeshAsset& mesh, const Frustum& frustum, float focalPixels, float nearDistance) {
+    float closest = FLT_MAX;
+    for (const Meshlet& meshlet : mesh.meshlets) {
+        if (frustum.intersectsSphere(meshlet.center, meshlet.radius)) {
+            closest = std::min(closest, glm::length(meshlet.center - frustum.eye) - meshlet.radius);
+        }
+    }
+    if (closest == FLT_MAX || !frustum.hasEye) {
+        return 0.0f;
+    }
+    return glm::length(mesh.positionScale) * focalPixels / std::max(closest, nearDistance);
+}
+
+// Loads textures, meshes and shader programs once per path, however many objects use them, and hands out
+// shared handles to them.
+//
+// Meshes and textures go through the MeshCache as separate entries, so a texture shared by several meshes is
+// baked, mapped and uploaded once. Textures are baked compressed with their mip chain, so uploading one is a
+// glCompressedTexImage2D call per level straight from the mapping. Everything read from disk is released as
+// soon as it is on the GPU; what stays resident is reported by printResidency(). The manager must outlive
+// every handle it gave out, and the GL context must be current whenever an asset is loaded or its last
+// handle released.
+//
+// Meshes and textures can also be loaded in the background (meshAsync(), textureAsync(), textureArrayAsync()).
+// Reading, parsing and baking then run on a pool of worker threads, while the GL objects are created on the
+// main thread by update(), which a program calls once per frame; frames go on being drawn in the meantime.
+//
+// With a textureBudget, textures are streamed: each starts with only its levels of TEXTURE_STREAM_TAIL texels
+// and smaller, and finer levels are read on the worker threads and uploaded one at a time as the frames ask
+// for them through requestTexture(). When the finer levels of all textures would exceed the budget, those of
+// the textures used least recently are dropped first.
+class AssetManager {
+    public:
+        AssetManager() = default;
+        AssetManager(const AssetManager&) = delete;
+        AssetManager& operator=(const AssetManager&) = delete;
+
+        // Stops the worker threads first, since their jobs refer to the manager. Loads still queued are
+        // dropped and their futures report a broken promise.
+        ~AssetManager() {
+            workers.reset();
+        }
+
+        // Whether textures are baked compressed: BC1, or BC3 for those with any transparency. Takes effect
+        // for textures baked from then on; a cached texture in the other form is baked again.
+        bool compressTextures = true;
+
+        // Whether meshes are uploaded into the shared buffers of one MeshArena instead of buffers of their own, so
+        // that a MeshBatch can draw many of them with one call. Applies to meshes loaded from then on.
+        bool shareMeshBuffers = false;
+
+        // Most bytes the streamed textures may hold on the GPU, or 0 to load every texture with all of its levels.
+        // Applies to textures loaded from then on. Their tail levels always stay, even beyond the budget.
+        size_t textureBudget = 0;
+
+        // The texture in the BMP file at 'path', with every mip level.
+        TextureHandle texture(const std::string& path) {
+            if (TextureHandle existing = find(textures, path)) {
+                return existing;
+            }
+            PreparedTexture prepared = prepareTexture({path}, false, compressTextures);
+            return uploadTexture(path, prepared, {path}, GL_TEXTURE_2D);
+        }
+
+        // An array texture (GL_TEXTURE_2D_ARRAY) with the BMP files at 'paths' as its layers, in that order,
+        // each with every mip level. All layers are scaled to the largest width and height among the files,
+        // and all are compressed to BC3 if any of them has transparency. The array is baked as one entry.
+        TextureHandle textureArray(const std::vector<std::string>& paths) {
+            std::string key = arrayKey(paths);
+            if (TextureHandle existing = find(textures, key)) {
+                return existing;
+            }
+            PreparedTexture prepared = prepareTexture(paths, true, compressTextures);
+            return uploadTexture(key, prepared, paths, GL_TEXTURE_2D_ARRAY);
+        }
+
+        // The mesh in the PLY file at 'path'. On a cache miss it is parsed with 'read' (called as
+        // read(path, vertices, triangles) with a std::vector<Vertex> and a std::vector<Tri>), optimized
+        // (see optimizeMesh()) and quantized. 'Vertex' has its position as three floats at offset 0, its
+        // normal at 'normalOffset' and its texture coordinates at 'uvOffset'. Every vertex is given 'layer' as
+        // its array texture layer; the baked copy keeps layer 0, so a mesh used with another layer is uploaded
+        // again for it.
+        template <typename Vertex, typename Tri, typename Read>
+        MeshHandle mesh(const std::string& path, Read read, size_t normalOffset, size_t uvOffset, uint16_t layer = 0) {
+            std::string key = meshKey(path, layer);
+            if (MeshHandle existing = find(meshes, key)) {
+                return existing;
+            }
+            PreparedMesh prepared = prepareMesh<Vertex, Tri>(path, read, normalOffset, uvOffset);
+            return uploadMesh(key, prepared, layer);
+        }
+
+        // texture(), textureArray() and mesh() in the background: the files are read, parsed and baked on a
+        // worker thread, and the next update() after that uploads the asset and delivers its handle to the
+        // returned future. Asking for an asset that is already loading returns the same future.
+        std::shared_future<TextureHandle> textureAsync(const std::string& path) {
+            bool compress = compressTextures;
+            return loadAsync(textures, pendingTextures, path, [this, path, compress]() -> std::function<TextureHandle()> {
+                std::shared_ptr<PreparedTexture> prepared = std::make_shared<PreparedTexture>(prepareTexture({path}, false, compress));
+                return [this, path, prepared]() { return uploadTexture(path, *prepared, {path}, GL_TEXTURE_2D); };
+            });
+        }
+        std::shared_future<TextureHandle> textureArrayAsync(const std::vector<std::string>& paths) {
+            std::string key = arrayKey(paths);
+            bool compress = compressTextures;
+            return loadAsync(textures, pendingTextures, key, [this, key, paths, compress]() -> std::function<TextureHandle()> {
+                std::shared_ptr<PreparedTexture> prepared = std::make_shared<PreparedTexture>(prepareTexture(paths, true, compress));
+                return [this, key, paths, prepared]() { return uploadTexture(key, *prepared, paths, GL_TEXTURE_2D_ARRAY); };
+            });
+        }
+        template <typename Vertex, typename Tri, typename Read>
+        std::shared_future<MeshHandle> meshAsync(const std::string& path, Read read, size_t normalOffset, size_t uvOffset, uint16_t layer = 0) {
+            std::string key = meshKey(path, layer);
+            return loadAsync(meshes, pendingMeshes, key, [this, key, path, read, normalOffset, uvOffset, layer]() -> std::function<MeshHandle()> {
+                std::shared_ptr<PreparedMesh> prepared = std::make_shared<PreparedMesh>(prepareMesh<Vertex, Tri>(path, read, normalOffset, uvOffset));
+                return [this, key, prepared, layer]() { return uploadMesh(key, *prepared, layer); };
+            });
+        }
+
+        // Uploads every background load whose files have been read since the last call, and delivers its handle.
+        // Must be called on the main thread, with the GL context current; once per frame is enough.
+        // Also streams the levels of streamed textures that the last frame asked for, and drops those that no
+        // longer fit the budget.
+        void update() {
+            std::vector<std::function<void()>> ready;
+            {
+                std::lock_guard<std::mutex> lock(finishedMutex);
+                ready.swap(finished);
+            }
+            for (std::function<void()>& upload : ready) {
+                upload();
+            }
+            streamTextures();
+            frame++;
+        }
+
+        // Asks for 'texture' to be sharp enough to cover 'pixels' pixels across on screen (see textureDemand()),
+        // for the frame being drawn. A frame asks for every streamed texture it draws, once per object using it;
+        // the sharpest request counts. Does nothing for textures that aren't streamed.
+        void requestTexture(const TextureHandle& texture, float pixels) {
+            auto it = texture ? streamed.find(texture.get()) : streamed.end();
+            if (it == streamed.end()) {
+                return;
+            }
+            StreamedTexture& stream = it->second;
+            // One level coarser for every halving of the texels needed, as the GPU picks levels
+            float texels = (float)std::max(texture->width, texture->height);
+            uint32_t level = pixels <= 0.0f ? stream.tailLevel
+                : (uint32_t)std::min<float>((float)stream.tailLevel, std::max(0.0f, std::floor(std::log2(texels / pixels))));
+            stream.requestedLevel = std::min(stream.requestedLevel, level);
+            stream.lastUsed = frame;
+        }
+
+        // Number of background loads not delivered yet.
+        size_t pendingLoads() const {
+            return pendingTextures.size() + pendingMeshes.size();
+        }
+
+        // The program named 'key' (e.g. the paths of its shader files), linked by 'build' the first time it
+        // is asked for. 'build' returns 0 on failure.
+        ProgramHandle program(const std::string& key, const std::function<GLuint()>& build) {
+            if (ProgramHandle existing = find(programs, key)) {
+                return existing;
+            }
+            GLuint id = build();
+            if (id == 0) {
+                return ProgramHandle();
+            }
+            ProgramAsset* asset = new ProgramAsset();
+            asset->id.reset(id);
+            return share(programs, key, asset, 0, 0);
+        }
+
+        // Bytes held by live assets: on the CPU (meshlets kept for culling) and on the GPU (vertices, indices
+        // and texture mip levels; programs aren't counted).
+        size_t residentCpuBytes() const { return cpuBytes; }
+        size_t residentGpuBytes() const { return gpuBytes; }
+
+        // Bytes the streamed textures hold on the GPU, to compare with textureBudget.
+        size_t streamedGpuBytes() const { return streamedBytes; }
+
+        // Prints how many assets are loaded and the bytes they hold.
+        void printResidency() const {
+            printf("Assets: %zu meshes, %zu textures, %zu programs; %.1f KB on the CPU, %.1f KB on the GPU\n",
+                   live(meshes), live(textures), live(programs), cpuBytes / 1024.0, gpuBytes / 1024.0);
+            if (arena) {
+                printf("Mesh arena: %.1f KB used of %.1f KB on the GPU\n", arena->usedBytes() / 1024.0, arena->capacityBytes() / 1024.0);
+            }
+            if (textureBudget > 0) {
+                printf("Streamed textures: %zu, %.1f KB on the GPU of a %.1f KB budget\n", streamed.size(),
+                       streamedBytes / 1024.0, textureBudget / 1024.0);
+            }
+        }
+
+    private:
+        // What a mesh load reads from disk, before anything is on the GPU: its mapped cache entry, or the
+        // compact mesh itself if the entry couldn't be written.
+        struct PreparedMesh {
+            MeshCache cache;
+            CompactMesh compact;
+        };
+
+        // What a texture load reads from disk: its mapped cache entry, or the decoded texels (the layers of an
+        // array one after another) if the entry couldn't be written. 'loaded' is false if a file couldn't be read.
+        struct PreparedTexture {
+            MeshCache cache;
+            std::vector<unsigned char> texels;
+            unsigned int width = 0, height = 0;
+            bool loaded = false;
+        };
+
+        std::map<std::string, std::weak_ptr<const TextureAsset>> textures;
+        std::map<std::string, std::weak_ptr<const MeshAsset>> meshes;
+        std::map<std::string, std::weak_ptr<const ProgramAsset>> programs;
+        size_t cpuBytes = 0, gpuBytes = 0;
+
+        // Background loads, by key, whose handles haven't been delivered yet. Only used on the main thread.
+        std::map<std::string, std::shared_future<TextureHandle>> pendingTextures;
+        std::map<std::string, std::shared_future<MeshHandle>> pendingMeshes;
+        // Uploads of background loads whose files have been read, waiting for update().
+        std::vector<std::function<void()>> finished;
+        std::mutex finishedMutex;
+        // Started by the first background load.
+        std::unique_ptr<WorkerPool> workers;
+        // Created by the first mesh loaded with shareMeshBuffers.
+        std::unique_ptr<MeshArena> arena;
+
+        // The mip levels a streamed texture has on the GPU and wants there. Its cache entry stays mapped, so
+        // levels can be read again after being dropped.
+        struct StreamedTexture {
+            std::weak_ptr<const TextureAsset> texture;
+            std::shared_ptr<MeshCache> cache;
+            bool compressed = false; // Uploaded as stored; otherwise decoded to RGBA8 first
+            uint32_t tailLevel = 0; // First level of TEXTURE_STREAM_TAIL texels or smaller; it and all after it stay
+            uint32_t residentLevel = 0; // Finest level on the GPU; every level after it is there too
+            uint32_t requestedLevel = 0; // Finest level asked for by requestTexture() in the current frame
+            uint32_t neededLevel = 0; // The same for the last complete frame
+            bool streaming = false; // A level is being read on a worker thread
+            uint64_t lastUsed = 0; // Last frame that asked for the texture
+            size_t bytes = 0; // On the GPU, tail included
+            size_t streamedBytes = 0; // On the GPU, tail excluded: what the asset's gpuBytes doesn't count
+        };
+        // Streamed textures by asset; entries of released assets are dropped by the next update().
+        std::map<const TextureAsset*, StreamedTexture> streamed;
+        size_t streamedBytes = 0; // Sum of their 'bytes'
+        uint64_t frame = 0; // Number of update() calls
+
+        static std::string meshKey(const std::string& path, uint16_t layer) {
+            return layer == 0 ? path : path + "\n" + std::to_string(layer);
+        }
+        static std::string arrayKey(const std::vector<std::string>& paths) {
+            std::string key = "array";
+            for (const std::string& path : paths) {
+                key += "\n" + path;
+            }
+            return key;
+        }
+
+        // Reads the mesh at 'path' from its cache entry, baking the entry first if it is missing or stale.
+        // Touches nothing but the files, so it can run on any thread.
+        template <typename Vertex, typename Tri, typename Read>
+        static PreparedMesh prepareMesh(const std::string& path, Read read, size_t normalOffset, size_t uvOffset) {
+            std::vector<std::string> sources = {path};
+            PreparedMesh prepared;
+            if (!prepared.cache.open(sources, sizeof(CompactVertex))) {
+                std::vector<Vertex> vertices;
+                std::vector<Tri> triangles;
+                read(path, vertices, triangles);
+                std::vector<Meshlet> meshlets;
+                optimizeMesh(path.c_str(), vertices.data(), sizeof(Vertex), vertices.size(),
+                             reinterpret_cast<uint32_t*>(triangles.data()), triangles.size() * 3, meshlets);
+                prepared.compact = compactMesh(vertices.data(), sizeof(Vertex), vertices.size(), normalOffset, uvOffset,
+                                               reinterpret_cast<const uint32_t*>(triangles.data()), triangles.size() * 3, std::move(meshlets));
+                if (MeshCache::bake(sources, prepared.compact, NULL, 0, 0, 0)) {
+                    prepared.cache.open(sources, sizeof(CompactVertex));
+                }
+            }
+            return prepared;
+        }
+
+        // Creates the GL objects of a prepared mesh and records it as the asset 'key', unless a load that
+        // finished first already did.
+        MeshHandle uploadMesh(const std::string& key, PreparedMesh& prepared, uint16_t layer) {
+            if (MeshHandle existing = find(meshes, key)) {
+                return existing;
+            }
+
+            // Straight from the cache mapping, or from the compact mesh if the cache couldn't be written
+            const MeshCache& cache = prepared.cache;
+            CompactMesh& compact = prepared.compact;
+            MeshAsset* asset = new MeshAsset();
+            const void* vertexData = cache.isOpen() ? cache.vertices() : compact.vertices.data();
+            size_t vertexCount = cache.isOpen() ? cache.vertexCount() : compact.vertices.size();
+            const void* indexData = cache.isOpen() ? cache.indices() : compact.indices.data();
+            asset->indexCount = (GLsizei)(cache.isOpen() ? cache.indexCount() : compact.indexCount);
+            asset->indexSize = (GLsizei)(cache.isOpen() ? cache.indexSize() : compact.indexSize);
+            asset->indexType = asset->indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            asset->positionOffset = cache.isOpen() ? cache.positionOffset() : compact.positionOffset;
+            asset->positionScale = cache.isOpen() ? cache.positionScale() : compact.positionScale;
+            if (cache.isOpen()) {
+                asset->meshlets.assign(cache.meshlets(), cache.meshlets() + cache.meshletCount());
+            } else {
+                asset->meshlets = std::move(compact.meshlets);
+            }
+            std::vector<CompactVertex> layered;
+            if (layer != 0) {
+                layered.assign(static_cast<const CompactVertex*>(vertexData), static_cast<const CompactVertex*>(vertexData) + vertexCount);
+                for (CompactVertex& vertex : layered) {
+                    vertex.layer = layer;
+                }
+                vertexData = layered.data();
+            }
+
+            size_t indexBytes = (size_t)asset->indexSize * asset->indexCount;
+            if (shareMeshBuffers) {
+                // Into the shared buffers, where the indices stay relative to the mesh's first vertex
+                if (!arena) {
+                    arena.reset(new MeshArena());
+                }
+                asset->arena = arena.get();
+                asset->arenaRange = arena->allocate(vertexCount, indexBytes);
+                asset->baseVertex = (GLint)asset->arenaRange.firstVertex;
+                asset->firstIndex = (GLuint)(asset->arenaRange.indexOffset / asset->indexSize);
+                arena->upload(asset->arenaRange, vertexData, indexData, indexBytes);
+            } else {
+                asset->vao = GLVertexArray::create();
+                glBindVertexArray(asset->vao);
+                asset->vertexBuffer = GLBuffer::create();
+                glBindBuffer(GL_ARRAY_BUFFER, asset->vertexBuffer);
+                glBufferData(GL_ARRAY_BUFFER, sizeof(CompactVertex) * vertexCount, vertexData, GL_STATIC_DRAW);
+                setCompactVertexAttributes();
+                asset->indexBuffer = GLBuffer::create();
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, asset->indexBuffer);
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexData, GL_STATIC_DRAW);
+                glBindVertexArray(0);
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+            }
+
+            asset->gpuBytes = sizeof(CompactVertex) * vertexCount + (size_t)asset->indexSize * asset->indexCount;
+            size_t cpuBytes = asset->meshlets.size() * sizeof(Meshlet);
+            return share(meshes, key, asset, cpuBytes, asset->gpuBytes);
+        }
+
+
+        // Reads the texture, or array texture, of the BMP files at 'paths' from its cache entry. The files are
+        // baked into one entry on the first load (or when the entry is in the other form than 'compress' asks
+        // for). Touches nothing but the files, so it can run on any thread.
+        static PreparedTexture prepareTexture(const std::vector<std::string>& paths, bool array, bool compress) {
+            uint32_t layerCount = (uint32_t)paths.size();
+            PreparedTexture prepared;
+            MeshCache& cache = prepared.cache;
+            if (!cache.open(paths, sizeof(CompactVertex)) || (cache.textureFormat() != TEXTURE_RGBA8) != compress
+                || cache.textureLayers() != layerCount) {
+                std::vector<unsigned char>& texels = prepared.texels;
+                if (array ? !loadBMPLayers(paths, texels, prepared.width, prepared.height)
+                          : !loadBMP(paths[0], texels, prepared.width, prepared.height)) {
+                    return prepared;
+                }
+                // Baked with no vertices, so a texture's entry doesn't depend on the meshes using it
+                TextureFormat format = compress ? compressedFormat(texels.data(), (size_t)prepared.width * prepared.height * layerCount) : TEXTURE_RGBA8;
+                if (MeshCache::bake(paths, CompactMesh(), texels.data(), prepared.width, prepared.height, 4, format, layerCount)) {
+                    cache.open(paths, sizeof(CompactVertex));
+                }
+            }
+            prepared.loaded = true;
+            return prepared;
+        }
+
+        // Creates the GL texture ('target' is GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY) of a prepared texture and
+        // records it as the asset 'key', unless a load that finished first already did. Each mip level is
+        // uploaded straight from the cache entry; a streamed texture keeps the entry to read its finer levels later.
+        TextureHandle uploadTexture(const std::string& key, PreparedTexture& prepared, const std::vector<std::string>& paths, GLenum target) {
+            if (TextureHandle existing = find(textures, key)) {
+                return existing;
+            }
+            if (!prepared.loaded) {
+                return TextureHandle();
+            }
+
+            bool array = target == GL_TEXTURE_2D_ARRAY;
+            uint32_t layerCount = (uint32_t)paths.size();
+            MeshCache& cache = prepared.cache;
+            const std::vector<unsigned char>& texels = prepared.texels;
+            unsigned int width = prepared.width, height = prepared.height;
+
+            TextureAsset* asset = new TextureAsset();
+            asset->target = target;
+            if (array) {
+                asset->layers = paths;
+            }
+            asset->id = GLTexture::create();
+            glBindTexture(target, asset->id);
+            uint32_t firstLevel = 0;
+            bool compressed = false;
+            if (cache.isOpen() && cache.mipCount() > 0) {
+                // Every mip level is stored already, tightly packed, with the layers of an array one after another
+                asset->width = cache.mipWidth(0);
+                asset->height = cache.mipHeight(0);
+                asset->mipCount = cache.mipCount();
+                TextureFormat format = cache.textureFormat();
+                compressed = format != TEXTURE_RGBA8 && GLEW_EXT_texture_compression_s3tc;
+                if (compressed) {
+                    asset->internalFormat = format == TEXTURE_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+                }
+                // A streamed texture starts with its tail; sampling starts at its first level
+                while (textureBudget > 0 && firstLevel + 1 < cache.mipCount()
+                       && std::max(cache.mipWidth(firstLevel), cache.mipHeight(firstLevel)) > TEXTURE_STREAM_TAIL) {
+                    firstLevel++;
+                }
+                std::vector<unsigned char> decoded;
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                for (uint32_t level = firstLevel; level < cache.mipCount(); level++) {
+                    size_t bytes = 0;
+                    const unsigned char* data = levelData(cache, level, compressed, decoded, bytes);
+                    uploadLevel(*asset, compressed, level, cache.mipWidth(level), cache.mipHeight(level), cache.textureLayers(), bytes, data);
+                    asset->gpuBytes += bytes;
+                }
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, firstLevel);
+                glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, cache.mipCount() - 1);
+            } else {
+                asset->width = width;
+                asset->height = height;
+                uploadRGBA(target, 0, width, height, layerCount, texels.data());
+                glGenerateMipmap(target);
+                for (uint32_t w = width, h = height; ; w = std::max(1u, w / 2), h = std::max(1u, h / 2)) {
+                    asset->gpuBytes += (size_t)w * h * 4 * layerCount;
+                    if (w == 1 && h == 1) {
+                        break;
+                    }
+                }
+            }
+            glBindTexture(target, 0);
+
+            TextureHandle handle = share(textures, key, asset, 0, asset->gpuBytes);
+            if (firstLevel > 0) {
+                // The released texture that had the same address, if update() hasn't forgotten it yet
+                forgetReleased();
+                StreamedTexture& stream = streamed[asset];
+                stream.texture = handle;
+                stream.cache = std::make_shared<MeshCache>(std::move(cache));
+                stream.compressed = compressed;
+                stream.tailLevel = stream.residentLevel = stream.requestedLevel = stream.neededLevel = firstLevel;
+                stream.lastUsed = frame;
+                stream.bytes = asset->gpuBytes;
+                streamedBytes += stream.bytes;
+            }
+            return handle;
+        }
+
+        // Mip 'level' of a texture's cache entry, all layers one after another, as it is uploaded: the stored
+        // blocks if 'compressed', otherwise RGBA8 texels, which are decoded into 'decoded' if the entry holds
+        // blocks (no S3TC support). Points into the mapping or into 'decoded'; 'bytes' is set to its size.
+        static const unsigned char* levelData(const MeshCache& cache, uint32_t level, bool compressed,
+                                              std::vector<unsigned char>& decoded, size_t& bytes) {
+            uint32_t w = cache.mipWidth(level), h = cache.mipHeight(level), layers = cache.textureLayers();
+            const unsigned char* data = cache.mip(level);
+            bytes = compressed ? cache.mipBytes(level) * layers : (size_t)w * h * 4 * layers;
+            if (!compressed && cache.textureFormat() != TEXTURE_RGBA8) {
+                decoded.resize(bytes);
+                for (uint32_t layer = 0; layer < layers; layer++) {
+                    decompressTexture(data + cache.mipBytes(level) * layer, w, h, cache.textureFormat(), decoded.data() + (size_t)w * h * 4 * layer);
+                }
+                data = decoded.data();
+            }
+            return data;
+        }
+
+        // Uploads mip 'level' of the bound 'texture' from data returned by levelData(). A level of size zero
+        // (with 'data' NULL) frees the level's storage instead.
+        static void uploadLevel(const TextureAsset& texture, bool compressed, GLint level, uint32_t width, uint32_t height,
+                                uint32_t layers, size_t bytes, const unsigned char* data) {
+            if (!compressed) {
+                uploadRGBA(texture.target, level, width, height, layers, data);
+            } else if (texture.target == GL_TEXTURE_2D_ARRAY) {
+                glCompressedTexImage3D(texture.target, level, texture.internalFormat, width, height, layers, 0, (GLsizei)bytes, data);
+            } else {
+                glCompressedTexImage2D(texture.target, level, texture.internalFormat, width, height, 0, (GLsizei)bytes, data);
+            }
+        }
+
+        // Uploads one RGBA8 mip level of a 2D texture, or of every layer of an array texture.
+        static void uploadRGBA(GLenum target, GLint level, uint32_t width, uint32_t height, uint32_t layers, const unsigned char* texels) {
+            if (target == GL_TEXTURE_2D_ARRAY) {
+                glTexImage3D(target, level, GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+            } else {
+                glTexImage2D(target, level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+            }
+        }
+
+        // Starts loading the asset 'key' of 'pool' in the background, unless it is loaded or loading already.
+        // 'prepare' runs on a worker thread and returns the upload, which update() runs on the main thread.
+        template <typename Asset, typename Prepare>
+        std::shared_future<std::shared_ptr<const Asset>> loadAsync(std::map<std::string, std::weak_ptr<const Asset>>& pool,
+                                                                   std::map<std::string, std::shared_future<std::shared_ptr<const Asset>>>& pending,
+                                                                   const std::string& key, Prepare prepare) {
+            typedef std::shared_ptr<const Asset> Handle;
+            if (Handle existing = find(pool, key)) {
+                std::promise<Handle> loaded;
+                loaded.set_value(existing);
+                return loaded.get_future().share();
+            }
+            auto loading = pending.find(key);
+            if (loading != pending.end()) {
+                return loading->second;
+            }
+
+            std::shared_ptr<std::promise<Handle>> promise = std::make_shared<std::promise<Handle>>();
+            std::shared_future<Handle> future = promise->get_future().share();
+            pending[key] = future;
+            workerPool().submit([this, &pending, key, promise, prepare]() {
+                std::function<Handle()> upload = prepare();
+                std::lock_guard<std::mutex> lock(finishedMutex);
+                finished.push_back([&pending, key, promise, upload]() {
+                    promise->set_value(upload());
+                    pending.erase(key);
+                });
+            });
+            return future;
+        }
+
+        // The worker threads, started on first use.
+        WorkerPool& workerPool() {
+            if (!workers) {
+                workers.reset(new WorkerPool());
+            }
+            return *workers;
+        }
+
+        // Bytes of mip 'level' of a streamed texture on the GPU.
+        static size_t levelBytes(const StreamedTexture& stream, uint32_t level) {
+            const MeshCache& cache = *stream.cache;
+            return stream.compressed ? cache.mipBytes(level) * cache.textureLayers()
+                : (size_t)cache.mipWidth(level) * cache.mipHeight(level) * 4 * cache.textureLayers();
+        }
+
+        // Once per frame: takes the levels the last frame asked for, drops levels while the budget is exceeded
+        // and starts reading the next finer level of every texture that is wanted sharper than it is.
+        void streamTextures() {
+            forgetReleased();
+            for (auto& entry : streamed) {
+                entry.second.neededLevel = entry.second.requestedLevel;
+                entry.second.requestedLevel = entry.second.tailLevel;
+            }
+            makeRoom(0, NULL);
+
+            for (auto& entry : streamed) {
+                StreamedTexture& stream = entry.second;
+                if (stream.streaming || stream.neededLevel >= stream.residentLevel) {
+                    continue;
+                }
+                uint32_t level = stream.residentLevel - 1;
+                if (!makeRoom(levelBytes(stream, level), &stream)) {
+                    continue;
+                }
+                // The level is read (from disk, if its pages aren't cached) on a worker, and uploaded by update()
+                stream.streaming = true;
+                const TextureAsset* key = entry.first;
+                std::weak_ptr<const TextureAsset> texture = stream.texture;
+                std::shared_ptr<MeshCache> cache = stream.cache;
+                bool compressed = stream.compressed;
+                workerPool().submit([this, key, texture, cache, level, compressed]() {
+                    std::shared_ptr<std::vector<unsigned char>> data = std::make_shared<std::vector<unsigned char>>();
+                    size_t bytes = 0;
+                    const unsigned char* texels = levelData(*cache, level, compressed, *data, bytes);
+                    if (texels != data->data()) {
+                        data->assign(texels, texels + bytes);
+                    }
+                    std::lock_guard<std::mutex> lock(finishedMutex);
+                    finished.push_back([this, key, texture, level, data]() {
+                        uploadStreamedLevel(key, texture, level, *data);
+                    });
+                });
+            }
+        }
+
+        // Uploads a level read by streamTextures(), if the texture is still live, still wants it and it fits.
+        void uploadStreamedLevel(const TextureAsset* key, const std::weak_ptr<const TextureAsset>& texture, uint32_t level,
+                                 const std::vector<unsigned char>& data) {
+            TextureHandle live = texture.lock();
+            auto it = live ? streamed.find(key) : streamed.end();
+            if (it == streamed.end()) {
+                return;
+            }
+            StreamedTexture& stream = it->second;
+            stream.streaming = false;
+            size_t bytes = levelBytes(stream, level);
+            if (level + 1 != stream.residentLevel || !makeRoom(bytes, &stream)) {
+                return;
+            }
+            const MeshCache& cache = *stream.cache;
+            glBindTexture(live->target, live->id);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            uploadLevel(*live, stream.compressed, level, cache.mipWidth(level), cache.mipHeight(level), cache.textureLayers(), bytes, data.data());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glTexParameteri(live->target, GL_TEXTURE_BASE_LEVEL, level);
+            glBindTexture(live->target, 0);
+            stream.residentLevel = level;
+            stream.bytes += bytes;
+            stream.streamedBytes += bytes;
+            streamedBytes += bytes;
+            gpuBytes += bytes;
+        }
+
+        // Drops levels of streamed textures until 'bytes' more fit the budget. Levels finer than their texture
+        // needed in the last frame go first, then those of the textures used least recently. 'requester' (or
+        // NULL) loses nothing, and only textures used less recently than it lose levels they need. Returns
+        // false if the bytes can't be made to fit.
+        bool makeRoom(size_t bytes, const StreamedTexture* requester) {
+            forgetReleased();
+            while (streamedBytes + bytes > textureBudget) {
+                StreamedTexture* victim = NULL;
+                for (auto& entry : streamed) {
+                    StreamedTexture& stream = entry.second;
+                    bool surplus = stream.residentLevel < stream.neededLevel;
+                    if (&stream == requester || stream.streaming || stream.residentLevel >= stream.tailLevel
+                        || (requester != NULL && !surplus && stream.lastUsed >= requester->lastUsed)) {
+                        continue;
+                    }
+                    if (victim == NULL || std::make_pair(!surplus, stream.lastUsed)
+                                          < std::make_pair(victim->residentLevel >= victim->neededLevel, victim->lastUsed)) {
+                        victim = &stream;
+                    }
+                }
+                if (victim == NULL) {
+                    return false;
+                }
+                dropLevel(*victim);
+            }
+            return true;
+        }
+
+        // Frees the finest level a streamed texture has on the GPU; it then samples from the next one.
+        void dropLevel(StreamedTexture& stream) {
+            TextureHandle live = stream.texture.lock();
+            uint32_t level = stream.residentLevel;
+            size_t bytes = levelBytes(stream, level);
+            glBindTexture(live->target, live->id);
+            glTexParameteri(live->target, GL_TEXTURE_BASE_LEVEL, level + 1);
+            uploadLevel(*live, stream.compressed, level, 0, 0, 0, 0, NULL);
+            glBindTexture(live->target, 0);
+            stream.residentLevel = level + 1;
+            stream.bytes -= bytes;
+            stream.streamedBytes -= bytes;
+            streamedBytes -= bytes;
+            gpuBytes -= bytes;
+        }
+
+        // Forgets the streamed textures whose last handle is gone, with the levels the asset didn't count.
+        void forgetReleased() {
+            for (auto it = streamed.begin(); it != streamed.end(); ) {
+                if (it->second.texture.expired()) {
+                    streamedBytes -= it->second.bytes;
+                    gpuBytes -= it->second.streamedBytes;
+                    it = streamed.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        // The live asset loaded for 'key', or an empty handle.
+        template <typename Asset>
+        static std::shared_ptr<const Asset> find(std::map<std::string, std::weak_ptr<const Asset>>& pool, const std::string& key) {
+            auto it = pool.find(key);
+            return it != pool.end() ? it->second.lock() : std::shared_ptr<const Asset>();
+        }
+
+        // Number of assets of a pool that still have handles.
+        template <typename Asset>
+        static size_t live(const std::map<std::string, std::weak_ptr<const Asset>>& pool) {
+            size_t count = 0;
+            for (const auto& entry : pool) {
+                count += entry.second.expired() ? 0 : 1;
+            }
+            return count;
+        }
+
+        // Wraps a new asset in its first handle and records it in 'pool'. When the last handle goes, the asset
+        // is deleted, and with it its GL objects, its bytes are no longer counted and its entry is dropped.
+        template <typename Asset>
+        std::shared_ptr<const Asset> share(std::map<std::string, std::weak_ptr<const Asset>>& pool, const std::string& key,
+                                           Asset* asset, size_t assetCpuBytes, size_t assetGpuBytes) {
+            cpuBytes += assetCpuBytes;
+            gpuBytes += assetGpuBytes;
+            std::shared_ptr<const Asset> handle(asset, [this, &pool, key, assetCpuBytes, assetGpuBytes](const Asset* dead) {
+                cpuBytes -= assetCpuBytes;
+                gpuBytes -= assetGpuBytes;
+                auto it = pool.find(key);
+                if (it != pool.end() && it->second.expired()) {
+                    pool.erase(it);
+                }
+                delete dead;
+            });
+            pool[key] = handle;
+            return handle;
+        }
+};
+
+#endif
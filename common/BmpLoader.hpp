@@ -0,0 +1,258 @@
+#ifndef BMP_LOADER_HPP
+#define BMP_LOADER_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "MappedFile.hpp"
+
+// The SSSE3 byte shuffle used for the pixel conversion is compiled on x86 with GCC or Clang, and picked at
+// run time if the CPU has it, so the program needs no extra compiler flags.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BMP_SSSE3 1
+#include <tmmintrin.h>
+#else
+#define BMP_SSSE3 0
+#endif
+
+// Largest width or height accepted, so sizes computed from a corrupt header can't overflow.
+#define BMP_MAX_SIZE 32768
+
+// How the pixels of a BMP file are stored, read from its headers.
+struct BmpInfo {
+    uint32_t width = 0, height = 0;
+    uint32_t bitsPerPixel = 0; // 24 or 32
+    bool topDown = false; // Rows stored top row first (negative height in the header)
+    size_t pixelOffset = 0; // Offset of the first stored row from the start of the file
+    size_t rowStride = 0; // Bytes per stored row, padded to a multiple of 4
+    uint32_t masks[4] = {0, 0, 0, 0}; // Bits of a 32-bit pixel holding red, green, blue and alpha (0: opaque)
+};
+
+// Reads little-endian integers at 'p', which need not be aligned.
+inline uint32_t bmpRead32(const char* p) {
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+inline uint16_t bmpRead16(const char* p) {
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+    return (uint16_t)(b[0] | (b[1] << 8));
+}
+
+// Fills 'info' from the headers of the BMP file in 'data'. Returns false for anything but an uncompressed
+// 24- or 32-bit image (plain or with bit field masks) whose pixels all lie inside the file.
+inline bool parseBmpHeader(const char* data, size_t size, BmpInfo& info) {
+    // 14-byte file header, then an info header of at least 40 bytes (BITMAPINFOHEADER or a later version)
+    if (size < 54 || data[0] != 'B' || data[1] != 'M') {
+        return false;
+    }
+    uint32_t headerSize = bmpRead32(data + 14);
+    int32_t width = (int32_t)bmpRead32(data + 18);
+    int32_t height = (int32_t)bmpRead32(data + 22);
+    uint32_t compression = bmpRead32(data + 30);
+    info.bitsPerPixel = bmpRead16(data + 28);
+    if (headerSize < 40 || bmpRead16(data + 26) != 1 || (info.bitsPerPixel != 24 && info.bitsPerPixel != 32)
+        || width <= 0 || width > BMP_MAX_SIZE || height == 0 || height < -BMP_MAX_SIZE || height > BMP_MAX_SIZE) {
+        return false;
+    }
+    info.width = (uint32_t)width;
+    info.height = (uint32_t)(height < 0 ? -height : height);
+    info.topDown = height < 0;
+    info.pixelOffset = bmpRead32(data + 10);
+    info.rowStride = ((size_t)info.width * info.bitsPerPixel / 8 + 3) & ~(size_t)3;
+
+    if (compression == 0) {
+        // BI_RGB: bytes are blue, green, red (and an unused fourth byte in 32-bit files)
+        info.masks[0] = 0x00FF0000;
+        info.masks[1] = 0x0000FF00;
+        info.masks[2] = 0x000000FF;
+        info.masks[3] = 0;
+    } else if ((compression == 3 || compression == 6) && info.bitsPerPixel == 32) {
+        // BI_BITFIELDS / BI_ALPHABITFIELDS: the masks follow the 40-byte header or are part of a longer one
+        size_t maskCount = (compression == 6 || headerSize >= 56) ? 4 : 3;
+        if (14 + 40 + maskCount * 4 > size) {
+            return false;
+        }
+        for (size_t c = 0; c < maskCount; c++) {
+            info.masks[c] = bmpRead32(data + 54 + 4 * c);
+        }
+        if (info.masks[0] == 0 || info.masks[1] == 0 || info.masks[2] == 0) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    if (info.pixelOffset == 0) {
+        // Some writers leave this out; the pixels then follow the headers and masks
+        info.pixelOffset = 14 + headerSize + (compression == 0 || headerSize >= 56 ? 0 : (compression == 6 ? 16 : 12));
+    }
+    return info.pixelOffset <= size && info.rowStride * info.height <= size - info.pixelOffset;
+}
+
+// Converts 'count' pixels of a row with an arbitrary set of masks, each channel scaled to 8 bits.
+inline void bmpConvertMasked(const char* src, unsigned char* dst, size_t count, const uint32_t masks[4]) {
+    int shift[4], bits[4];
+    for (int c = 0; c < 4; c++) {
+        shift[c] = 0;
+        bits[c] = 0;
+        if (masks[c] != 0) {
+            while (((masks[c] >> shift[c]) & 1) == 0) {
+                shift[c]++;
+            }
+            while (shift[c] + bits[c] < 32 && ((masks[c] >> (shift[c] + bits[c])) & 1) != 0) {
+                bits[c]++;
+            }
+        }
+    }
+    for (size_t x = 0; x < count; x++) {
+        uint32_t pixel = bmpRead32(src + 4 * x);
+        for (int c = 0; c < 4; c++) {
+            if (masks[c] == 0) {
+                dst[4 * x + c] = 255;
+                continue;
+            }
+            uint64_t value = (pixel & masks[c]) >> shift[c];
+            uint64_t maximum = (bits[c] >= 32 ? 0xFFFFFFFFull : (1ull << bits[c]) - 1);
+            dst[4 * x + c] = (unsigned char)((value * 255 + maximum / 2) / maximum);
+        }
+    }
+}
+
+// Converts 'count' blue-green-red pixels of 'bytes' bytes each (the fourth byte of 32-bit pixels holding
+// alpha if 'hasAlpha', else ignored) to red-green-blue-alpha.
+inline void bmpConvertScalar(const char* src, unsigned char* dst, size_t count, size_t bytes, bool hasAlpha) {
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(src);
+    for (size_t x = 0; x < count; x++, s += bytes, dst += 4) {
+        dst[0] = s[2];
+        dst[1] = s[1];
+        dst[2] = s[0];
+        dst[3] = hasAlpha ? s[3] : 255;
+    }
+}
+
+#if BMP_SSSE3
+// bmpConvertScalar() four pixels at a time: one 16-byte load, one shuffle putting the bytes in RGBA order
+// and an OR that makes missing alpha opaque. A 24-bit load reads 16 bytes for 12 bytes of pixels, so it
+// needs 6 pixels left in the row to stay inside it; the scalar loop finishes the row.
+__attribute__((target("ssse3")))
+inline void bmpConvertSSSE3(const char* src, unsigned char* dst, size_t count, size_t bytes, bool hasAlpha) {
+    const __m128i shuffle = bytes == 3
+        ? _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+        : _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m128i opaque = _mm_set1_epi32(hasAlpha ? 0 : (int)0xFF000000);
+    size_t needed = bytes == 3 ? 6 : 4;
+    size_t x = 0;
+    for (; x + needed <= count; x += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * bytes));
+        pixels = _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), opaque);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x), pixels);
+    }
+    bmpConvertScalar(src + x * bytes, dst + 4 * x, count - x, bytes, hasAlpha);
+}
+
+// Whether the CPU running the program has SSSE3, checked once.
+inline bool bmpHasSSSE3() {
+    static const bool has = __builtin_cpu_supports("ssse3");
+    return has;
+}
+#endif
+
+// Decodes the pixels of the BMP file in 'data' (described by 'info') into 'rgba': width * height texels of
+// 4 bytes (red, green, blue, alpha), rows tightly packed with the bottom row first, as glTexImage2D expects.
+// Files stored with the usual masks are converted with SIMD shuffles, any other masks field by field.
+inline void decodeBmp(const char* data, const BmpInfo& info, unsigned char* rgba) {
+    size_t bytes = info.bitsPerPixel / 8;
+    bool standard = info.masks[0] == 0x00FF0000 && info.masks[1] == 0x0000FF00 && info.masks[2] == 0x000000FF
+        && (info.masks[3] == 0 || info.masks[3] == 0xFF000000);
+    bool hasAlpha = bytes == 4 && info.masks[3] != 0;
+    for (uint32_t row = 0; row < info.height; row++) {
+        const char* src = data + info.pixelOffset + row * info.rowStride;
+        unsigned char* dst = rgba + (size_t)(info.topDown ? info.height - 1 - row : row) * info.width * 4;
+        if (!standard) {
+            bmpConvertMasked(src, dst, info.width, info.masks);
+            continue;
+        }
+#if BMP_SSSE3
+        if (bmpHasSSSE3()) {
+            bmpConvertSSSE3(src, dst, info.width, bytes, hasAlpha);
+            continue;
+        }
+#endif
+        bmpConvertScalar(src, dst, info.width, bytes, hasAlpha);
+    }
+}
+
+// Loads a 24- or 32-bit BMP file as RGBA8 texels (see decodeBmp()). The file is memory-mapped and each
+// pixel is converted straight from the mapping into 'rgba', so nothing is read into a buffer first.
+// Prints an error and returns false if the file can't be read or isn't a BMP this loader understands.
+inline bool loadBMP(const std::string& path, std::vector<unsigned char>& rgba, unsigned int& width, unsigned int& height) {
+    MappedFile file(path);
+    if (!file.isOpen()) {
+        printf("ERROR: Can't open %s. Are you in the right directory?\n", path.c_str());
+        return false;
+    }
+    BmpInfo info;
+    if (!parseBmpHeader(file.data, file.size, info)) {
+        printf("ERROR: %s is not a 24- or 32-bit uncompressed BMP file\n", path.c_str());
+        return false;
+    }
+    rgba.resize((size_t)info.width * info.height * 4);
+    decodeBmp(file.data, info, rgba.data());
+    width = info.width;
+    height = info.height;
+    return true;
+}
+
+// Resizes an RGBA8 image of 'srcWidth' x 'srcHeight' texels to 'dstWidth' x 'dstHeight' with bilinear filtering,
+// texel centers lined up and edges clamped.
+inline void resizeRGBA(const unsigned char* src, uint32_t srcWidth, uint32_t srcHeight,
+                       unsigned char* dst, uint32_t dstWidth, uint32_t dstHeight) {
+    for (uint32_t y = 0; y < dstHeight; y++) {
+        float sy = std::max(0.0f, (y + 0.5f) * srcHeight / dstHeight - 0.5f);
+        uint32_t y0 = std::min((uint32_t)sy, srcHeight - 1), y1 = std::min(y0 + 1, srcHeight - 1);
+        float fy = sy - y0;
+        for (uint32_t x = 0; x < dstWidth; x++) {
+            float sx = std::max(0.0f, (x + 0.5f) * srcWidth / dstWidth - 0.5f);
+            uint32_t x0 = std::min((uint32_t)sx, srcWidth - 1), x1 = std::min(x0 + 1, srcWidth - 1);
+            float fx = sx - x0;
+            for (int c = 0; c < 4; c++) {
+                float top = src[((size_t)y0 * srcWidth + x0) * 4 + c] * (1.0f - fx) + src[((size_t)y0 * srcWidth + x1) * 4 + c] * fx;
+                float bottom = src[((size_t)y1 * srcWidth + x0) * 4 + c] * (1.0f - fx) + src[((size_t)y1 * srcWidth + x1) * 4 + c] * fx;
+                dst[((size_t)y * dstWidth + x) * 4 + c] = (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+            }
+        }
+    }
+}
+
+// Loads several BMP files as the layers of one array texture, which must all be the same size: each is scaled
+// to the largest width and the largest height among them (so none loses detail) and they are stored one after
+// another in 'rgba'. Prints an error and returns false if any of them can't be loaded.
+inline bool loadBMPLayers(const std::vector<std::string>& paths, std::vector<unsigned char>& rgba, unsigned int& width, unsigned int& height) {
+    std::vector<std::vector<unsigned char>> images(paths.size());
+    std::vector<unsigned int> widths(paths.size()), heights(paths.size());
+    width = 0;
+    height = 0;
+    for (size_t layer = 0; layer < paths.size(); layer++) {
+        if (!loadBMP(paths[layer], images[layer], widths[layer], heights[layer])) {
+            return false;
+        }
+        width = std::max(width, widths[layer]);
+        height = std::max(height, heights[layer]);
+    }
+    size_t layerBytes = (size_t)width * height * 4;
+    rgba.resize(layerBytes * paths.size());
+    for (size_t layer = 0; layer < paths.size(); layer++) {
+        if (widths[layer] == width && heights[layer] == height) {
+            memcpy(rgba.data() + layer * layerBytes, images[layer].data(), layerBytes);
+        } else {
+            resizeRGBA(images[layer].data(), widths[layer], heights[layer], rgba.data() + layer * layerBytes, width, height);
+        }
+    }
+    return true;
+}
+
+#endif
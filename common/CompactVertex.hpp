@@ -0,0 +1,150 @@
+#ifndef COMPACT_VERTEX_HPP
+#define COMPACT_VERTEX_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "Meshlets.hpp"
+
+// Uploaded form of one vertex, 16 bytes instead of the 44 of a parsed vertex:
+// - position: 16-bit unsigned normalized, relative to the mesh's bounding box (see CompactMesh)
+// - normal: octahedral encoding in two 16-bit signed normalized values
+// - uv: two half floats
+// - layer: the layer of an array texture the vertex samples (0 in baked meshes; see AssetManager::mesh())
+struct CompactVertex {
+    uint16_t position[3];
+    uint16_t layer; // Also keeps the normal 4-byte aligned
+    int16_t normal[2];
+    uint16_t uv[2];
+};
+
+// A mesh in the form it is uploaded and baked: compact vertices, indices of 'indexSize' bytes (16-bit when
+// every vertex can be addressed with them) and its meshlets. A position decodes to
+// positionOffset + position / 65535 * positionScale, i.e. the normalized value scaled to the bounding box.
+struct CompactMesh {
+    std::vector<CompactVertex> vertices;
+    std::vector<unsigned char> indices;
+    uint32_t indexSize = 4;
+    uint64_t indexCount = 0;
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    std::vector<Meshlet> meshlets;
+};
+
+// Converts a float to the nearest half float (IEEE 754 binary16), rounding ties to even. Values too large
+// for a half become infinity.
+inline uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    uint32_t magnitude = bits & 0x7FFFFFFF;
+    if (magnitude >= 0x7F800000) {
+        // Infinity stays infinity, NaN stays NaN
+        return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x0200 : 0);
+    }
+    if (magnitude >= 0x477FF000) {
+        // 65520 and above round past the largest half, 65504
+        return sign | 0x7C00;
+    }
+    if (magnitude < 0x38800000) {
+        // Below 2^-14 the result is subnormal: a multiple of 2^-24
+        float absolute;
+        memcpy(&absolute, &magnitude, sizeof(absolute));
+        return sign | (uint16_t)std::nearbyint(absolute * 16777216.0f);
+    }
+    // Rebiases the exponent and rounds the 23-bit mantissa to 10 bits
+    uint32_t rounded = magnitude + 0x0FFF + ((magnitude >> 13) & 1);
+    return sign | (uint16_t)((rounded - 0x38000000) >> 13);
+}
+
+// Encodes a direction as a point of the octahedron |x| + |y| + |z| = 1 unfolded onto the square [-1, 1]^2,
+// stored as two 16-bit signed normalized values. A zero vector encodes to (0, 0), which decodes to +z.
+inline void octahedralEncode(const glm::vec3& normal, int16_t out[2]) {
+    float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    float x = 0.0f, y = 0.0f;
+    if (length > 0.0f) {
+        x = normal.x / length;
+        y = normal.y / length;
+        if (normal.z < 0.0f) {
+            // The lower half folds over the diagonals
+            float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = foldedX;
+            y = foldedY;
+        }
+    }
+    out[0] = (int16_t)std::lround(std::min(std::max(x, -1.0f), 1.0f) * 32767.0f);
+    out[1] = (int16_t)std::lround(std::min(std::max(y, -1.0f), 1.0f) * 32767.0f);
+}
+
+// Quantizes a parsed mesh into its compact form. Each vertex has its position as three floats at offset 0,
+// its normal as three floats at 'normalOffset' and its texture coordinates as two floats at 'uvOffset'.
+// 'meshlets' are moved into the result; their bounding spheres grow by the largest rounding error of a
+// position, so culling stays conservative for the quantized vertices.
+inline CompactMesh compactMesh(const void* vertices, size_t stride, size_t vertexCount, size_t normalOffset, size_t uvOffset,
+                               const uint32_t* indices, size_t indexCount, std::vector<Meshlet>&& meshlets) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+    auto read = [&](size_t v, size_t offset, float* out, int count) {
+        memcpy(out, bytes + v * stride + offset, count * sizeof(float));
+    };
+
+    CompactMesh mesh;
+    if (vertexCount > 0) {
+        float p[3];
+        read(0, 0, p, 3);
+        glm::vec3 boxMin(p[0], p[1], p[2]), boxMax(boxMin);
+        for (size_t v = 1; v < vertexCount; v++) {
+            read(v, 0, p, 3);
+            boxMin = glm::min(boxMin, glm::vec3(p[0], p[1], p[2]));
+            boxMax = glm::max(boxMax, glm::vec3(p[0], p[1], p[2]));
+        }
+        mesh.positionOffset = boxMin;
+        mesh.positionScale = boxMax - boxMin;
+    }
+
+    mesh.vertices.resize(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        CompactVertex& out = mesh.vertices[v];
+        float p[3], n[3], uv[2];
+        read(v, 0, p, 3);
+        read(v, normalOffset, n, 3);
+        read(v, uvOffset, uv, 2);
+        for (int c = 0; c < 3; c++) {
+            // Flat axes (zero extent) quantize to 0 and decode back to the offset
+            float extent = mesh.positionScale[c];
+            float t = extent > 0.0f ? (p[c] - mesh.positionOffset[c]) / extent : 0.0f;
+            out.position[c] = (uint16_t)std::lround(std::min(std::max(t, 0.0f), 1.0f) * 65535.0f);
+        }
+        out.layer = 0;
+        octahedralEncode(glm::vec3(n[0], n[1], n[2]), out.normal);
+        out.uv[0] = floatToHalf(uv[0]);
+        out.uv[1] = floatToHalf(uv[1]);
+    }
+
+    // 16-bit indices whenever every vertex can be addressed with them
+    mesh.indexSize = vertexCount <= 65536 ? 2 : 4;
+    mesh.indexCount = indexCount;
+    mesh.indices.resize(indexCount * mesh.indexSize);
+    if (mesh.indexSize == 2) {
+        uint16_t* out = reinterpret_cast<uint16_t*>(mesh.indices.data());
+        for (size_t n = 0; n < indexCount; n++) {
+            out[n] = (uint16_t)indices[n];
+        }
+    } else if (indexCount > 0) {
+        memcpy(mesh.indices.data(), indices, indexCount * sizeof(uint32_t));
+    }
+
+    // Rounding moves a position by at most half a step along each axis
+    float error = 0.5f * glm::length(mesh.positionScale) / 65535.0f;
+    mesh.meshlets = std::move(meshlets);
+    for (Meshlet& meshlet : mesh.meshlets) {
+        meshlet.radius += error;
+    }
+    return mesh;
+}
+
+#endif
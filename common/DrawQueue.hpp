@@ -0,0 +1,130 @@
+#ifndef DRAW_QUEUE_HPP
+#define DRAW_QUEUE_HPP
+
+#include <stddef.h>
+#include <vector>
+#include <tuple>
+#include <functional>
+#include <algorithm>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// The GL objects an object is drawn with. Consecutive objects with the same state are drawn without binding
+// anything again.
+struct DrawState {
+    GLuint program = 0;
+    GLenum textureTarget = GL_TEXTURE_2D;
+    GLuint texture = 0; // Bound to texture unit 0
+    GLuint vao = 0;
+};
+
+// How far in front of the camera with view matrix 'view' the world space 'point' is; the depth objects are
+// sorted by.
+inline float viewDepth(const glm::mat4& view, const glm::vec3& point) {
+    return -(view * glm::vec4(point, 1.0f)).z;
+}
+
+// The objects of one frame, drawn in the order that suits the GPU rather than the order they were submitted.
+// Opaque objects come first, with blending off and depth writes on, grouped by state (program, then texture,
+// then VAO) and front to back within a group, so nearer objects hide the pixels of farther ones before they
+// are shaded. Transparent objects follow back to front, blended over what is behind them, with depth writes
+// off so they don't hide each other.
+//
+// An object's draw function sets its own uniforms and issues its draw calls; the queue binds its program,
+// texture and VAO first. It may also add the object to a batch (see MeshBatch.hpp) instead, which is then drawn
+// at the end of each pass.
+class DrawQueue {
+    public:
+        struct Item {
+            DrawState state;
+            float depth; // See viewDepth()
+            bool transparent;
+            std::function<void()> draw;
+        };
+
+        // Drops the objects of the last frame.
+        void clear() {
+            items.clear();
+        }
+
+        // Queues an object for the next flush().
+        void submit(const DrawState& state, float depth, bool transparent, std::function<void()> draw) {
+            items.push_back(Item{state, depth, transparent, std::move(draw)});
+        }
+
+        // Draws the queued objects, the opaque ones then the transparent ones. 'endPass', if given, is called
+        // at the end of each pass that had objects (with true for the transparent one) while its blending is
+        // still set, to draw what the draw functions batched. Leaves blending off, depth writes on and no
+        // program, texture or VAO bound.
+        void flush(const std::function<void(bool transparent)>& endPass = std::function<void(bool)>()) {
+            order.clear();
+            for (size_t i = 0; i < items.size(); i++) {
+                order.push_back(i);
+            }
+            std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+                const Item& x = items[a];
+                const Item& y = items[b];
+                if (x.transparent != y.transparent) {
+                    return !x.transparent;
+                }
+                if (x.transparent) {
+                    return std::make_tuple(-x.depth, a) < std::make_tuple(-y.depth, b);
+                }
+                return std::make_tuple(x.state.program, x.state.textureTarget, x.state.texture, x.state.vao, x.depth, a)
+                     < std::make_tuple(y.state.program, y.state.textureTarget, y.state.texture, y.state.vao, y.depth, b);
+            });
+
+            glActiveTexture(GL_TEXTURE0);
+            size_t next = 0;
+            for (int pass = 0; pass < 2; pass++) {
+                bool transparent = pass == 1;
+                if (next == order.size() || items[order[next]].transparent != transparent) {
+                    continue;
+                }
+                if (transparent) {
+                    glEnable(GL_BLEND);
+                    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                    glDepthMask(GL_FALSE);
+                } else {
+                    glDisable(GL_BLEND);
+                    glDepthMask(GL_TRUE);
+                }
+                // Everything is bound again at the start of a pass, as the end of the last one may have changed it
+                const DrawState* bound = NULL;
+                for (; next < order.size() && items[order[next]].transparent == transparent; next++) {
+                    const Item& item = items[order[next]];
+                    const DrawState& state = item.state;
+                    if (bound == NULL || state.program != bound->program) {
+                        glUseProgram(state.program);
+                    }
+                    if (bound == NULL || state.textureTarget != bound->textureTarget || state.texture != bound->texture) {
+                        glBindTexture(state.textureTarget, state.texture);
+                    }
+                    if (bound == NULL || state.vao != bound->vao) {
+                        glBindVertexArray(state.vao);
+                    }
+                    bound = &state;
+                    item.draw();
+                }
+                if (endPass) {
+                    endPass(transparent);
+                }
+            }
+
+            glDepthMask(GL_TRUE);
+            glDisable(GL_BLEND);
+            glBindVertexArray(0);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+            glUseProgram(0);
+        }
+
+        // Number of objects queued.
+        size_t size() const { return items.size(); }
+
+    private:
+        std::vector<Item> items; // In the order they were submitted
+        std::vector<size_t> order; // Indices of 'items' in drawing order
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include <cmath>
+#include <glm/glm.hpp>
+
+// The six clipping planes of a camera, used to skip geometry that cannot be on screen.
+// Each plane is stored as (a, b, c, d) with a*x + b*y + c*z + d >= 0 on the visible side and (a, b, c)
+// of unit length, so the left-hand side is the distance to the plane.
+struct Frustum {
+    glm::vec4 planes[6];
+    glm::vec3 eye; // Position of the camera, in the same space as the geometry tested
+    bool hasEye; // False for projections without a single eye point (orthographic)
+
+    // Extracts the planes from a combined projection * view (* model) matrix (Gribb & Hartmann).
+    Frustum(const glm::mat4& viewProjection) {
+        // Rows of the matrix; glm stores matrices column-major.
+        glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+        glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+        glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+        glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+        planes[0] = row3 + row0; // Left
+        planes[1] = row3 - row0; // Right
+        planes[2] = row3 + row1; // Bottom
+        planes[3] = row3 - row1; // Top
+        planes[4] = row3 + row2; // Near
+        planes[5] = row3 - row2; // Far
+        for (int p = 0; p < 6; p++) {
+            planes[p] /= glm::length(glm::vec3(planes[p]));
+        }
+
+        // The eye is the one point that a perspective projection sends to x = y = w = 0, i.e. the solution of
+        // row0 . (eye, 1) = row1 . (eye, 1) = row3 . (eye, 1) = 0 (Cramer's rule with cross products).
+        glm::vec3 a(row0), b(row1), c(row3);
+        float determinant = glm::dot(a, glm::cross(b, c));
+        hasEye = std::fabs(determinant) > 1e-12f;
+        eye = hasEye ? -(row0.w * glm::cross(b, c) + row1.w * glm::cross(c, a) + row3.w * glm::cross(a, b)) / determinant
+                     : glm::vec3(0.0f);
+    }
+
+    // Returns false only if the sphere is completely outside one of the planes.
+    bool intersectsSphere(const glm::vec3& center, float radius) const {
+        for (int p = 0; p < 6; p++) {
+            if (planes[p].x * center.x + planes[p].y * center.y + planes[p].z * center.z + planes[p].w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Returns false only if the axis-aligned box [boxMin, boxMax] is completely outside one of the planes.
+    bool intersectsAABB(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+        for (int p = 0; p < 6; p++) {
+            // Picks the box corner furthest along the plane normal; if even that one is outside, the whole box is.
+            glm::vec3 corner(planes[p].x >= 0 ? boxMax.x : boxMin.x,
+                             planes[p].y >= 0 ? boxMax.y : boxMin.y,
+                             planes[p].z >= 0 ? boxMax.z : boxMin.z);
+            if (planes[p].x * corner.x + planes[p].y * corner.y + planes[p].z * corner.z + planes[p].w < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif
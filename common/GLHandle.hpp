@@ -0,0 +1,90 @@
+#ifndef GL_HANDLE_HPP
+#define GL_HANDLE_HPP
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+// Owners of single GL object names: a buffer, a vertex array, a texture or a shader program. Each deletes its
+// object when it is destroyed or given another, so an object lives exactly as long as the C++ object holding
+// it. They can be moved but not copied, as two owners of one name would delete it twice; a class holding
+// them is then move-only too, and is built in place (emplace) rather than copied into containers.
+//
+// The object is only deleted while a GL context is current. Once the context is gone (after glfwTerminate(),
+// e.g. for objects declared in main()), its objects have been freed with it.
+//
+// A handle converts to its name, so it is passed to GL calls as it is: glBindVertexArray(mesh.vao).
+template <typename Kind>
+class GLObject {
+    private:
+        GLuint name = 0;
+
+    public:
+        // No object.
+        GLObject() = default;
+        // Takes ownership of 'adopted', a name created elsewhere (e.g. a program linked by LoadShaders()).
+        explicit GLObject(GLuint adopted) : name(adopted) {}
+        ~GLObject() {
+            reset();
+        }
+
+        GLObject(const GLObject&) = delete;
+        GLObject& operator=(const GLObject&) = delete;
+        GLObject(GLObject&& other) : name(other.name) {
+            other.name = 0;
+        }
+        GLObject& operator=(GLObject&& other) {
+            if (this != &other) {
+                reset(other.name);
+                other.name = 0;
+            }
+            return *this;
+        }
+
+        // A new object, created with the current context.
+        static GLObject create() {
+            return GLObject(Kind::create());
+        }
+
+        GLuint id() const { return name; }
+        operator GLuint() const { return name; }
+        explicit operator bool() const { return name != 0; }
+
+        // Deletes the object, and takes ownership of 'adopted' in its place.
+        void reset(GLuint adopted = 0) {
+            if (name != 0 && name != adopted && glfwGetCurrentContext() != NULL) {
+                Kind::destroy(name);
+            }
+            name = adopted;
+        }
+        // Gives up ownership of the object without deleting it, and returns its name.
+        GLuint release() {
+            GLuint released = name;
+            name = 0;
+            return released;
+        }
+};
+
+// How each kind of object is created and deleted.
+struct GLBufferKind {
+    static GLuint create() { GLuint name = 0; glGenBuffers(1, &name); return name; }
+    static void destroy(GLuint name) { glDeleteBuffers(1, &name); }
+};
+struct GLVertexArrayKind {
+    static GLuint create() { GLuint name = 0; glGenVertexArrays(1, &name); return name; }
+    static void destroy(GLuint name) { glDeleteVertexArrays(1, &name); }
+};
+struct GLTextureKind {
+    static GLuint create() { GLuint name = 0; glGenTextures(1, &name); return name; }
+    static void destroy(GLuint name) { glDeleteTextures(1, &name); }
+};
+struct GLProgramKind {
+    static GLuint create() { return glCreateProgram(); }
+    static void destroy(GLuint name) { glDeleteProgram(name); }
+};
+
+typedef GLObject<GLBufferKind> GLBuffer;
+typedef GLObject<GLVertexArrayKind> GLVertexArray;
+typedef GLObject<GLTextureKind> GLTexture;
+typedef GLObject<GLProgramKind> GLProgram;
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+
+// A read-only memory mapping of a whole file, so parsers can read its bytes in place instead of copying
+// them through a stream.
+class MappedFile {
+    public:
+        const char* data = NULL; // First byte of the file, or NULL if it couldn't be mapped
+        size_t size = 0; // Size of the file in bytes
+
+        MappedFile(const std::string& path) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return;
+            }
+            struct stat info;
+            if (fstat(fd, &info) == 0 && info.st_size > 0) {
+                void* mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping != MAP_FAILED) {
+                    madvise(mapping, (size_t)info.st_size, MADV_SEQUENTIAL);
+                    data = static_cast<const char*>(mapping);
+                    size = (size_t)info.st_size;
+                }
+            }
+            close(fd); // The mapping stays valid after the descriptor is closed.
+        }
+
+        ~MappedFile() {
+            if (data != NULL) {
+                munmap(const_cast<char*>(data), size);
+            }
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool isOpen() const {
+            return data != NULL;
+        }
+};
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef MESH_ARENA_HPP
+#define MESH_ARENA_HPP
+
+#include <stddef.h>
+#include <map>
+#include <algorithm>
+#include <GL/glew.h>
+
+#include "CompactVertex.hpp"
+#include "GLHandle.hpp"
+
+// Points attributes 0 to 3 of the bound VAO at compact vertices (see CompactVertex) in the buffer bound to
+// GL_ARRAY_BUFFER: the position, the octahedral normal, the texture coordinates and the array texture layer
+// (an unsigned integer).
+inline void setCompactVertexAttributes() {
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, uv));
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_SHORT, sizeof(CompactVertex), (void*)offsetof(CompactVertex, layer));
+}
+
+// Vertex and index buffers shared by many compact meshes, read through one VAO, so that meshes drawn with the
+// same program can be drawn together by one glMultiDrawElementsIndirect call (see MeshBatch.hpp), each from
+// its own base vertex and first index. Indices of 16 and 32 bits share the index buffer; every mesh's indices
+// start at a multiple of 4 bytes, so either size can address them.
+//
+// Space is handed out first fit from the free ranges and given back when a mesh goes. When no free range is
+// large enough, a buffer doubles in size and its contents are copied over on the GPU; the ranges handed out
+// stay where they are. The GL context must be current whenever the arena is used.
+class MeshArena {
+    public:
+        // Where a mesh's data is: its vertices from 'firstVertex' and its indices from 'indexOffset' bytes.
+        struct Range {
+            size_t firstVertex = 0, vertexCount = 0;
+            size_t indexOffset = 0, indexBytes = 0;
+        };
+
+        MeshArena() = default;
+        MeshArena(const MeshArena&) = delete;
+        MeshArena& operator=(const MeshArena&) = delete;
+
+        // Reserves room for 'vertexCount' vertices and 'indexBytes' bytes of indices, growing the buffers if needed.
+        Range allocate(size_t vertexCount, size_t indexBytes) {
+            Range range;
+            range.vertexCount = vertexCount;
+            range.indexBytes = (indexBytes + 3) & ~(size_t)3;
+            if (!take(freeVertices, range.vertexCount, range.firstVertex)) {
+                grow(vertexBuffer, GL_ARRAY_BUFFER, vertexCapacity, freeVertices, range.vertexCount, 1 << 16, sizeof(CompactVertex));
+                take(freeVertices, range.vertexCount, range.firstVertex);
+            }
+            if (!take(freeIndices, range.indexBytes, range.indexOffset)) {
+                grow(indexBuffer, GL_ELEMENT_ARRAY_BUFFER, indexCapacity, freeIndices, range.indexBytes, 1 << 18, 1);
+                take(freeIndices, range.indexBytes, range.indexOffset);
+            }
+            usedVertices += range.vertexCount;
+            usedIndexBytes += range.indexBytes;
+            return range;
+        }
+
+        // Fills a range returned by allocate() with 'range.vertexCount' compact vertices and 'indexBytes' bytes of indices.
+        void upload(const Range& range, const void* vertices, const void* indices, size_t indexBytes) {
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            glBufferSubData(GL_ARRAY_BUFFER, range.firstVertex * sizeof(CompactVertex), range.vertexCount * sizeof(CompactVertex), vertices);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindVertexArray(vertexArray);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, range.indexOffset, indexBytes, indices);
+            glBindVertexArray(0);
+        }
+
+        // Gives a range back, once nothing draws from it any more.
+        void release(const Range& range) {
+            give(freeVertices, range.firstVertex, range.vertexCount);
+            give(freeIndices, range.indexOffset, range.indexBytes);
+            usedVertices -= range.vertexCount;
+            usedIndexBytes -= range.indexBytes;
+        }
+
+        // The VAO reading the arena, with the index buffer bound; attributes 0 to 3 are set as by setCompactVertexAttributes().
+        GLuint vao() const { return vertexArray; }
+
+        // Bytes of the buffers on the GPU, and the part of them holding meshes.
+        size_t capacityBytes() const { return vertexCapacity * sizeof(CompactVertex) + indexCapacity; }
+        size_t usedBytes() const { return usedVertices * sizeof(CompactVertex) + usedIndexBytes; }
+
+    private:
+        GLVertexArray vertexArray;
+        GLBuffer vertexBuffer, indexBuffer;
+        size_t vertexCapacity = 0, indexCapacity = 0; // In vertices, and in bytes
+        size_t usedVertices = 0, usedIndexBytes = 0;
+        // Free ranges, start to size, with no two adjacent
+        std::map<size_t, size_t> freeVertices, freeIndices;
+
+        // Takes 'size' from the first free range large enough; false if there is none.
+        static bool take(std::map<size_t, size_t>& free, size_t size, size_t& offset) {
+            if (size == 0) {
+                offset = 0;
+                return true;
+            }
+            for (auto it = free.begin(); it != free.end(); ++it) {
+                if (it->second >= size) {
+                    offset = it->first;
+                    size_t rest = it->second - size;
+                    free.erase(it);
+                    if (rest > 0) {
+                        free[offset + size] = rest;
+                    }
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Returns a range to 'free', merged with the free ranges on either side.
+        static void give(std::map<size_t, size_t>& free, size_t offset, size_t size) {
+            if (size == 0) {
+                return;
+            }
+            auto next = free.lower_bound(offset);
+            if (next != free.begin()) {
+                auto previous = std::prev(next);
+                if (previous->first + previous->second == offset) {
+                    offset = previous->first;
+                    size += previous->second;
+                    free.erase(previous);
+                }
+            }
+            if (next != free.end() && offset + size == next->first) {
+                size += next->second;
+                free.erase(next);
+            }
+            free[offset] = size;
+        }
+
+        // Replaces 'buffer' by one at least twice as large with room for 'needed' more units at its end (which
+        // joins the free ranges), copying its contents over. 'minimum' units is the size of a first buffer.
+        void grow(GLBuffer& buffer, GLenum target, size_t& capacity, std::map<size_t, size_t>& free, size_t needed,
+                  size_t minimum, size_t unitBytes) {
+            // Room at the end that is already free extends the new range
+            size_t tail = 0;
+            if (!free.empty() && free.rbegin()->first + free.rbegin()->second == capacity) {
+                tail = free.rbegin()->second;
+            }
+            size_t grown = std::max(std::max(capacity * 2, minimum), capacity - tail + needed);
+
+            if (!vertexArray) {
+                vertexArray = GLVertexArray::create();
+            }
+            GLBuffer larger = GLBuffer::create();
+            glBindBuffer(GL_COPY_WRITE_BUFFER, larger);
+            glBufferData(GL_COPY_WRITE_BUFFER, grown * unitBytes, NULL, GL_STATIC_DRAW);
+            if (capacity > 0) {
+                glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, capacity * unitBytes);
+                glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            buffer = std::move(larger);
+            give(free, capacity, grown - capacity);
+            capacity = grown;
+
+            // The VAO reads from the new buffer
+            glBindVertexArray(vertexArray);
+            glBindBuffer(target, buffer);
+            if (target == GL_ARRAY_BUFFER) {
+                setCompactVertexAttributes();
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+            }
+            glBindVertexArray(0);
+        }
+};
+
+#endif
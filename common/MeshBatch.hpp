@@ -0,0 +1,168 @@
+#ifndef MESH_BATCH_HPP
+#define MESH_BATCH_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "AssetManager.hpp"
+#include "MeshArena.hpp"
+#include "Meshlets.hpp"
+#include "Frustum.hpp"
+#include "GLHandle.hpp"
+
+// The objects of one frame that are drawn with the same program and textures, collected so that they are all
+// drawn by one glMultiDrawElementsIndirect call per index size, however many there are. Their meshes must be
+// in the same MeshArena (see AssetManager::shareMeshBuffers).
+//
+// Each object becomes one indirect command per index range of its meshlets that survived culling, drawing a
+// single instance whose baseInstance is the object's number. The program reads the object's matrix, which takes
+// its compact positions (see CompactVertex) to world space, as a mat4 at attributes 4 to 7 that advances once per
+// instance; the view and projection are the program's own uniforms.
+//
+// Without multi-draw indirect (OpenGL 4.3 or ARB_multi_draw_indirect), the objects are drawn one after another
+// with glMultiDrawElementsBaseVertex, the matrix set as a constant attribute.
+class MeshBatch {
+    public:
+        // Drops the objects of the last frame.
+        void clear() {
+            for (int size = 0; size < 2; size++) {
+                commands[size].clear();
+            }
+            matrices.clear();
+            objects.clear();
+            arena = NULL;
+        }
+
+        // Adds 'mesh', placed in the world by 'model', for the frame being collected. Only the meshlets that can be
+        // seen with the camera's view-projection matrix 'VP' are drawn; with 'cullBackfaces', also not those facing
+        // away. Returns the number of meshlets kept. Meshes outside an arena, or in another one than the meshes
+        // added before, are skipped.
+        size_t add(const MeshAsset& mesh, const glm::mat4& model, const glm::mat4& VP, bool cullBackfaces) {
+            if (mesh.arena == NULL || (arena != NULL && mesh.arena != arena)) {
+                return 0;
+            }
+            // With an index size of 1, the offsets are the first indices themselves
+            size_t kept = cullMeshlets(mesh.meshlets, Frustum(VP * model), cullBackfaces, counts, offsets, 1);
+            if (counts.empty()) {
+                return 0;
+            }
+            arena = mesh.arena;
+            Object object;
+            object.size = mesh.indexSize == 2 ? 0 : 1;
+            object.firstCommand = commands[object.size].size();
+            object.commandCount = counts.size();
+            for (size_t i = 0; i < counts.size(); i++) {
+                Command command;
+                command.count = (GLuint)counts[i];
+                command.instanceCount = 1;
+                command.firstIndex = mesh.firstIndex + (GLuint)(size_t)offsets[i];
+                command.baseVertex = mesh.baseVertex;
+                command.baseInstance = (GLuint)matrices.size();
+                commands[object.size].push_back(command);
+            }
+            objects.push_back(object);
+            matrices.push_back(glm::scale(glm::translate(model, mesh.positionOffset), mesh.positionScale));
+            return kept;
+        }
+
+        // Draws every object added since clear() with the program, textures and blending bound by the caller.
+        void draw() {
+            if (objects.empty()) {
+                return;
+            }
+            glBindVertexArray(arena->vao());
+            if (GLEW_ARB_multi_draw_indirect || GLEW_VERSION_4_3) {
+                drawIndirect();
+            } else {
+                drawEach();
+            }
+            glBindVertexArray(0);
+        }
+
+        // Objects and indirect commands in the frame being collected.
+        size_t objectCount() const { return objects.size(); }
+        size_t commandCount() const { return commands[0].size() + commands[1].size(); }
+
+    private:
+        // The layout glMultiDrawElementsIndirect reads
+        struct Command {
+            GLuint count, instanceCount, firstIndex;
+            GLint baseVertex;
+            GLuint baseInstance;
+        };
+        struct Object {
+            int size; // 0 for 16-bit indices, 1 for 32-bit
+            size_t firstCommand, commandCount; // In commands[size]
+        };
+
+        std::vector<Command> commands[2]; // By index size
+        std::vector<glm::mat4> matrices; // By object
+        std::vector<Object> objects;
+        const MeshArena* arena = NULL; // Of the objects added so far
+        std::vector<int> counts; // Index ranges of the object being added, from cullMeshlets()
+        std::vector<const void*> offsets;
+        GLBuffer commandBuffer, matrixBuffer;
+
+        // Every object's commands from one buffer, its matrix fetched per instance.
+        void drawIndirect() {
+            if (!commandBuffer) {
+                commandBuffer = GLBuffer::create();
+                matrixBuffer = GLBuffer::create();
+            }
+            // Both commands lists and the matrices are written anew each frame, into fresh storage
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commandCount() * sizeof(Command), NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands[0].size() * sizeof(Command), commands[0].data());
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, commands[0].size() * sizeof(Command), commands[1].size() * sizeof(Command), commands[1].data());
+            glBindBuffer(GL_ARRAY_BUFFER, matrixBuffer);
+            glBufferData(GL_ARRAY_BUFFER, matrices.size() * sizeof(glm::mat4), matrices.data(), GL_STREAM_DRAW);
+            for (GLuint column = 0; column < 4; column++) {
+                glEnableVertexAttribArray(4 + column);
+                glVertexAttribPointer(4 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * column));
+                glVertexAttribDivisor(4 + column, 1);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            if (!commands[0].empty()) {
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void*)0, (GLsizei)commands[0].size(), 0);
+            }
+            if (!commands[1].empty()) {
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(commands[0].size() * sizeof(Command)),
+                                            (GLsizei)commands[1].size(), 0);
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+
+        // One call per object, for drivers without multi-draw indirect.
+        void drawEach() {
+            std::vector<GLsizei> rangeCounts;
+            std::vector<const void*> rangeOffsets;
+            std::vector<GLint> baseVertices;
+            for (GLuint column = 0; column < 4; column++) {
+                glDisableVertexAttribArray(4 + column);
+            }
+            for (size_t i = 0; i < objects.size(); i++) {
+                const Object& object = objects[i];
+                size_t indexSize = object.size == 0 ? 2 : 4;
+                rangeCounts.clear();
+                rangeOffsets.clear();
+                baseVertices.clear();
+                for (size_t c = object.firstCommand; c < object.firstCommand + object.commandCount; c++) {
+                    const Command& command = commands[object.size][c];
+                    rangeCounts.push_back((GLsizei)command.count);
+                    rangeOffsets.push_back((const void*)(command.firstIndex * indexSize));
+                    baseVertices.push_back(command.baseVertex);
+                }
+                for (GLuint column = 0; column < 4; column++) {
+                    glVertexAttrib4fv(4 + column, &matrices[i][column][0]);
+                }
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, rangeCounts.data(), object.size == 0 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                                              rangeOffsets.data(), (GLsizei)rangeCounts.size(), baseVertices.data());
+            }
+        }
+};
+
+#endif
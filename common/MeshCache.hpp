@@ -0,0 +1,323 @@
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+#include "MappedFile.hpp"
+#include "CompactVertex.hpp"
+#include "TextureCompress.hpp"
+
+// Directory, relative to the working directory, where baked meshes are stored.
+#define MESH_CACHE_DIR ".meshcache"
+// Changes whenever the layout or processing of a baked file changes, so files written by older builds are rebaked.
+#define MESH_CACHE_VERSION 7
+// Most mip levels a baked texture can have (enough for 32768 x 32768).
+#define MESH_CACHE_MAX_MIPS 16
+// Alignment of every section of a baked file.
+#define MESH_CACHE_ALIGN 64
+
+// Fixed-size start of a baked file. The identity of its source files follows it as text, then the
+// vertices, indices, meshlets and texture mip levels, each at an aligned offset.
+struct MeshCacheHeader {
+    char magic[8]; // "MESHBAKE"
+    uint32_t version;
+    uint32_t vertexStride; // Size in bytes of one vertex
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint32_t indexSize; // Bytes per index, 2 or 4
+    float positionOffset[3]; // Decoding of the quantized positions, see CompactMesh
+    float positionScale[3];
+    uint32_t textureWidth; // Size of mip level 0, 0 if there is no texture
+    uint32_t textureHeight;
+    uint32_t texelBytes; // Bytes per texel: 4 for the RGBA8 images of BmpLoader.hpp
+    uint32_t textureFormat; // TextureFormat of the stored mip levels: RGBA8, or BC1/BC3 blocks
+    uint32_t textureLayers; // Layers of an array texture, stored one after another in each mip level; 1 otherwise
+    uint32_t mipCount;
+    uint32_t sourceKeyLength; // Length of the source identity text right after the header
+    uint32_t meshletCount;
+    uint64_t vertexOffset; // Offsets of the sections from the start of the file
+    uint64_t indexOffset;
+    uint64_t meshletOffset;
+    uint64_t mipOffset[MESH_CACHE_MAX_MIPS];
+    uint64_t fileSize;
+};
+
+// A cache of meshes baked into GPU-ready form: a CompactMesh (quantized interleaved vertices, 16- or 32-bit
+// indices and the meshlets that split those indices into culling clusters) and a texture with all of its
+// mip levels precomputed, either as RGBA8 texels or compressed to BC1/BC3 blocks (see TextureCompress.hpp).
+//
+// An entry is keyed by the path, size and modification time of each of its source files (the AssetManager
+// bakes each PLY and each BMP as an entry of its own, so shared textures are stored once); touching any of
+// them makes the entry stale and it is baked again on the next load. A valid entry is memory-mapped and its
+// sections are passed straight to OpenGL, so nothing is parsed or converted.
+class MeshCache {
+    public:
+        // Maps the entry for 'sources' if one exists, matches the sources on disk and stores vertices of
+        // 'vertexStride' bytes. Returns false (with nothing mapped) otherwise.
+        bool open(const std::vector<std::string>& sources, uint32_t vertexStride) {
+            std::string key;
+            if (!sourceKey(sources, key)) {
+                return false;
+            }
+            std::unique_ptr<MappedFile> mapping(new MappedFile(entryPath(sources)));
+            if (!mapping->isOpen() || mapping->size < sizeof(MeshCacheHeader)) {
+                return false;
+            }
+
+            const MeshCacheHeader* h = reinterpret_cast<const MeshCacheHeader*>(mapping->data);
+            if (memcmp(h->magic, "MESHBAKE", 8) != 0 || h->version != MESH_CACHE_VERSION || h->vertexStride != vertexStride
+                || h->fileSize != mapping->size || h->mipCount > MESH_CACHE_MAX_MIPS || (h->indexSize != 2 && h->indexSize != 4)
+                || (h->textureFormat != TEXTURE_RGBA8 && h->textureFormat != TEXTURE_BC1 && h->textureFormat != TEXTURE_BC3)
+                || h->textureLayers == 0
+                || h->sourceKeyLength != key.size() || sizeof(MeshCacheHeader) + key.size() > mapping->size
+                || memcmp(mapping->data + sizeof(MeshCacheHeader), key.data(), key.size()) != 0) {
+                return false;
+            }
+            if (!sectionsFit(*h)) {
+                printf("ERROR: %s: a section lies outside the file\n", entryPath(sources).c_str());
+                return false;
+            }
+            file = std::move(mapping);
+            header = h;
+            return true;
+        }
+
+        // Whether an entry is mapped.
+        bool isOpen() const {
+            return header != NULL;
+        }
+
+        const void* vertices() const { return file->data + header->vertexOffset; }
+        uint64_t vertexCount() const { return header->vertexCount; }
+        const void* indices() const { return file->data + header->indexOffset; }
+        uint64_t indexCount() const { return header->indexCount; }
+        uint32_t indexSize() const { return header->indexSize; }
+        glm::vec3 positionOffset() const { return glm::vec3(header->positionOffset[0], header->positionOffset[1], header->positionOffset[2]); }
+        glm::vec3 positionScale() const { return glm::vec3(header->positionScale[0], header->positionScale[1], header->positionScale[2]); }
+        const Meshlet* meshlets() const { return reinterpret_cast<const Meshlet*>(file->data + header->meshletOffset); }
+        uint32_t meshletCount() const { return header->meshletCount; }
+        uint32_t mipCount() const { return header->mipCount; }
+        uint32_t texelBytes() const { return header->texelBytes; }
+        TextureFormat textureFormat() const { return (TextureFormat)header->textureFormat; }
+        uint32_t textureLayers() const { return header->textureLayers; }
+        uint32_t mipWidth(uint32_t level) const { return std::max(1u, header->textureWidth >> level); }
+        uint32_t mipHeight(uint32_t level) const { return std::max(1u, header->textureHeight >> level); }
+        // Bytes of one layer of a mip level; the layers of an array texture follow each other.
+        size_t mipBytes(uint32_t level) const {
+            return header->textureFormat == TEXTURE_RGBA8 ? (size_t)mipWidth(level) * mipHeight(level) * header->texelBytes
+                : textureBytes(textureFormat(), mipWidth(level), mipHeight(level));
+        }
+        const unsigned char* mip(uint32_t level) const {
+            return reinterpret_cast<const unsigned char*>(file->data + header->mipOffset[level]);
+        }
+
+        // Writes the entry for 'sources'. The texture (tightly packed rows of 'texelBytes' bytes per texel,
+        // or NULL for none) is stored with its full mip chain, each level a 2x2 box filter of the one above.
+        // With a compressed 'format' (RGBA8 texels only) every level is filtered first, then encoded. An array
+        // texture of 'layers' layers has them one after another in 'texels', each filtered on its own.
+        // The file is written under a temporary name and renamed, so a reader never maps a partial entry.
+        // Safe to call from several threads.
+        static bool bake(const std::vector<std::string>& sources, const CompactMesh& mesh,
+                         const unsigned char* texels, uint32_t width, uint32_t height, uint32_t texelBytes,
+                         TextureFormat format = TEXTURE_RGBA8, uint32_t layers = 1) {
+            std::string key;
+            if (!sourceKey(sources, key)) {
+                return false;
+            }
+            if (mkdir(MESH_CACHE_DIR, 0755) != 0 && errno != EEXIST) {
+                return false;
+            }
+
+            // Mip levels, down to 1x1.
+            std::vector<std::vector<unsigned char>> mips;
+            layers = std::max(1u, layers);
+            if (texels != NULL && width > 0 && height > 0) {
+                mips.emplace_back(texels, texels + (size_t)width * height * texelBytes * layers);
+                uint32_t w = width, h = height;
+                while ((w > 1 || h > 1) && mips.size() < MESH_CACHE_MAX_MIPS) {
+                    uint32_t dw = std::max(1u, w / 2), dh = std::max(1u, h / 2);
+                    std::vector<unsigned char> next((size_t)dw * dh * texelBytes * layers);
+                    for (uint32_t layer = 0; layer < layers; layer++) {
+                        downsample(mips.back().data() + (size_t)w * h * texelBytes * layer, w, h, texelBytes,
+                                   next.data() + (size_t)dw * dh * texelBytes * layer);
+                    }
+                    mips.push_back(std::move(next));
+                    w = dw;
+                    h = dh;
+                }
+            }
+            if (texelBytes != 4) {
+                format = TEXTURE_RGBA8;
+            }
+            if (format != TEXTURE_RGBA8) {
+                for (size_t level = 0; level < mips.size(); level++) {
+                    uint32_t w = std::max(1u, width >> level), h = std::max(1u, height >> level);
+                    size_t layerBytes = textureBytes(format, w, h);
+                    std::vector<unsigned char> blocks(layerBytes * layers);
+                    for (uint32_t layer = 0; layer < layers; layer++) {
+                        compressTexture(mips[level].data() + (size_t)w * h * 4 * layer, w, h, format, blocks.data() + layerBytes * layer);
+                    }
+                    mips[level].swap(blocks);
+                }
+            }
+
+            MeshCacheHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, "MESHBAKE", 8);
+            header.version = MESH_CACHE_VERSION;
+            header.vertexStride = sizeof(CompactVertex);
+            header.vertexCount = mesh.vertices.size();
+            header.indexCount = mesh.indexCount;
+            header.indexSize = mesh.indexSize;
+            for (int c = 0; c < 3; c++) {
+                header.positionOffset[c] = mesh.positionOffset[c];
+                header.positionScale[c] = mesh.positionScale[c];
+            }
+            header.textureWidth = mips.empty() ? 0 : width;
+            header.textureHeight = mips.empty() ? 0 : height;
+            header.texelBytes = texelBytes;
+            header.textureFormat = format;
+            header.textureLayers = layers;
+            header.mipCount = (uint32_t)mips.size();
+            header.sourceKeyLength = (uint32_t)key.size();
+            header.meshletCount = (uint32_t)mesh.meshlets.size();
+            uint64_t offset = align(sizeof(header) + key.size());
+            header.vertexOffset = offset;
+            offset = align(offset + mesh.vertices.size() * sizeof(CompactVertex));
+            header.indexOffset = offset;
+            offset = align(offset + mesh.indices.size());
+            header.meshletOffset = offset;
+            offset = align(offset + mesh.meshlets.size() * sizeof(Meshlet));
+            for (size_t level = 0; level < mips.size(); level++) {
+                header.mipOffset[level] = offset;
+                offset = align(offset + mips[level].size());
+            }
+            header.fileSize = offset;
+
+            std::string path = entryPath(sources);
+            // Unique to this process and this bake, so threads baking the same entry at once write separate files
+            static std::atomic<unsigned int> serial(0);
+            std::string tmp = path + ".tmp" + std::to_string(getpid()) + "." + std::to_string(serial++);
+            FILE* out = fopen(tmp.c_str(), "wb");
+            if (out == NULL) {
+                return false;
+            }
+            bool ok = write(out, 0, &header, sizeof(header)) && write(out, sizeof(header), key.data(), key.size())
+                && write(out, header.vertexOffset, mesh.vertices.data(), mesh.vertices.size() * sizeof(CompactVertex))
+                && write(out, header.indexOffset, mesh.indices.data(), mesh.indices.size())
+                && write(out, header.meshletOffset, mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+            for (size_t level = 0; ok && level < mips.size(); level++) {
+                ok = write(out, header.mipOffset[level], mips[level].data(), mips[level].size());
+            }
+            // Pads the file to its full size.
+            ok = ok && fflush(out) == 0 && ftruncate(fileno(out), (off_t)header.fileSize) == 0;
+            ok = (fclose(out) == 0) && ok;
+            if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+                unlink(tmp.c_str());
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        std::unique_ptr<MappedFile> file;
+        const MeshCacheHeader* header = NULL;
+
+        // Whether 'count' items of 'itemBytes' bytes from 'offset' end within a file of 'fileSize' bytes, without
+        // overflowing on the way.
+        static bool fits(uint64_t offset, uint64_t count, uint64_t itemBytes, uint64_t fileSize) {
+            return offset <= fileSize && (itemBytes == 0 || count <= (fileSize - offset) / itemBytes);
+        }
+
+        // Whether every section a header describes lies within its file, so that the pointers handed out by
+        // vertices(), indices(), meshlets() and mip() can be read for as many bytes as the header says. The mip
+        // levels are read as RGBA8 texels of 4 bytes when they aren't blocks.
+        static bool sectionsFit(const MeshCacheHeader& h) {
+            if (!fits(h.vertexOffset, h.vertexCount, h.vertexStride, h.fileSize)
+                || !fits(h.indexOffset, h.indexCount, h.indexSize, h.fileSize)
+                || !fits(h.meshletOffset, h.meshletCount, sizeof(Meshlet), h.fileSize)) {
+                return false;
+            }
+            if (h.mipCount > 0 && h.textureFormat == TEXTURE_RGBA8 && h.texelBytes != 4) {
+                return false;
+            }
+            for (uint32_t level = 0; level < h.mipCount; level++) {
+                uint64_t w = std::max(1u, h.textureWidth >> level), ht = std::max(1u, h.textureHeight >> level);
+                // Texels, or 4x4 blocks of 8 (BC1) or 16 (BC3) bytes, per layer
+                uint64_t items = h.textureFormat == TEXTURE_RGBA8 ? w * ht : ((w + 3) / 4) * ((ht + 3) / 4);
+                uint64_t itemBytes = h.textureFormat == TEXTURE_RGBA8 ? 4 : h.textureFormat == TEXTURE_BC1 ? 8 : 16;
+                if (!fits(h.mipOffset[level], items, itemBytes * h.textureLayers, h.fileSize)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static uint64_t align(uint64_t offset) {
+            return (offset + MESH_CACHE_ALIGN - 1) / MESH_CACHE_ALIGN * MESH_CACHE_ALIGN;
+        }
+
+        // Writes 'size' bytes at 'offset'; the gaps between sections read back as zeros.
+        static bool write(FILE* out, uint64_t offset, const void* data, size_t size) {
+            return fseek(out, (long)offset, SEEK_SET) == 0 && (size == 0 || fwrite(data, 1, size, out) == size);
+        }
+
+        // Text identifying the current state of the sources: one "path size mtime" line per file.
+        static bool sourceKey(const std::vector<std::string>& sources, std::string& key) {
+            key.clear();
+            for (const std::string& source : sources) {
+                struct stat info;
+                if (stat(source.c_str(), &info) != 0) {
+                    return false;
+                }
+#ifdef __APPLE__
+                long long nanoseconds = (long long)info.st_mtimespec.tv_sec * 1000000000LL + info.st_mtimespec.tv_nsec;
+#else
+                long long nanoseconds = (long long)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+                key += source + " " + std::to_string((long long)info.st_size) + " " + std::to_string(nanoseconds) + "\n";
+            }
+            return true;
+        }
+
+        // Name of the cache file for 'sources': a 64-bit FNV-1a hash of their paths.
+        static std::string entryPath(const std::vector<std::string>& sources) {
+            uint64_t hash = 14695981039346656037ULL;
+            for (const std::string& source : sources) {
+                for (unsigned char c : source + '\n') {
+                    hash = (hash ^ c) * 1099511628211ULL;
+                }
+            }
+            char name[32];
+            snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+            return std::string(MESH_CACHE_DIR) + "/" + name;
+        }
+
+        // Halves an image in each dimension (down to 1) into 'dst', averaging each 2x2 block of texels.
+        static void downsample(const unsigned char* src, uint32_t w, uint32_t h, uint32_t texelBytes, unsigned char* dst) {
+            uint32_t dw = std::max(1u, w / 2), dh = std::max(1u, h / 2);
+            for (uint32_t y = 0; y < dh; y++) {
+                uint32_t y0 = std::min(2 * y, h - 1), y1 = std::min(2 * y + 1, h - 1);
+                for (uint32_t x = 0; x < dw; x++) {
+                    uint32_t x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+                    for (uint32_t c = 0; c < texelBytes; c++) {
+                        unsigned sum = src[((size_t)y0 * w + x0) * texelBytes + c] + src[((size_t)y0 * w + x1) * texelBytes + c]
+                            + src[((size_t)y1 * w + x0) * texelBytes + c] + src[((size_t)y1 * w + x1) * texelBytes + c];
+                        dst[((size_t)y * dw + x) * texelBytes + c] = (unsigned char)((sum + 2) / 4);
+                    }
+                }
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef MESH_OPTIMIZE_HPP
+#define MESH_OPTIMIZE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "Meshlets.hpp"
+
+// Number of entries of the post-transform vertex cache the triangle order is tuned for. Small FIFO caches
+// like this are the usual model; the order still helps on larger hardware caches.
+#define VERTEX_CACHE_SIZE 16
+
+// Average cache miss ratio: vertex shader invocations per triangle for 'indices' (three per triangle) on a
+// FIFO post-transform cache of 'cacheSize' entries. 3.0 is the worst possible, 0.5 the best for a large grid.
+inline float meshACMR(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = VERTEX_CACHE_SIZE) {
+    if (indexCount < 3) {
+        return 0.0f;
+    }
+    // A vertex is in the cache while fewer than 'cacheSize' misses happened since it was loaded.
+    std::vector<size_t> loadedAt(vertexCount, 0);
+    size_t misses = 0;
+    for (size_t n = 0; n < indexCount; n++) {
+        uint32_t v = indices[n];
+        if (loadedAt[v] == 0 || misses - loadedAt[v] + 1 > cacheSize) {
+            misses++;
+            loadedAt[v] = misses;
+        }
+    }
+    return static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+}
+
+// Reorders the triangles of 'indices' so that consecutive triangles share vertices while they are still in
+// the post-transform cache (the Tipsify algorithm of Sander, Nehab and Barczak, 2007).
+//
+// It walks the mesh fanning around one vertex at a time, emitting all of its remaining triangles, then moves
+// to the neighbour that is still in the cache and has the fewest triangles left, so that vertices are used
+// up before they are evicted. Runs in linear time; the winding of every triangle is kept.
+inline void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = VERTEX_CACHE_SIZE) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Triangles using each vertex, as offsets into one array.
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (size_t n = 0; n < triangleCount * 3; n++) {
+        liveTriangles[indices[n]]++;
+    }
+    std::vector<size_t> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+    }
+    std::vector<uint32_t> adjacency(adjacencyStart[vertexCount]);
+    std::vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int c = 0; c < 3; c++) {
+            adjacency[fill[indices[3 * t + c]]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<size_t> cacheTime(vertexCount, 0); // Time at which each vertex last entered the cache
+    std::vector<uint32_t> deadEnd; // Recently used vertices, to restart from when the fan runs dry
+    std::vector<uint32_t> candidates;
+    size_t time = cacheSize + 1;
+    size_t cursor = 0; // Next vertex to try once 'deadEnd' is empty
+
+    // Finds a vertex with triangles left: the most recent one in 'deadEnd', or else the next in input order.
+    auto skipDeadEnd = [&]() -> long {
+        while (!deadEnd.empty()) {
+            uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveTriangles[v] > 0) {
+                return v;
+            }
+        }
+        while (cursor < vertexCount) {
+            if (liveTriangles[cursor] > 0) {
+                return static_cast<long>(cursor);
+            }
+            cursor++;
+        }
+        return -1;
+    };
+
+    long fan = skipDeadEnd();
+    while (fan >= 0) {
+        candidates.clear();
+        for (size_t a = adjacencyStart[fan]; a < adjacencyStart[fan + 1]; a++) {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = indices[3 * t + c];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time;
+                    time++;
+                }
+            }
+            emitted[t] = 1;
+        }
+
+        // The next fan is the candidate that will still be in the cache after its remaining triangles
+        // are emitted, preferring the one that entered the cache first; otherwise restart elsewhere.
+        long best = -1;
+        long bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (liveTriangles[v] == 0) {
+                continue;
+            }
+            long priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+                priority = static_cast<long>(time - cacheTime[v]);
+            }
+            if (priority > bestPriority) {
+                best = v;
+                bestPriority = priority;
+            }
+        }
+        fan = best >= 0 ? best : skipDeadEnd();
+    }
+
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+// Renumbers the vertices in the order the (already cache-optimised) triangles first use them and moves
+// them in memory accordingly, so the vertex fetch walks the buffer forwards. Vertices no triangle uses
+// are kept, after all the others. 'vertices' holds 'vertexCount' vertices of 'stride' bytes each.
+inline void optimizeVertexFetch(void* vertices, size_t stride, size_t vertexCount, uint32_t* indices, size_t indexCount) {
+    const uint32_t unused = 0xFFFFFFFFu;
+    std::vector<uint32_t> remap(vertexCount, unused);
+    uint32_t next = 0;
+    for (size_t n = 0; n < indexCount; n++) {
+        uint32_t& target = remap[indices[n]];
+        if (target == unused) {
+            target = next++;
+        }
+        indices[n] = target;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        if (remap[v] == unused) {
+            remap[v] = next++;
+        }
+    }
+
+    std::vector<unsigned char> reordered(vertexCount * stride);
+    const unsigned char* source = static_cast<const unsigned char*>(vertices);
+    for (size_t v = 0; v < vertexCount; v++) {
+        memcpy(&reordered[remap[v] * stride], source + v * stride, stride);
+    }
+    memcpy(vertices, reordered.data(), reordered.size());
+}
+
+// Runs all passes over a mesh about to be uploaded and prints its ACMR before and after, labelled 'name'.
+// A triangle order that was already better than what Tipsify finds (e.g. from an earlier optimizer) is kept.
+// The triangles are then grouped into 'meshlets' (see buildMeshlets()), each reordered for the vertex cache
+// on its own, and finally the vertices are renumbered in the order of the final triangle order.
+inline void optimizeMesh(const char* name, void* vertices, size_t stride, size_t vertexCount, uint32_t* indices, size_t indexCount,
+                         std::vector<Meshlet>& meshlets) {
+    float before = meshACMR(indices, indexCount, vertexCount);
+    std::vector<uint32_t> original(indices, indices + indexCount);
+    optimizeVertexCache(indices, indexCount, vertexCount);
+    if (meshACMR(indices, indexCount, vertexCount) > before) {
+        memcpy(indices, original.data(), indexCount * sizeof(uint32_t));
+    }
+
+    // Each meshlet is reordered with its vertices numbered locally, so the work is proportional to its size.
+    meshlets = buildMeshlets(vertices, stride, vertexCount, indices, indexCount);
+    std::vector<uint32_t> local(vertexCount, UINT32_MAX), global, meshletIndices;
+    for (const Meshlet& meshlet : meshlets) {
+        uint32_t* first = indices + meshlet.firstIndex;
+        global.clear();
+        meshletIndices.resize(meshlet.indexCount);
+        for (uint32_t n = 0; n < meshlet.indexCount; n++) {
+            if (local[first[n]] == UINT32_MAX) {
+                local[first[n]] = (uint32_t)global.size();
+                global.push_back(first[n]);
+            }
+            meshletIndices[n] = local[first[n]];
+        }
+        optimizeVertexCache(meshletIndices.data(), meshlet.indexCount, global.size());
+        for (uint32_t n = 0; n < meshlet.indexCount; n++) {
+            first[n] = global[meshletIndices[n]];
+        }
+        for (uint32_t v : global) {
+            local[v] = UINT32_MAX;
+        }
+    }
+    float after = meshACMR(indices, indexCount, vertexCount);
+
+    // Renumbering vertices doesn't change which triangles share them, so the ACMR stays the same, and the
+    // meshlets keep their index ranges and bounds.
+    optimizeVertexFetch(vertices, stride, vertexCount, indices, indexCount);
+    printf("Optimized %s: ACMR %.3f -> %.3f, %zu meshlets\n", name, before, after, meshlets.size());
+}
+
+#endif
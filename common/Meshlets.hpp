@@ -0,0 +1,282 @@
+#ifndef MESHLETS_HPP
+#define MESHLETS_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "Frustum.hpp"
+
+// Most distinct vertices and triangles in one meshlet. These are the limits mesh shader hardware favours,
+// and small enough for the bounds of a cluster to be tight.
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// A cluster of neighbouring triangles that is culled as a whole. Its triangles are a contiguous range of
+// the mesh's index buffer, so surviving meshlets are drawn straight from that buffer.
+struct Meshlet {
+    uint32_t firstIndex; // First index of its triangles in the index buffer
+    uint32_t indexCount; // Three per triangle
+    glm::vec3 center; // Bounding sphere of its vertices
+    float radius;
+    glm::vec3 coneAxis; // Average facing direction of its triangles
+    float coneCutoff; // Sine of the cone's half angle, from the axis to the furthest triangle normal; 1 if it can't be back-face culled
+};
+
+// Computes the bounding sphere and normal cone of the triangles of 'meshlet'.
+inline void meshletBounds(Meshlet& meshlet, const unsigned char* vertices, size_t stride, const uint32_t* indices) {
+    auto position = [&](uint32_t v) {
+        glm::vec3 p;
+        memcpy(&p, vertices + v * stride, sizeof(p));
+        return p;
+    };
+
+    const uint32_t* first = indices + meshlet.firstIndex;
+    glm::vec3 boxMin(position(first[0])), boxMax(boxMin);
+    for (uint32_t n = 1; n < meshlet.indexCount; n++) {
+        glm::vec3 p = position(first[n]);
+        boxMin = glm::min(boxMin, p);
+        boxMax = glm::max(boxMax, p);
+    }
+    meshlet.center = (boxMin + boxMax) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (uint32_t n = 0; n < meshlet.indexCount; n++) {
+        meshlet.radius = std::max(meshlet.radius, glm::length(position(first[n]) - meshlet.center));
+    }
+
+    // Face normals rather than vertex normals, since it is the winding that decides which side faces away.
+    std::vector<glm::vec3> normals;
+    glm::vec3 sum(0.0f);
+    for (uint32_t n = 0; n + 2 < meshlet.indexCount; n += 3) {
+        glm::vec3 a = position(first[n]), b = position(first[n + 1]), c = position(first[n + 2]);
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length > 0.0f) {
+            normals.push_back(normal / length);
+            sum += normals.back();
+        }
+    }
+    meshlet.coneAxis = glm::vec3(0.0f);
+    meshlet.coneCutoff = 1.0f;
+    float sumLength = glm::length(sum);
+    if (normals.empty() || sumLength == 0.0f) {
+        return;
+    }
+    meshlet.coneAxis = sum / sumLength;
+    float minDot = 1.0f;
+    for (const glm::vec3& normal : normals) {
+        minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+    }
+    // Clusters whose normals spread to (almost) a hemisphere are nearly never entirely back-facing.
+    if (minDot > 0.1f) {
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+// Cosine of the largest angle between a triangle's normal and the average normal of the meshlet it joins
+// (60 degrees). Narrow cones let whole meshlets be culled as back-facing; without a limit, meshlets of
+// boxy furniture wrap all the way around and always have a triangle facing the camera.
+#define MESHLET_CONE_LIMIT 0.5f
+// How strongly meshlet building prefers triangles facing like the meshlet over triangles that add fewer
+// new vertices.
+#define MESHLET_CONE_WEIGHT 0.5f
+
+// Splits an index buffer into meshlets of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES
+// triangles and reorders its triangles so that every meshlet is a contiguous range. The vertex position is
+// the three floats at the start of each vertex of 'stride' bytes.
+//
+// Each meshlet grows from a seed triangle by repeatedly adding the neighbouring triangle that brings in the
+// fewest new vertices, favouring triangles facing like the meshlet so far and refusing those outside
+// MESHLET_CONE_LIMIT. Seeds are taken in index order, so a cache-optimised order (optimizeVertexCache())
+// gives compact meshlets that keep most of its vertex reuse.
+inline std::vector<Meshlet> buildMeshlets(const void* vertices, size_t stride, size_t vertexCount, uint32_t* indices, size_t indexCount) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+    auto position = [&](uint32_t v) {
+        glm::vec3 p;
+        memcpy(&p, bytes + v * stride, sizeof(p));
+        return p;
+    };
+    size_t triangleCount = indexCount / 3;
+
+    // Vertices split along UV or normal seams are separate vertices at the same position; neighbours are
+    // found through the position so meshlets can grow across seams. 'corner' numbers the distinct positions.
+    std::vector<uint32_t> order(vertexCount), corner(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        order[v] = (uint32_t)v;
+    }
+    auto less = [&](uint32_t a, uint32_t b) { return memcmp(bytes + a * stride, bytes + b * stride, sizeof(glm::vec3)) < 0; };
+    std::sort(order.begin(), order.end(), less);
+    uint32_t positions = 0;
+    for (size_t n = 0; n < vertexCount; n++) {
+        if (n > 0 && less(order[n - 1], order[n])) {
+            positions++;
+        }
+        corner[order[n]] = positions;
+    }
+    positions = vertexCount > 0 ? positions + 1 : 0;
+
+    // Triangles touching each position, as offsets into one array, and the unit normal of each triangle.
+    std::vector<size_t> adjacencyStart(positions + 1, 0);
+    for (size_t n = 0; n < triangleCount * 3; n++) {
+        adjacencyStart[corner[indices[n]] + 1]++;
+    }
+    for (size_t p = 0; p < positions; p++) {
+        adjacencyStart[p + 1] += adjacencyStart[p];
+    }
+    std::vector<uint32_t> adjacency(adjacencyStart[positions]);
+    std::vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    std::vector<glm::vec3> normals(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        const uint32_t* triangle = indices + 3 * t;
+        for (int c = 0; c < 3; c++) {
+            adjacency[fill[corner[triangle[c]]]++] = (uint32_t)t;
+        }
+        glm::vec3 a = position(triangle[0]), b = position(triangle[1]), c = position(triangle[2]);
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    std::vector<char> used(triangleCount, 0);
+    std::vector<uint32_t> lastMeshlet(vertexCount, UINT32_MAX); // Meshlet that last used each vertex
+    std::vector<uint32_t> candidates; // Unused triangles sharing a vertex with the current meshlet
+    std::vector<uint32_t> candidateOf(triangleCount, UINT32_MAX); // Meshlet that each triangle was last a candidate of
+    size_t cursor = 0; // First triangle that may still be unused, for seeding
+
+    while (true) {
+        while (cursor < triangleCount && used[cursor]) {
+            cursor++;
+        }
+        if (cursor == triangleCount) {
+            break;
+        }
+        uint32_t current = (uint32_t)meshlets.size();
+        Meshlet meshlet;
+        meshlet.firstIndex = (uint32_t)output.size();
+        meshlet.indexCount = 0;
+        uint32_t meshletVertices = 0;
+        glm::vec3 normalSum(0.0f);
+        candidates.clear();
+
+        uint32_t next = (uint32_t)cursor;
+        while (true) {
+            // Adds triangle 'next' and its neighbours as new candidates.
+            const uint32_t* triangle = indices + 3 * next;
+            used[next] = 1;
+            output.insert(output.end(), triangle, triangle + 3);
+            meshlet.indexCount += 3;
+            normalSum += normals[next];
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = triangle[c];
+                if (lastMeshlet[v] == current) {
+                    continue;
+                }
+                lastMeshlet[v] = current;
+                meshletVertices++;
+                for (size_t a = adjacencyStart[corner[v]]; a < adjacencyStart[corner[v] + 1]; a++) {
+                    uint32_t t = adjacency[a];
+                    if (!used[t] && candidateOf[t] != current) {
+                        candidateOf[t] = current;
+                        candidates.push_back(t);
+                    }
+                }
+            }
+            if (meshlet.indexCount == 3 * MESHLET_MAX_TRIANGLES) {
+                break;
+            }
+
+            // Picks the candidate with the lowest cost that still fits, after dropping the ones already taken.
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](uint32_t t) { return used[t] != 0; }),
+                             candidates.end());
+            float sumLength = glm::length(normalSum);
+            glm::vec3 axis = sumLength > 0.0f ? normalSum / sumLength : glm::vec3(0.0f);
+            auto newVertices = [&](uint32_t t) {
+                const uint32_t* other = indices + 3 * t;
+                return (uint32_t)(lastMeshlet[other[0]] != current) + (lastMeshlet[other[1]] != current && other[1] != other[0])
+                    + (lastMeshlet[other[2]] != current && other[2] != other[0] && other[2] != other[1]);
+            };
+            // A triangle fits if the vertex limit allows and it faces within the cone limit of the meshlet.
+            // Degenerate triangles face nowhere and fit any meshlet.
+            auto fits = [&](uint32_t t) {
+                bool facing = sumLength == 0.0f || glm::length(normals[t]) == 0.0f || glm::dot(normals[t], axis) >= MESHLET_CONE_LIMIT;
+                return facing && meshletVertices + newVertices(t) <= MESHLET_MAX_VERTICES;
+            };
+            float bestCost = 0.0f;
+            size_t best = candidates.size();
+            for (size_t n = 0; n < candidates.size(); n++) {
+                uint32_t t = candidates[n];
+                if (!fits(t)) {
+                    continue;
+                }
+                float cost = newVertices(t) + MESHLET_CONE_WEIGHT * (1.0f - glm::dot(normals[t], axis));
+                if (best == candidates.size() || cost < bestCost) {
+                    best = n;
+                    bestCost = cost;
+                }
+            }
+            if (best < candidates.size()) {
+                next = candidates[best];
+                continue;
+            }
+            // No neighbour left: continues with the next triangle in index order, which a cache-optimised
+            // order places close by.
+            while (cursor < triangleCount && used[cursor]) {
+                cursor++;
+            }
+            if (cursor == triangleCount || !fits((uint32_t)cursor)) {
+                break;
+            }
+            next = (uint32_t)cursor;
+        }
+        meshlets.push_back(meshlet);
+    }
+
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+    for (Meshlet& meshlet : meshlets) {
+        meshletBounds(meshlet, bytes, stride, indices);
+    }
+    return meshlets;
+}
+
+// Collects the index ranges of the meshlets that may be visible through 'frustum' (built from the matrix
+// that takes the mesh to clip space) into 'counts' and 'offsets', the arguments of glMultiDrawElements with
+// indices of 'indexSize' bytes. Meshlets that follow each other in the buffer are merged into one range. With
+// 'cullBackfaces', meshlets whose triangles all face away from the camera are dropped too; only use it for
+// meshes whose back faces are never seen. Returns the number of meshlets kept.
+inline size_t cullMeshlets(const std::vector<Meshlet>& meshlets, const Frustum& frustum, bool cullBackfaces,
+                           std::vector<int>& counts, std::vector<const void*>& offsets, size_t indexSize = sizeof(uint32_t)) {
+    counts.clear();
+    offsets.clear();
+    size_t kept = 0;
+    uint32_t rangeEnd = UINT32_MAX;
+    for (const Meshlet& meshlet : meshlets) {
+        if (!frustum.intersectsSphere(meshlet.center, meshlet.radius)) {
+            continue;
+        }
+        // Every triangle faces away if the view direction to any point of the sphere is within 90 degrees
+        // minus the cone's half angle of the cone axis.
+        if (cullBackfaces && frustum.hasEye) {
+            glm::vec3 view = meshlet.center - frustum.eye;
+            if (glm::dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(view) + meshlet.radius) {
+                continue;
+            }
+        }
+        kept++;
+        if (meshlet.firstIndex == rangeEnd) {
+            counts.back() += (int)meshlet.indexCount;
+        } else {
+            counts.push_back((int)meshlet.indexCount);
+            offsets.push_back((const void*)((size_t)meshlet.firstIndex * indexSize));
+        }
+        rangeEnd = meshlet.firstIndex + meshlet.indexCount;
+    }
+    return kept;
+}
+
+#endif
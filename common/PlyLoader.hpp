@@ -0,0 +1,859 @@
+#ifndef PLY_LOADER_HPP
+#define PLY_LOADER_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <thread>
+
+#include "MappedFile.hpp"
+
+// Scalar types a PLY property can have.
+enum PlyType {
+    PLY_INVALID,
+    PLY_INT8,
+    PLY_UINT8,
+    PLY_INT16,
+    PLY_UINT16,
+    PLY_INT32,
+    PLY_UINT32,
+    PLY_FLOAT32,
+    PLY_FLOAT64
+};
+
+// Converts a type name from the header, in either its old ("uchar") or sized ("uint8") spelling.
+inline PlyType plyType(const std::string& name) {
+    if (name == "char" || name == "int8") return PLY_INT8;
+    if (name == "uchar" || name == "uint8") return PLY_UINT8;
+    if (name == "short" || name == "int16") return PLY_INT16;
+    if (name == "ushort" || name == "uint16") return PLY_UINT16;
+    if (name == "int" || name == "int32") return PLY_INT32;
+    if (name == "uint" || name == "uint32") return PLY_UINT32;
+    if (name == "float" || name == "float32") return PLY_FLOAT32;
+    if (name == "double" || name == "float64") return PLY_FLOAT64;
+    return PLY_INVALID;
+}
+
+// Size in bytes of one value of 'type' in a binary file.
+inline size_t plyTypeSize(PlyType type) {
+    switch (type) {
+        case PLY_INT8: case PLY_UINT8: return 1;
+        case PLY_INT16: case PLY_UINT16: return 2;
+        case PLY_INT32: case PLY_UINT32: case PLY_FLOAT32: return 4;
+        case PLY_FLOAT64: return 8;
+        default: return 0;
+    }
+}
+
+// One property of a PLY element, as declared in the header.
+struct PlyProperty {
+    std::string name; // e.g. "x", "nx", "red"
+    PlyType type = PLY_INVALID; // Type of the value; the item type for lists
+    bool isList = false; // Whether this is a "property list <countType> <type> <name>"
+    PlyType countType = PLY_INVALID; // Type of a list's length
+};
+
+// One element of a PLY file ("vertex", "face", ...) and the properties of each of its rows.
+struct PlyElement {
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+
+    // Size in bytes of one binary row, or 0 if rows contain lists and so vary in size.
+    size_t rowSize() const {
+        size_t size = 0;
+        for (const PlyProperty& property : properties) {
+            if (property.isList) {
+                return 0;
+            }
+            size += plyTypeSize(property.type);
+        }
+        return size;
+    }
+
+    // Fewest bytes one row can take: in binary, its fixed values and the lengths of its lists (which may be
+    // empty); in ASCII, a digit and a separator per value.
+    size_t minimumRowSize(bool binary) const {
+        if (!binary) {
+            return 2 * properties.size();
+        }
+        size_t size = 0;
+        for (const PlyProperty& property : properties) {
+            size += plyTypeSize(property.isList ? property.countType : property.type);
+        }
+        return size;
+    }
+};
+
+// Everything the header of a PLY file declares.
+struct PlyHeader {
+    std::string format; // "ascii", "binary_little_endian" or "binary_big_endian"
+    std::vector<PlyElement> elements; // In the order their rows appear in the body
+    size_t bodyOffset = 0; // Offset of the first byte after "end_header"
+
+    // Returns the element called 'name', or NULL if the file has none.
+    const PlyElement* find(const char* name) const {
+        for (const PlyElement& element : elements) {
+            if (element.name == name) {
+                return &element;
+            }
+        }
+        return NULL;
+    }
+};
+
+// Where one vertex property is stored in the caller's vertex struct. Properties with no attribute are skipped,
+// and attributes the file doesn't have keep the vertex's default value.
+struct PlyAttribute {
+    const char* name; // Property name in the header, or several alternatives separated by '|' (e.g. "u|s")
+    size_t offset; // Byte offset of the destination float inside the vertex struct
+    float scale; // Factor applied to the value read (e.g. 1/255 for 8-bit colors)
+};
+
+// Splits the header of the file in 'data' into 'header'. Returns false if it isn't a valid PLY header.
+inline bool parsePlyHeader(const char* data, size_t size, PlyHeader& header) {
+    const char* p = data;
+    const char* end = data + size;
+    bool first = true;
+
+    while (p < end) {
+        // Header lines are short, so copying them into a string costs nothing next to the body.
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (lineEnd == NULL) {
+            return false; // The file ends before "end_header".
+        }
+        std::string line(p, lineEnd);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        p = lineEnd + 1;
+
+        std::vector<std::string> words;
+        size_t start = 0;
+        while (start < line.size()) {
+            size_t stop = line.find_first_of(" \t", start);
+            if (stop == std::string::npos) stop = line.size();
+            if (stop > start) words.push_back(line.substr(start, stop - start));
+            start = stop + 1;
+        }
+
+        if (first) {
+            if (words.size() != 1 || words[0] != "ply") {
+                return false;
+            }
+            first = false;
+        } else if (words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+            continue;
+        } else if (words[0] == "format" && words.size() >= 2) {
+            header.format = words[1];
+        } else if (words[0] == "element" && words.size() >= 3) {
+            PlyElement element;
+            element.name = words[1];
+            element.count = strtoull(words[2].c_str(), NULL, 10);
+            header.elements.push_back(element);
+        } else if (words[0] == "property" && !header.elements.empty()) {
+            PlyProperty property;
+            if (words.size() >= 5 && words[1] == "list") {
+                property.isList = true;
+                property.countType = plyType(words[2]);
+                property.type = plyType(words[3]);
+                property.name = words[4];
+                if (property.countType == PLY_INVALID) {
+                    return false;
+                }
+            } else if (words.size() >= 3) {
+                property.type = plyType(words[1]);
+                property.name = words[2];
+            }
+            if (property.type == PLY_INVALID) {
+                return false;
+            }
+            header.elements.back().properties.push_back(property);
+        } else if (words[0] == "end_header") {
+            header.bodyOffset = p - data;
+            return header.format == "ascii" || header.format == "binary_little_endian" || header.format == "binary_big_endian";
+        }
+    }
+    return false;
+}
+
+// Skips blanks and line breaks. Returns the start of the next token, or 'end'.
+inline const char* plySkipSpace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        p++;
+    }
+    return p;
+}
+
+// Skips the rest of the current line.
+inline const char* plySkipLine(const char* p, const char* end) {
+    const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+    return lineEnd == NULL ? end : lineEnd + 1;
+}
+
+// Reads one ASCII number at 'p' in place and moves 'p' past it. Returns false if there is none.
+template <typename T>
+inline bool plyParseNumber(const char*& p, const char* end, T& value) {
+    p = plySkipSpace(p, end);
+    if (p < end && *p == '+') {
+        p++; // from_chars doesn't accept an explicit plus sign.
+    }
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        return false;
+    }
+    p = result.ptr;
+    return true;
+}
+
+// Whether binary values of this machine are stored least significant byte first.
+inline bool plyHostIsLittleEndian() {
+    const uint16_t probe = 1;
+    unsigned char first;
+    memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+// Reads a value of type T at 'p', reversing its bytes if the file's byte order isn't the machine's.
+template <typename T>
+inline T plyLoad(const char* p, bool swap) {
+    unsigned char bytes[sizeof(T)];
+    memcpy(bytes, p, sizeof(T));
+    if (swap) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    T value;
+    memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+// Reads one binary value of any PLY type at 'p' as a double.
+inline double plyReadBinary(const char* p, PlyType type, bool swap) {
+    switch (type) {
+        case PLY_INT8: return plyLoad<int8_t>(p, false);
+        case PLY_UINT8: return plyLoad<uint8_t>(p, false);
+        case PLY_INT16: return plyLoad<int16_t>(p, swap);
+        case PLY_UINT16: return plyLoad<uint16_t>(p, swap);
+        case PLY_INT32: return plyLoad<int32_t>(p, swap);
+        case PLY_UINT32: return plyLoad<uint32_t>(p, swap);
+        case PLY_FLOAT32: return plyLoad<float>(p, swap);
+        case PLY_FLOAT64: return plyLoad<double>(p, swap);
+        default: return 0.0;
+    }
+}
+
+// Reads a binary list length or vertex index, which must be a non-negative integer.
+inline bool plyReadIndex(const char*& p, const char* end, PlyType type, bool swap, uint32_t& value) {
+    size_t size = plyTypeSize(type);
+    if (type == PLY_FLOAT32 || type == PLY_FLOAT64 || (size_t)(end - p) < size) {
+        return false;
+    }
+    double read = plyReadBinary(p, type, swap);
+    p += size;
+    if (read < 0.0) {
+        return false;
+    }
+    value = static_cast<uint32_t>(read);
+    return true;
+}
+
+// Whether 'name' is one of the '|'-separated alternatives in 'names' (e.g. "u|s|texture_u").
+inline bool plyNameMatches(const char* names, const std::string& name) {
+    const char* start = names;
+    while (true) {
+        const char* stop = strchr(start, '|');
+        size_t length = stop == NULL ? strlen(start) : (size_t)(stop - start);
+        if (length == name.size() && name.compare(0, length, start, length) == 0) {
+            return true;
+        }
+        if (stop == NULL) {
+            return false;
+        }
+        start = stop + 1;
+    }
+}
+
+// One step of a compiled vertex layout.
+struct PlyDecodeStep {
+    enum Kind {
+        SKIP, // Skip one value
+        SKIP_LIST, // Skip a list: its length, then that many items
+        SKIP_LINE, // Skip the rest of an ASCII row
+        CONVERT, // Read a value of 'type', multiply it by 'scale' and store it as a float at 'offset'
+        COPY, // Copy 'bytes' bytes of native floats from 'source' to 'offset' as they are
+        SCALE // Multiply the float already stored at 'offset' by 'scale'
+    };
+    Kind kind;
+    PlyType type; // Type of the value read; the item type for lists
+    PlyType countType; // Type of a list's length
+    size_t source; // Offset of the value inside a fixed-size binary row
+    size_t offset; // Offset of the destination inside the vertex
+    size_t bytes; // Number of bytes a COPY moves
+    float scale;
+};
+
+// The header's vertex properties compiled, once per file, into the steps that decode one row.
+//
+// Every property the caller didn't ask for becomes a cheap skip (or disappears, in fixed-size binary rows),
+// so optional attributes such as colors or extra texture coordinates only cost something in the files that
+// have them. Runs of native floats that sit next to each other both in the row and in the vertex are merged
+// into one copy.
+struct PlyVertexLayout {
+    std::vector<PlyDecodeStep> steps;
+    size_t rowSize = 0; // Size of a binary row, or 0 for ASCII rows and rows with lists
+    bool bulk = false; // Binary rows are laid out exactly like the vertex: copy the block, then run the steps
+
+    PlyVertexLayout(const PlyElement& element, const std::vector<PlyAttribute>& attributes, bool binary, bool swap, size_t stride) {
+        rowSize = binary ? element.rowSize() : 0;
+
+        // The attribute each property is stored in, if any.
+        std::vector<const PlyAttribute*> destination(element.properties.size(), NULL);
+        for (size_t n = 0; n < element.properties.size(); n++) {
+            for (const PlyAttribute& attribute : attributes) {
+                if (!element.properties[n].isList && destination[n] == NULL && plyNameMatches(attribute.name, element.properties[n].name)) {
+                    destination[n] = &attribute;
+                }
+            }
+        }
+
+        // A row is one vertex when every property is a native float stored at its own offset in the row.
+        bulk = rowSize != 0 && rowSize == stride && !swap;
+        size_t source = 0;
+        for (size_t n = 0; n < element.properties.size(); n++) {
+            bulk = bulk && element.properties[n].type == PLY_FLOAT32 && destination[n] != NULL && destination[n]->offset == source;
+            source += plyTypeSize(element.properties[n].type);
+        }
+        if (bulk) {
+            for (size_t n = 0; n < element.properties.size(); n++) {
+                if (destination[n]->scale != 1.0f) {
+                    steps.push_back({PlyDecodeStep::SCALE, PLY_FLOAT32, PLY_INVALID, 0, destination[n]->offset, 0, destination[n]->scale});
+                }
+            }
+            return;
+        }
+
+        source = 0;
+        for (size_t n = 0; n < element.properties.size(); n++) {
+            const PlyProperty& property = element.properties[n];
+            const PlyAttribute* attribute = destination[n];
+            PlyDecodeStep step = {PlyDecodeStep::SKIP, property.type, property.countType, source, 0, 0, 1.0f};
+            source += plyTypeSize(property.type);
+
+            if (property.isList) {
+                step.kind = PlyDecodeStep::SKIP_LIST;
+            } else if (attribute != NULL) {
+                step.offset = attribute->offset;
+                step.scale = attribute->scale;
+                if (rowSize != 0 && !swap && property.type == PLY_FLOAT32 && attribute->scale == 1.0f) {
+                    step.kind = PlyDecodeStep::COPY;
+                    step.bytes = sizeof(float);
+                    PlyDecodeStep* last = steps.empty() ? NULL : &steps.back();
+                    if (last != NULL && last->kind == PlyDecodeStep::COPY
+                        && last->source + last->bytes == step.source && last->offset + last->bytes == step.offset) {
+                        last->bytes += sizeof(float);
+                        continue;
+                    }
+                } else {
+                    step.kind = PlyDecodeStep::CONVERT;
+                }
+            } else if (rowSize != 0) {
+                continue; // Fixed-size rows are addressed directly; nothing to skip.
+            }
+            steps.push_back(step);
+        }
+
+        // In ASCII, the values after the last stored one are skipped together with the line break.
+        if (!binary) {
+            size_t kept = steps.size();
+            while (kept > 0 && (steps[kept - 1].kind == PlyDecodeStep::SKIP || steps[kept - 1].kind == PlyDecodeStep::SKIP_LIST)) {
+                kept--;
+            }
+            if (kept < steps.size()) {
+                steps.resize(kept);
+                steps.push_back({PlyDecodeStep::SKIP_LINE, PLY_INVALID, PLY_INVALID, 0, 0, 0, 1.0f});
+            }
+        }
+    }
+};
+
+// Parses the ASCII vertex row at [p, end) into 'out'.
+inline bool plyReadAsciiVertex(const char*& p, const char* end, const PlyVertexLayout& layout, char* out) {
+    for (const PlyDecodeStep& step : layout.steps) {
+        switch (step.kind) {
+            case PlyDecodeStep::SKIP: {
+                p = plySkipSpace(p, end);
+                const char* token = p;
+                while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+                    p++;
+                }
+                if (p == token) {
+                    return false;
+                }
+                break;
+            }
+            case PlyDecodeStep::SKIP_LIST: {
+                uint32_t length = 0;
+                double unused;
+                if (!plyParseNumber(p, end, length)) {
+                    return false;
+                }
+                for (uint32_t item = 0; item < length; item++) {
+                    if (!plyParseNumber(p, end, unused)) {
+                        return false;
+                    }
+                }
+                break;
+            }
+            case PlyDecodeStep::SKIP_LINE:
+                p = plySkipLine(p, end);
+                break;
+            default: {
+                // Integers are read as integers, which is cheaper than going through the float parser.
+                float value;
+                if (step.type == PLY_FLOAT32 || step.type == PLY_FLOAT64) {
+                    if (!plyParseNumber(p, end, value)) {
+                        return false;
+                    }
+                } else {
+                    const char* token = plySkipSpace(p, end);
+                    int64_t integer;
+                    if (!plyParseNumber(p, end, integer)) {
+                        return false;
+                    }
+                    value = static_cast<float>(integer);
+                    if (p < end && (*p == '.' || *p == 'e' || *p == 'E')) {
+                        // Some exporters write integer properties as "255.0".
+                        p = token;
+                        if (!plyParseNumber(p, end, value)) {
+                            return false;
+                        }
+                    }
+                }
+                value *= step.scale;
+                memcpy(out + step.offset, &value, sizeof(float));
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+// Decodes 'count' binary vertex rows at 'p' into 'out', one vertex of 'stride' bytes each.
+//
+// Rows laid out exactly like the vertex are copied as one block. Other fixed-size rows are decoded by
+// reading each stored property from its place in the row (a strided copy), and rows containing lists are
+// walked value by value.
+inline bool plyReadBinaryVertices(const char*& p, const char* end, const PlyVertexLayout& layout, size_t count,
+                                  bool swap, char* out, size_t stride) {
+    if (layout.rowSize == 0) {
+        for (size_t v = 0; v < count; v++, out += stride) {
+            for (const PlyDecodeStep& step : layout.steps) {
+                size_t items = 1;
+                if (step.kind == PlyDecodeStep::SKIP_LIST) {
+                    uint32_t length = 0;
+                    if (!plyReadIndex(p, end, step.countType, swap, length)) {
+                        return false;
+                    }
+                    items = length;
+                }
+                if ((size_t)(end - p) / plyTypeSize(step.type) < items) {
+                    return false;
+                }
+                if (step.kind == PlyDecodeStep::CONVERT) {
+                    float value = static_cast<float>(plyReadBinary(p, step.type, swap)) * step.scale;
+                    memcpy(out + step.offset, &value, sizeof(float));
+                }
+                p += items * plyTypeSize(step.type);
+            }
+        }
+        return true;
+    }
+
+    if ((size_t)(end - p) / layout.rowSize < count) {
+        return false;
+    }
+    if (layout.bulk) {
+        memcpy(out, p, count * layout.rowSize);
+    }
+    for (size_t v = 0; v < count; v++) {
+        const char* row = p + v * layout.rowSize;
+        char* vertex = out + v * stride;
+        for (const PlyDecodeStep& step : layout.steps) {
+            if (step.kind == PlyDecodeStep::COPY) {
+                memcpy(vertex + step.offset, row + step.source, step.bytes);
+            } else if (step.kind == PlyDecodeStep::SCALE) {
+                float value;
+                memcpy(&value, vertex + step.offset, sizeof(float));
+                value *= step.scale;
+                memcpy(vertex + step.offset, &value, sizeof(float));
+            } else {
+                float value = static_cast<float>(plyReadBinary(row + step.source, step.type, swap)) * step.scale;
+                memcpy(vertex + step.offset, &value, sizeof(float));
+            }
+        }
+    }
+    p += count * layout.rowSize;
+    return true;
+}
+
+// Reads the corners of one face, in ASCII or binary, as a triangle fan: (0, 1, 2), (0, 2, 3), ...
+// The first triangle goes to 'slot' and any further ones are appended to 'extra'. 'filled' tells whether
+// the face had a triangle at all. Indices must be below 'vertexCount'.
+template <typename Tri>
+inline bool plyReadFace(const char*& p, const char* end, const PlyProperty& property, bool binary, bool swap,
+                        size_t vertexCount, Tri* slot, std::vector<Tri>& extra, bool& filled) {
+    uint32_t corners = 0;
+    uint32_t index[3];
+    bool ok = binary ? plyReadIndex(p, end, property.countType, swap, corners) : plyParseNumber(p, end, corners);
+    filled = false;
+
+    // Native 32-bit triangles, by far the most common case, are copied as they are.
+    if (ok && binary && corners == 3 && !swap && plyTypeSize(property.type) == 4 && (size_t)(end - p) >= sizeof(index)) {
+        memcpy(index, p, sizeof(index));
+        p += sizeof(index);
+        if (index[0] >= vertexCount || index[1] >= vertexCount || index[2] >= vertexCount) {
+            return false;
+        }
+        memcpy(slot, index, sizeof(index));
+        filled = true;
+        return true;
+    }
+
+    for (uint32_t c = 0; ok && c < corners; c++) {
+        uint32_t& corner = index[c < 2 ? c : 2];
+        ok = (binary ? plyReadIndex(p, end, property.type, swap, corner) : plyParseNumber(p, end, corner)) && corner < vertexCount;
+        if (ok && c >= 2) {
+            if (!filled) {
+                memcpy(slot, index, sizeof(index));
+                filled = true;
+            } else {
+                Tri tri;
+                memcpy(&tri, index, sizeof(index));
+                extra.push_back(tri);
+            }
+            index[1] = index[2];
+        }
+    }
+    return ok;
+}
+
+// Skips the binary value (or list) of one property at 'p'.
+inline bool plySkipBinary(const char*& p, const char* end, const PlyProperty& property, bool swap) {
+    size_t count = 1;
+    if (property.isList) {
+        uint32_t length = 0;
+        if (!plyReadIndex(p, end, property.countType, swap, length)) {
+            return false;
+        }
+        count = length;
+    }
+    if ((size_t)(end - p) / plyTypeSize(property.type) < count) {
+        return false;
+    }
+    p += count * plyTypeSize(property.type);
+    return true;
+}
+
+// Reads one face row. The first list holds the corners; other face properties (e.g. flags) are skipped.
+// In ASCII, 'end' is the end of the row's line and anything after the corners is ignored.
+template <typename Tri>
+inline bool plyReadFaceRow(const char*& p, const char* end, const PlyElement& element, bool binary, bool swap,
+                           size_t vertexCount, Tri* slot, std::vector<Tri>& extra, bool& filled) {
+    bool cornersRead = false;
+    filled = false;
+    for (const PlyProperty& property : element.properties) {
+        bool ok = true;
+        if (property.isList && !cornersRead) {
+            ok = plyReadFace(p, end, property, binary, swap, vertexCount, slot, extra, filled);
+            cornersRead = true;
+        } else if (binary) {
+            ok = plySkipBinary(p, end, property, swap);
+        } else if (!cornersRead) {
+            double unused;
+            ok = plyParseNumber(p, end, unused);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Where the rows of a PLY body go: vertices are written to 'vertices' (one of 'stride' bytes per row) and
+// the first triangle of face f to faces[f]. Extra triangles of polygons are collected in 'extra', and
+// faces without a triangle are listed in 'empty' so they can be removed afterwards.
+template <typename Tri>
+struct PlyBodyTarget {
+    const PlyElement* vertexElement = NULL;
+    const PlyElement* faceElement = NULL;
+    const PlyVertexLayout* layout = NULL;
+    char* vertices = NULL;
+    size_t stride = 0;
+    Tri* faces = NULL;
+    std::vector<Tri> extra;
+    std::vector<size_t> empty;
+};
+
+// Minimum number of ASCII rows for each extra parsing thread; below this, starting threads costs more
+// than it saves.
+#define PLY_ROWS_PER_THREAD 20000
+
+// Parses an ASCII body, where every row is one line and rows belong to the elements in header order.
+//
+// Large bodies are split into byte ranges that start at a line boundary. Each thread first counts the
+// rows in its range, which gives every range its first row number, then parses its rows straight into
+// their slots of the preallocated arrays. Returns the number of the first bad row in 'badRow' on failure.
+template <typename Tri>
+bool plyReadAsciiBody(const char* p, const char* end, const PlyHeader& header, PlyBodyTarget<Tri>& target, size_t& badRow) {
+    // Number of the first row of the vertex and face elements, and the total number of rows.
+    size_t vertexRow = 0, faceRow = 0, totalRows = 0;
+    for (const PlyElement& element : header.elements) {
+        if (&element == target.vertexElement) vertexRow = totalRows;
+        if (&element == target.faceElement) faceRow = totalRows;
+        totalRows += element.count;
+    }
+    size_t vertexCount = target.vertexElement != NULL ? target.vertexElement->count : 0;
+    size_t faceCount = target.faceElement != NULL ? target.faceElement->count : 0;
+
+    unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = (unsigned int)std::max<size_t>(1, std::min<size_t>(threadCount, totalRows / PLY_ROWS_PER_THREAD));
+
+    // Range boundaries, each moved forward to the start of a line.
+    std::vector<const char*> bounds(threadCount + 1, end);
+    bounds[0] = p;
+    for (unsigned int t = 1; t < threadCount; t++) {
+        const char* split = std::max(bounds[t - 1], p + (end - p) / threadCount * t);
+        bounds[t] = split == p ? p : plySkipLine(split - 1, end);
+    }
+
+    // Calls 'visit' with the start and end of every non-blank line in [from, to).
+    auto forEachLine = [](const char* from, const char* to, auto visit) {
+        while (true) {
+            from = plySkipSpace(from, to);
+            if (from >= to) {
+                return true;
+            }
+            const char* lineEnd = static_cast<const char*>(memchr(from, '\n', to - from));
+            if (lineEnd == NULL) {
+                lineEnd = to;
+            }
+            if (!visit(from, lineEnd)) {
+                return false;
+            }
+            from = lineEnd;
+        }
+    };
+
+    std::vector<size_t> firstRow(threadCount + 1, 0);
+    std::vector<size_t> rowsSeen(threadCount, 0);
+    std::vector<size_t> failedRow(threadCount, (size_t)-1);
+    std::vector<std::vector<Tri>> extra(threadCount);
+    std::vector<std::vector<size_t>> empty(threadCount);
+
+    auto parse = [&](unsigned int t) {
+        size_t row = firstRow[t];
+        forEachLine(bounds[t], bounds[t + 1], [&](const char* line, const char* lineEnd) {
+            bool ok = true;
+            if (row >= vertexRow && row < vertexRow + vertexCount) {
+                ok = plyReadAsciiVertex(line, lineEnd, *target.layout, target.vertices + (row - vertexRow) * target.stride);
+            } else if (row >= faceRow && row < faceRow + faceCount) {
+                bool filled;
+                ok = plyReadFaceRow(line, lineEnd, *target.faceElement, false, false, vertexCount,
+                                    target.faces + (row - faceRow), extra[t], filled);
+                if (ok && !filled) {
+                    empty[t].push_back(row - faceRow);
+                }
+            }
+            if (!ok) {
+                failedRow[t] = row;
+            }
+            row++;
+            return ok;
+        });
+        rowsSeen[t] = row - firstRow[t];
+    };
+
+    if (threadCount == 1) {
+        parse(0);
+    } else {
+        // Row counts of every range, then their running sum gives each range its first row.
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < threadCount; t++) {
+            threads.emplace_back([&, t] {
+                size_t rows = 0;
+                forEachLine(bounds[t], bounds[t + 1], [&](const char*, const char*) { rows++; return true; });
+                firstRow[t + 1] = rows;
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        for (unsigned int t = 0; t < threadCount; t++) {
+            firstRow[t + 1] += firstRow[t];
+        }
+
+        threads.clear();
+        for (unsigned int t = 0; t < threadCount; t++) {
+            threads.emplace_back(parse, t);
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    for (unsigned int t = 0; t < threadCount; t++) {
+        if (failedRow[t] != (size_t)-1) {
+            badRow = failedRow[t];
+            return false;
+        }
+        target.extra.insert(target.extra.end(), extra[t].begin(), extra[t].end());
+        target.empty.insert(target.empty.end(), empty[t].begin(), empty[t].end());
+    }
+
+    // A body that ends early leaves the last rows unwritten.
+    size_t rows = firstRow[threadCount - 1] + rowsSeen[threadCount - 1];
+    if (rows < std::max(vertexRow + vertexCount, faceRow + faceCount)) {
+        badRow = rows;
+        return false;
+    }
+    return true;
+}
+
+// Parses a binary body, element after element.
+template <typename Tri>
+bool plyReadBinaryBody(const char* p, const char* end, const PlyHeader& header, bool swap, PlyBodyTarget<Tri>& target, size_t& badRow) {
+    size_t vertexCount = target.vertexElement != NULL ? target.vertexElement->count : 0;
+    size_t row = 0;
+    for (const PlyElement& element : header.elements) {
+        badRow = row;
+        if (&element == target.vertexElement) {
+            if (!plyReadBinaryVertices(p, end, *target.layout, element.count, swap, target.vertices, target.stride)) {
+                return false;
+            }
+        } else if (&element == target.faceElement) {
+            for (size_t f = 0; f < element.count; f++) {
+                bool filled;
+                if (!plyReadFaceRow(p, end, element, true, swap, vertexCount, target.faces + f, target.extra, filled)) {
+                    badRow = row + f;
+                    return false;
+                }
+                if (!filled) {
+                    target.empty.push_back(f);
+                }
+            }
+        } else if (element.rowSize() > 0) {
+            if ((size_t)(end - p) / element.rowSize() < element.count) {
+                return false;
+            }
+            p += element.count * element.rowSize();
+        } else {
+            for (size_t n = 0; n < element.count; n++) {
+                for (const PlyProperty& property : element.properties) {
+                    if (!plySkipBinary(p, end, property, swap)) {
+                        badRow = row + n;
+                        return false;
+                    }
+                }
+            }
+        }
+        row += element.count;
+    }
+    return true;
+}
+
+// Loads the vertices and triangles of a PLY file, appending them to 'vertices' and 'faces'. The indices of the
+// new triangles are those of the new vertices, so several files can be loaded into the same arrays.
+//
+// The file is memory-mapped and read in place: ASCII numbers are converted where they lie with
+// std::from_chars (on several threads for large files), and binary rows (little or big endian) are decoded
+// straight from the mapping. Each vertex property named in 'attributes' is written as a float at its offset
+// in 'Vertex'; all other fields keep the value of a default-constructed 'Vertex'. 'Tri' must be three 32-bit
+// vertex indices. Faces with more than three corners are split into a triangle fan, whose extra triangles
+// are stored after those of all other faces.
+template <typename Vertex, typename Tri>
+bool loadPLY(const std::string& path, const std::vector<PlyAttribute>& attributes,
+             std::vector<Vertex>& vertices, std::vector<Tri>& faces) {
+    static_assert(sizeof(Tri) == 3 * sizeof(uint32_t), "Tri must hold exactly three 32-bit indices");
+
+    MappedFile file(path);
+    if (!file.isOpen()) {
+        printf("ERROR: Can't open %s\n", path.c_str());
+        return false;
+    }
+    PlyHeader header;
+    if (!parsePlyHeader(file.data, file.size, header)) {
+        printf("ERROR: %s is not a PLY file this loader understands\n", path.c_str());
+        return false;
+    }
+
+    bool binary = header.format != "ascii";
+    bool swap = binary && (header.format == "binary_little_endian") != plyHostIsLittleEndian();
+    const char* body = file.data + header.bodyOffset;
+    const char* end = file.data + file.size;
+
+    // The counts in the header are only trusted once the body is large enough for that many rows, so that a
+    // damaged or hostile header can't make the arrays below huge. The last ASCII line may lack its newline.
+    size_t available = (size_t)(end - body) + (binary ? 0 : 1);
+    for (const PlyElement& element : header.elements) {
+        size_t minimum = element.minimumRowSize(binary);
+        if (minimum > 0 && element.count > available / minimum) {
+            printf("ERROR: %s: the header declares %zu %s rows, more than the file can hold\n", path.c_str(), element.count, element.name.c_str());
+            return false;
+        }
+        available -= element.count * minimum;
+    }
+
+    // Every array is sized from the header before parsing starts, so rows are decoded into their final place.
+    PlyBodyTarget<Tri> target;
+    target.vertexElement = header.find("vertex");
+    target.faceElement = header.find("face");
+    size_t firstVertex = vertices.size();
+    size_t firstFace = faces.size();
+    size_t vertexCount = target.vertexElement != NULL ? target.vertexElement->count : 0;
+    size_t faceCount = target.faceElement != NULL ? target.faceElement->count : 0;
+    if (firstVertex + vertexCount > UINT32_MAX) {
+        printf("ERROR: %s: too many vertices for 32-bit indices\n", path.c_str());
+        return false;
+    }
+    vertices.resize(firstVertex + vertexCount);
+    faces.resize(firstFace + faceCount);
+
+    PlyVertexLayout layout(target.vertexElement != NULL ? *target.vertexElement : PlyElement(), attributes, binary, swap, sizeof(Vertex));
+    target.layout = &layout;
+    target.vertices = reinterpret_cast<char*>(vertices.data() + firstVertex);
+    target.stride = sizeof(Vertex);
+    target.faces = faces.data() + firstFace;
+
+    size_t badRow = 0;
+    bool ok = binary ? plyReadBinaryBody(body, end, header, swap, target, badRow) : plyReadAsciiBody(body, end, header, target, badRow);
+    if (!ok) {
+        printf("ERROR: %s: bad or missing data at row %zu of the body\n", path.c_str(), badRow);
+        vertices.resize(firstVertex);
+        faces.resize(firstFace);
+        return false;
+    }
+
+    // Faces that had no triangle leave a hole; fill it from the end. Extra fan triangles go last.
+    std::sort(target.empty.begin(), target.empty.end());
+    for (size_t n = target.empty.size(); n-- > 0; ) {
+        faces[firstFace + target.empty[n]] = faces.back();
+        faces.pop_back();
+    }
+    faces.insert(faces.end(), target.extra.begin(), target.extra.end());
+
+    // The indices were checked against the file's own vertices; they now refer to where those were appended.
+    if (firstVertex > 0) {
+        uint32_t* index = reinterpret_cast<uint32_t*>(faces.data() + firstFace);
+        for (size_t n = 0; n < 3 * (faces.size() - firstFace); n++) {
+            index[n] += (uint32_t)firstVertex;
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,377 @@
+#ifndef TEXTURE_COMPRESS_HPP
+#define TEXTURE_COMPRESS_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+// Minimum number of 4x4 blocks for each extra encoding thread; below this, starting threads costs more
+// than it saves.
+#define BC_BLOCKS_PER_THREAD 2048
+
+// How the texels of a texture are stored.
+enum TextureFormat {
+    TEXTURE_RGBA8 = 0, // 4 bytes per texel: red, green, blue, alpha
+    TEXTURE_BC1 = 1, // 8 bytes per 4x4 block: two RGB565 endpoints and a 2-bit index per texel; opaque
+    TEXTURE_BC3 = 3, // 16 bytes per 4x4 block: an alpha block (two 8-bit endpoints, 3-bit indices), then a BC1 block
+};
+
+// Bytes of a 'width' x 'height' image in 'format'. Compressed images are padded to whole blocks.
+inline size_t textureBytes(TextureFormat format, uint32_t width, uint32_t height) {
+    if (format == TEXTURE_RGBA8) {
+        return (size_t)width * height * 4;
+    }
+    size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+    return blocks * (format == TEXTURE_BC1 ? 8 : 16);
+}
+
+// The compressed format for an RGBA8 image of 'texelCount' texels: BC3 if any texel isn't fully opaque,
+// else BC1, which is half the size.
+inline TextureFormat compressedFormat(const unsigned char* rgba, size_t texelCount) {
+    for (size_t t = 0; t < texelCount; t++) {
+        if (rgba[4 * t + 3] != 255) {
+            return TEXTURE_BC3;
+        }
+    }
+    return TEXTURE_BC1;
+}
+
+// Rounds an 8-bit color to RGB565, and expands an RGB565 color back to 8 bits per channel as the GPU does.
+inline uint16_t bcPack565(const float color[3]) {
+    auto quantize = [](float value, int maximum) {
+        return (int)std::lround(std::min(std::max(value, 0.0f), 255.0f) * maximum / 255.0f);
+    };
+    return (uint16_t)((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+}
+inline void bcUnpack565(uint16_t packed, int color[3]) {
+    int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// The four colors of a BC1 block with endpoints 'c0' > 'c1': both endpoints and the two colors a third of
+// the way between them.
+inline void bcPalette(uint16_t c0, uint16_t c1, int palette[4][3]) {
+    bcUnpack565(c0, palette[0]);
+    bcUnpack565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+}
+
+// Picks the nearest palette color for each texel of a 4x4 block (16 RGBA texels) into 'indices', two bits
+// per texel starting with the first. Returns the summed squared error.
+inline int bcFitIndices(const unsigned char block[64], uint16_t c0, uint16_t c1, uint32_t& indices) {
+    int palette[4][3];
+    bcPalette(c0, c1, palette);
+    int total = 0;
+    indices = 0;
+    for (int t = 0; t < 16; t++) {
+        int best = 0, bestError = INT32_MAX;
+        for (int i = 0; i < 4; i++) {
+            int dr = block[4 * t] - palette[i][0], dg = block[4 * t + 1] - palette[i][1], db = block[4 * t + 2] - palette[i][2];
+            int error = dr * dr + dg * dg + db * db;
+            if (error < bestError) {
+                best = i;
+                bestError = error;
+            }
+        }
+        indices |= (uint32_t)best << (2 * t);
+        total += bestError;
+    }
+    return total;
+}
+
+// Encodes the colors of a 4x4 block (16 RGBA texels, alpha ignored) as an 8-byte BC1 block.
+//
+// The endpoints start on the principal axis of the colors (the direction along which they spread the most,
+// found by power iteration on their covariance), at the extreme projections pulled in by 1/16 of the range,
+// since the extremes are rarely worth a palette entry. They are then refitted once by least squares to the
+// indices they produced, and whichever pair has the lower error is kept. The endpoints are always stored
+// with c0 > c1, the four-color mode, so the block decodes the same as the color half of a BC3 block.
+inline void encodeBC1Block(const unsigned char block[64], unsigned char out[8]) {
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int t = 0; t < 16; t++) {
+        for (int c = 0; c < 3; c++) {
+            mean[c] += block[4 * t + c] / 16.0f;
+        }
+    }
+    float covariance[3][3] = {};
+    for (int t = 0; t < 16; t++) {
+        float d[3] = {block[4 * t] - mean[0], block[4 * t + 1] - mean[1], block[4 * t + 2] - mean[2]};
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                covariance[i][j] += d[i] * d[j];
+            }
+        }
+    }
+
+    // Power iteration from the covariance row of largest variance
+    int start = 0;
+    for (int i = 1; i < 3; i++) {
+        if (covariance[i][i] > covariance[start][start]) {
+            start = i;
+        }
+    }
+    float axis[3] = {covariance[start][0], covariance[start][1], covariance[start][2]};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3];
+        for (int i = 0; i < 3; i++) {
+            next[i] = covariance[i][0] * axis[0] + covariance[i][1] * axis[1] + covariance[i][2] * axis[2];
+        }
+        float largest = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+        if (largest == 0.0f) {
+            break;
+        }
+        for (int i = 0; i < 3; i++) {
+            axis[i] = next[i] / largest;
+        }
+    }
+    float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+
+    uint16_t c0, c1;
+    if (length == 0.0f) {
+        // One color: both endpoints are its nearest 565 color
+        c0 = c1 = bcPack565(mean);
+    } else {
+        float lowest = 0.0f, highest = 0.0f;
+        for (int i = 0; i < 3; i++) {
+            axis[i] /= length;
+        }
+        for (int t = 0; t < 16; t++) {
+            float projection = 0.0f;
+            for (int c = 0; c < 3; c++) {
+                projection += (block[4 * t + c] - mean[c]) * axis[c];
+            }
+            lowest = std::min(lowest, projection);
+            highest = std::max(highest, projection);
+        }
+        float inset = (highest - lowest) / 16.0f;
+        float e0[3], e1[3];
+        for (int c = 0; c < 3; c++) {
+            e0[c] = mean[c] + axis[c] * (highest - inset);
+            e1[c] = mean[c] + axis[c] * (lowest + inset);
+        }
+        c0 = bcPack565(e0);
+        c1 = bcPack565(e1);
+    }
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+    uint32_t indices;
+    int error = bcFitIndices(block, c0, c1, indices);
+
+    // Least squares refit: each texel is w * e0 + (1 - w) * e1 with w = 1, 0, 2/3 or 1/3 for its index
+    if (c0 != c1 && error > 0) {
+        const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = {0.0f, 0.0f, 0.0f}, bx[3] = {0.0f, 0.0f, 0.0f};
+        for (int t = 0; t < 16; t++) {
+            float a = weights[(indices >> (2 * t)) & 3], b = 1.0f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < 3; c++) {
+                ax[c] += a * block[4 * t + c];
+                bx[c] += b * block[4 * t + c];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) > 1e-6f) {
+            float e0[3], e1[3];
+            for (int c = 0; c < 3; c++) {
+                e0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+                e1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+            }
+            uint16_t r0 = bcPack565(e0), r1 = bcPack565(e1);
+            if (r0 < r1) {
+                std::swap(r0, r1);
+            }
+            uint32_t refitIndices;
+            int refitError = bcFitIndices(block, r0, r1, refitIndices);
+            if (refitError < error) {
+                c0 = r0;
+                c1 = r1;
+                indices = refitIndices;
+                error = refitError;
+            }
+        }
+    }
+    if (c0 == c1) {
+        // Equal endpoints select the three-color mode; index 0 is still the endpoint itself
+        indices = 0;
+    }
+
+    out[0] = (unsigned char)(c0 & 0xFF);
+    out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)(c1 & 0xFF);
+    out[3] = (unsigned char)(c1 >> 8);
+    for (int b = 0; b < 4; b++) {
+        out[4 + b] = (unsigned char)(indices >> (8 * b));
+    }
+}
+
+// Encodes the alpha of a 4x4 block as the 8-byte alpha half of a BC3 block: the largest and smallest alpha as
+// endpoints, with six values evenly spaced between them, and the nearest of the eight for each texel.
+inline void encodeBC3AlphaBlock(const unsigned char block[64], unsigned char out[8]) {
+    int highest = 0, lowest = 255;
+    for (int t = 0; t < 16; t++) {
+        highest = std::max(highest, (int)block[4 * t + 3]);
+        lowest = std::min(lowest, (int)block[4 * t + 3]);
+    }
+    int palette[8] = {highest, lowest};
+    for (int i = 2; i < 8; i++) {
+        palette[i] = ((8 - i) * highest + (i - 1) * lowest) / 7;
+    }
+    uint64_t indices = 0;
+    if (highest > lowest) {
+        for (int t = 0; t < 16; t++) {
+            int best = 0, bestError = 256;
+            for (int i = 0; i < 8; i++) {
+                int error = std::abs(block[4 * t + 3] - palette[i]);
+                if (error < bestError) {
+                    best = i;
+                    bestError = error;
+                }
+            }
+            indices |= (uint64_t)best << (3 * t);
+        }
+    }
+    out[0] = (unsigned char)highest;
+    out[1] = (unsigned char)lowest;
+    for (int b = 0; b < 6; b++) {
+        out[2 + b] = (unsigned char)(indices >> (8 * b));
+    }
+}
+
+// Decodes one BC1 block (8 bytes) or, if 'colorHalf', the color half of a BC3 block into 16 RGBA texels.
+// Alpha is left alone, except for the transparent black of a BC1 block in three-color mode; the color half
+// of a BC3 block is always in four-color mode.
+inline void decodeBC1Block(const unsigned char* in, unsigned char block[64], bool colorHalf = false) {
+    uint16_t c0 = (uint16_t)(in[0] | (in[1] << 8)), c1 = (uint16_t)(in[2] | (in[3] << 8));
+    int palette[4][3];
+    bcPalette(c0, c1, palette);
+    bool transparent = false;
+    if (c0 <= c1 && !colorHalf) {
+        // Three-color mode: the midpoint, then transparent black
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+        transparent = true;
+    }
+    uint32_t indices = (uint32_t)in[4] | ((uint32_t)in[5] << 8) | ((uint32_t)in[6] << 16) | ((uint32_t)in[7] << 24);
+    for (int t = 0; t < 16; t++) {
+        int i = (indices >> (2 * t)) & 3;
+        for (int c = 0; c < 3; c++) {
+            block[4 * t + c] = (unsigned char)palette[i][c];
+        }
+        if (transparent && i == 3) {
+            block[4 * t + 3] = 0;
+        }
+    }
+}
+
+// Decodes the alpha half of a BC3 block into the alpha of 16 RGBA texels.
+inline void decodeBC3AlphaBlock(const unsigned char* in, unsigned char block[64]) {
+    int palette[8] = {in[0], in[1]};
+    if (in[0] > in[1]) {
+        for (int i = 2; i < 8; i++) {
+            palette[i] = ((8 - i) * in[0] + (i - 1) * in[1]) / 7;
+        }
+    } else {
+        // Four values between the endpoints, then 0 and 255
+        for (int i = 2; i < 6; i++) {
+            palette[i] = ((6 - i) * in[0] + (i - 1) * in[1]) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    uint64_t indices = 0;
+    for (int b = 0; b < 6; b++) {
+        indices |= (uint64_t)in[2 + b] << (8 * b);
+    }
+    for (int t = 0; t < 16; t++) {
+        block[4 * t + 3] = (unsigned char)palette[(indices >> (3 * t)) & 7];
+    }
+}
+
+// Runs 'encode(firstBlockRow, lastBlockRow)' over the 'blockRows' rows of 4x4 blocks of an image, split into
+// contiguous ranges across the hardware threads when there are enough blocks to be worth it.
+template <typename Encode>
+inline void forEachBlockRange(uint32_t blockRows, size_t blocksPerRow, Encode encode) {
+    unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = (unsigned int)std::max<size_t>(1, std::min<size_t>(threadCount, blockRows * blocksPerRow / BC_BLOCKS_PER_THREAD));
+    threadCount = std::min(threadCount, std::max(1u, blockRows));
+    if (threadCount == 1) {
+        encode(0u, blockRows);
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < threadCount; t++) {
+        threads.emplace_back(encode, (uint32_t)((uint64_t)blockRows * t / threadCount), (uint32_t)((uint64_t)blockRows * (t + 1) / threadCount));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+// Compresses an RGBA8 image ('width' x 'height' texels, rows tightly packed) to BC1 or BC3 in 'out', which
+// holds textureBytes(format, width, height) bytes. Blocks are stored row by row in the order of the image
+// rows, so an image stored bottom row first (as glTexImage2D expects) gives blocks in the order
+// glCompressedTexImage2D expects. Edge blocks of images whose sides aren't multiples of 4 repeat the last
+// row and column. Rows of blocks are encoded on several threads.
+inline void compressTexture(const unsigned char* rgba, uint32_t width, uint32_t height, TextureFormat format, unsigned char* out) {
+    size_t blocksWide = (width + 3) / 4;
+    size_t blockBytes = format == TEXTURE_BC1 ? 8 : 16;
+    forEachBlockRange((height + 3) / 4, blocksWide, [&](uint32_t firstRow, uint32_t lastRow) {
+        unsigned char block[64];
+        for (uint32_t by = firstRow; by < lastRow; by++) {
+            for (size_t bx = 0; bx < blocksWide; bx++) {
+                for (uint32_t y = 0; y < 4; y++) {
+                    size_t row = std::min(4 * by + y, height - 1);
+                    for (uint32_t x = 0; x < 4; x++) {
+                        size_t column = std::min<size_t>(4 * bx + x, width - 1);
+                        memcpy(block + 4 * (4 * y + x), rgba + 4 * (row * width + column), 4);
+                    }
+                }
+                unsigned char* dst = out + (by * blocksWide + bx) * blockBytes;
+                if (format == TEXTURE_BC3) {
+                    encodeBC3AlphaBlock(block, dst);
+                    dst += 8;
+                }
+                encodeBC1Block(block, dst);
+            }
+        }
+    });
+}
+
+// Decodes a BC1 or BC3 image back to RGBA8 texels, for GPUs without S3TC support and for measuring the
+// compression error.
+inline void decompressTexture(const unsigned char* data, uint32_t width, uint32_t height, TextureFormat format, unsigned char* rgba) {
+    size_t blocksWide = (width + 3) / 4;
+    size_t blockBytes = format == TEXTURE_BC1 ? 8 : 16;
+    unsigned char block[64];
+    for (uint32_t by = 0; by < (height + 3) / 4; by++) {
+        for (size_t bx = 0; bx < blocksWide; bx++) {
+            const unsigned char* src = data + (by * blocksWide + bx) * blockBytes;
+            memset(block, 255, sizeof(block));
+            if (format == TEXTURE_BC3) {
+                decodeBC3AlphaBlock(src, block);
+                src += 8;
+            }
+            decodeBC1Block(src, block, format == TEXTURE_BC3);
+            for (uint32_t y = 0; y < 4 && 4 * by + y < height; y++) {
+                for (uint32_t x = 0; x < 4 && 4 * bx + x < width; x++) {
+                    memcpy(rgba + 4 * ((size_t)(4 * by + y) * width + 4 * bx + x), block + 4 * (4 * y + x), 4);
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+#include <algorithm>
+
+// A fixed set of threads running queued jobs, oldest first. Used for work that must not hold up the main
+// thread, such as parsing and baking assets while frames are being drawn. Jobs still queued when the pool
+// is destroyed are dropped; jobs already running are finished first.
+class WorkerPool {
+    private:
+        std::deque<std::function<void()>> jobs; // Jobs waiting for a thread
+        std::vector<std::thread> threads;
+        bool stopping = false; // Set by the destructor; idle threads exit
+        std::mutex mutex;
+        std::condition_variable wake;
+
+        void run() {
+            for (;;) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+                    if (stopping) {
+                        return;
+                    }
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                job();
+            }
+        }
+
+    public:
+        // Starts 'threadCount' threads, by default one per hardware thread except the one the caller runs on.
+        explicit WorkerPool(unsigned int threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1) {
+            for (unsigned int t = 0; t < std::max(1u, threadCount); t++) {
+                threads.emplace_back([this] { run(); });
+            }
+        }
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+        }
+
+        // Queues a job to run on one of the threads.
+        void submit(std::function<void()> job) {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+            wake.notify_one();
+        }
+};
+
+#endif
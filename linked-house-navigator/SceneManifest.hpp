@@ -0,0 +1,134 @@
+#ifndef SCENE_MANIFEST_HPP
+#define SCENE_MANIFEST_HPP
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// One mesh placed in the scene. The same PLY file can be placed any number of times; the asset manager loads
+// it once for all of its placements.
+struct SceneEntry {
+    std::string ply, bmp; // Mesh, and its layer of the scene's array texture
+    bool cullBackfaces = false; // Skip clusters facing away (solid objects only)
+    bool transparent = false; // Has see-through texels: drawn after the opaque meshes, back to front and blended
+    glm::vec3 position = glm::vec3(0.0f);
+    float yaw = 0.0f; // Rotation about the y axis, in degrees
+    float scale = 1.0f;
+    glm::vec3 boundsCenter = glm::vec3(0.0f); // Bounding sphere of the mesh in its own space, so the scene knows
+    float boundsRadius = 0.0f;                 // where the mesh is without loading it
+    glm::vec3 worldCenter = glm::vec3(0.0f); // The same sphere in the world, set by loadSceneManifest()
+    float worldRadius = 0.0f;
+
+    // Transform from the mesh's space to the world: scaled, turned about y, then moved to 'position'.
+    glm::mat4 model() const {
+        glm::mat4 m = glm::translate(glm::mat4(1.0f), position);
+        m = glm::rotate(m, glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+        return glm::scale(m, glm::vec3(scale));
+    }
+
+    // Distance from 'point' (in world space) to the mesh's bounding sphere; 0 inside it.
+    float distance(const glm::vec3& point) const {
+        return glm::max(0.0f, glm::length(point - worldCenter) - worldRadius);
+    }
+};
+
+// A scene read from a manifest file: the meshes to place, the array texture they share and how far from the
+// camera meshes are kept loaded.
+//
+// The manifest is a text file of one statement per line; '#' starts a comment:
+//
+//     textures <BMP file>...        the layers of the scene's array texture, in order (one line, given once)
+//     radius <load> [<unload>]      meshes closer than 'load' to the camera are loaded, those further than
+//                                   'unload' (default 1.25 x 'load') dropped; in between they stay as they are
+//     mesh <PLY file> <BMP file> <cull> <x> <y> <z> <yaw> <scale> <cx> <cy> <cz> <radius> [<transparent>]
+//                                   a mesh, with its texture (one of the layers), 1 to cull back faces or 0,
+//                                   its position, rotation about y in degrees and scale, the bounding sphere
+//                                   of its vertices as they are in the PLY file and, optionally, 1 if its
+//                                   texture is see-through (default 0)
+//
+// File names can't contain spaces.
+struct SceneManifest {
+    std::vector<std::string> textures;
+    float loadRadius = 10.0f;
+    float unloadRadius = 12.5f;
+    std::vector<SceneEntry> entries;
+};
+
+// Reads the manifest at 'path' into 'scene'. Prints an error naming the line and returns false if the file
+// can't be read, a line isn't understood or a mesh's texture isn't one of the layers.
+inline bool loadSceneManifest(const std::string& path, SceneManifest& scene) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        printf("ERROR: Can't open the scene manifest %s\n", path.c_str());
+        return false;
+    }
+    scene = SceneManifest();
+    char line[4096];
+    char ply[1024], bmp[1024];
+    int lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char keyword[32] = "";
+        int consumed = 0;
+        if (sscanf(line, "%31s%n", keyword, &consumed) != 1) {
+            continue; // Blank line or comment
+        }
+        const char* rest = line + consumed;
+
+        if (strcmp(keyword, "textures") == 0) {
+            int length = 0;
+            while (sscanf(rest, "%1023s%n", bmp, &length) == 1) {
+                scene.textures.push_back(bmp);
+                rest += length;
+            }
+            ok = !scene.textures.empty();
+        } else if (strcmp(keyword, "radius") == 0) {
+            int read = sscanf(rest, "%f %f", &scene.loadRadius, &scene.unloadRadius);
+            if (read == 1) {
+                scene.unloadRadius = scene.loadRadius * 1.25f;
+            }
+            ok = read >= 1 && scene.loadRadius > 0.0f && scene.unloadRadius >= scene.loadRadius;
+        } else if (strcmp(keyword, "mesh") == 0) {
+            SceneEntry entry;
+            int cull = 0, transparent = 0;
+            int read = sscanf(rest, "%1023s %1023s %d %f %f %f %f %f %f %f %f %f %d", ply, bmp, &cull, &entry.position.x, &entry.position.y,
+                              &entry.position.z, &entry.yaw, &entry.scale, &entry.boundsCenter.x, &entry.boundsCenter.y,
+                              &entry.boundsCenter.z, &entry.boundsRadius, &transparent);
+            ok = (read == 12 || read == 13) && entry.scale > 0.0f;
+            if (!ok) {
+                continue;
+            }
+            entry.ply = ply;
+            entry.bmp = bmp;
+            entry.cullBackfaces = cull != 0;
+            entry.transparent = transparent != 0;
+            entry.worldCenter = glm::vec3(entry.model() * glm::vec4(entry.boundsCenter, 1.0f));
+            entry.worldRadius = entry.boundsRadius * entry.scale;
+            if (std::find(scene.textures.begin(), scene.textures.end(), entry.bmp) == scene.textures.end()) {
+                printf("ERROR: %s:%d: %s is not one of the textures listed before it\n", path.c_str(), lineNumber, bmp);
+                fclose(file);
+                return false;
+            }
+            scene.entries.push_back(entry);
+        } else {
+            ok = false;
+        }
+    }
+    fclose(file);
+    if (!ok) {
+        printf("ERROR: %s:%d: can't read this line\n", path.c_str(), lineNumber);
+    }
+    return ok;
+}
+
+#endif
@@ -4,6 +4,8 @@
 #include <vector>
 // Include the string library for using the string class
 #include <string>
+// Include the map library for the loaded meshes, kept by their place in the scene manifest
+#include <map>
 // Include the file stream library for reading from and writing to files
 #include <fstream>
 // Include the string stream library for reading from and writing to strings as streams
@@ -33,6 +35,27 @@
 // Include the chrono library for dealing with time, such as durations, time points, and clocks.
 #include <chrono>
 
+// Include the shared PLY loader, which parses the mesh files in place from a memory mapping
+#include "../common/PlyLoader.hpp"
+// Include the baked mesh cache, which stores each mesh and its texture in GPU-ready form between runs
+#include "../common/MeshCache.hpp"
+// Include the mesh optimizer, which reorders triangles and vertices for the GPU's vertex caches before baking
+#include "../common/MeshOptimize.hpp"
+// Include the meshlets, which split each mesh into small clusters that are culled on the CPU every frame
+#include "../common/Meshlets.hpp"
+// Include the compact vertex format meshes are uploaded in
+#include "../common/CompactVertex.hpp"
+// Include the shared BMP loader, which maps the file and converts its pixels to RGBA8
+#include "../common/BmpLoader.hpp"
+// Include the asset manager, which loads each mesh, texture and shader program once and shares it
+#include "../common/AssetManager.hpp"
+// Include the mesh batch, which draws all the meshes sharing a program with one call
+#include "../common/MeshBatch.hpp"
+// Include the draw queue, which puts the opaque meshes before the transparent ones and sorts both by depth
+#include "../common/DrawQueue.hpp"
+// Include the scene manifest, which lists the meshes of the scene and where they are placed
+#include "SceneManifest.hpp"
+
 // Allows to use library components while not using prefixes
 using namespace std;
 using namespace glm;
@@ -52,385 +75,158 @@ struct TriData{
 	GLuint vertIndex1, vertIndex2, vertIndex3; // Indices of the three vertices that make up the triangle
 };
 
-
-/**
- * Given a file path imagepath, read the data in that bitmapped image
- * and return the raw bytes of color in the data pointer.
- * The width and height of the image are returned in the weight and height pointers,
- * respectively.
- *
- * usage:
- *
- * unsigned char* imageData;
- * unsigned int width, height;
- * loadARGB_BMP("mytexture.bmp", &imageData, &width, &height);
- *
- * Modified from https://github.com/opengl-tutorials/ogl.
- */
-void loadARGB_BMP(const char* imagepath, unsigned char** data, unsigned int* width, unsigned int* height) {
-
-    printf("Reading image %s\n", imagepath);
-
-    // Data read from the header of the BMP file
-    unsigned char header[54];
-    unsigned int dataPos;
-    unsigned int imageSize;
-    // Actual RGBA data
-
-    // Open the file
-    FILE * file = fopen(imagepath,"rb");
-    if (!file){
-        printf("%s could not be opened. Are you in the right directory?\n", imagepath);
-        getchar();
-        return;
-    }
-
-    // Read the header, i.e. the 54 first bytes
-
-    // If less than 54 bytes are read, problem
-    if ( fread(header, 1, 54, file)!=54 ){
-        printf("Not a correct BMP file1\n");
-        fclose(file);
-        return;
-    }
-
-    // Read the information about the image
-    dataPos    = *(int*)&(header[0x0A]);
-    imageSize  = *(int*)&(header[0x22]);
-    *width      = *(int*)&(header[0x12]);
-    *height     = *(int*)&(header[0x16]);
-    // A BMP files always begins with "BM"
-    if ( header[0]!='B' || header[1]!='M' ){
-        printf("Not a correct BMP file2\n");
-        fclose(file);
-        return;
-    }
-    // Make sure this is a 32bpp file
-    if ( *(int*)&(header[0x1E])!=3  ) {
-        printf("Not a correct BMP file3\n");
-        fclose(file);
-        return;
-    }
-    // fprintf(stderr, "header[0x1c]: %d\n", *(int*)&(header[0x1c]));
-    // if ( *(int*)&(header[0x1C])!=32 ) {
-    //     printf("Not a correct BMP file4\n");
-    //     fclose(file);
-    //     return;
-    // }
-
-    // Some BMP files are misformatted, guess missing information
-    if (imageSize==0)    imageSize=(*width)* (*height)*4; // 4 : one byte for each Red, Green, Blue, Alpha component
-    if (dataPos==0)      dataPos=54; // The BMP header is done that way
-
-    // Create a buffer
-    *data = new unsigned char [imageSize];
-
-    if (dataPos != 54) {
-        fread(header, 1, dataPos - 54, file);
-    }
-
-    // Read the actual data from the file into the buffer
-    fread(*data,1,imageSize,file);
-
-    // Everything is in memory now, the file can be closed.
-    fclose (file);
-}
-
 // Define a function to read vertex and triangle data from a PLY file
 void readPLYfile(string fname, vector<VertexData>& vertices, vector<TriData>& faces){
 
-    // Open the PLY file with the given filename.
-    ifstream file(fname);
-    string line, word; // Variables to hold lines and words from the file
-
-    // Initialize counters for faces and vertices
-    int faceCounter = 0;
-    int verticesCounter = 0;
-
-    // Read the first line of the file to skip the PLY header start line
-    getline(file, line);
-    // Loop through the file line by line until the end of the header is reached
-    while (getline(file, line)){
-
-        // Use a string stream to parse the line into words
-        istringstream iss(line);
-
-        // Store the words of the line in a vector
-        vector<string> wordArr;
-
-        // Split the line into words based on space as delimiter and add them to the vector
-        while (getline(iss, word, ' ')){
-            wordArr.push_back(word);
-        }
-        // Check if the end of the header is reached
-        if(wordArr[0] == "end_header") {
-            break;
-        }
-        // Check if the line indicates the number of elements
-        else if (wordArr[0] == "element"){
-            // If it's a line specifying the number of faces, store that number
-            if(wordArr[1] == "face") {
-                faceCounter = stoi(wordArr[2]);
-            }
-            // If it's a line specifying the number of vertices, store that number
-            else if(wordArr[1] == "vertex") {
-                verticesCounter = stoi(wordArr[2]);
-            }
-        }
-    }
-
-    // Read vertex data from the file based on the previously counted number of vertices
-    for (int i = 0; i < verticesCounter; i++){
-        getline(file, line); // Get the line containing vertex data
-        istringstream iss(line);
-
-        // Vector to hold the vertex values as floats
-        vector<float> vertex_values;
-
-        // Parse and convert vertex data from the line into floats
-        while (getline(iss, word, ' ')){
-            vertex_values.push_back(stof(word));
-        }
-
-        // Create a VertexData struct to store the vertex properties and add it to the vertices vector
-        VertexData vertex_properties;
-
-        vertex_properties.x = vertex_values[0];
-        vertex_properties.y = vertex_values[1];
-        vertex_properties.z = vertex_values[2];
-        vertex_properties.nx = vertex_values[3];
-        vertex_properties.ny = vertex_values[4];
-        vertex_properties.nz = vertex_values[5];
-        vertex_properties.u = vertex_values[6];
-        vertex_properties.v = vertex_values[7];
-
-        vertices.push_back(vertex_properties);
-    }
-
-    // Read triangle data from the file based on the previously counted number of faces
-    for (int i = 0; i < faceCounter; i++){
-
-        // Variable to hold the number of vertices per face (should be 3 for a triangle)
-        int vertexVal = 0;
-
-        // Vector to hold the vertex indices for a face
-        vector<int> vertex_values;
-        getline(file, line); // Get the line containing face data
-        istringstream iss(line);
-
-        // Parse the first value in the line which indicates the number of vertices for the face
-        getline(iss, word, ' ');
-        vertexVal = stoi(word);
-
-        // Parse and convert vertex indices from the line into integers
-        while (getline(iss, word, ' ')){
-            vertex_values.push_back(stoi(word));
-        }
-
-        // Create a TriData struct to store the vertex indices of the triangle and add it to the faces vector
-        TriData vertex_indices;
-
-        vertex_indices.vertIndex1 = vertex_values[0];
-        vertex_indices.vertIndex2 = vertex_values[1];
-        vertex_indices.vertIndex3 = vertex_values[2];
+    // Where each PLY vertex property goes in VertexData; properties are matched by name, not by position, and texture coordinates also under the names other exporters use
+    static const vector<PlyAttribute> attributes = {
+        {"x", offsetof(VertexData, x), 1.0f}, {"y", offsetof(VertexData, y), 1.0f}, {"z", offsetof(VertexData, z), 1.0f},
+        {"nx", offsetof(VertexData, nx), 1.0f}, {"ny", offsetof(VertexData, ny), 1.0f}, {"nz", offsetof(VertexData, nz), 1.0f},
+        {"red", offsetof(VertexData, red), 1.0f / 255.0f}, {"green", offsetof(VertexData, green), 1.0f / 255.0f},
+        {"blue", offsetof(VertexData, blue), 1.0f / 255.0f},
+        {"u|s|texture_u", offsetof(VertexData, u), 1.0f}, {"v|t|texture_v", offsetof(VertexData, v), 1.0f},
+    };
+
+    // The shared loader memory-maps the file and parses it in place, sized from the header's counts
+    loadPLY(fname, attributes, vertices, faces);
+}
 
-        faces.push_back(vertex_indices);
-    }
+// The program every textured mesh is drawn with, compiled once and shared through the asset manager
+GLuint buildTexturedProgram(){
+    // Create shader objects for the vertex and fragment shaders
+    GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+    GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
+    // Create vertex shader code; the texture coordinates are attribute 2 of the shared compact mesh layout and the
+    // layer of the scene's array texture is attribute 3. Every mesh of the scene is drawn in the same call, so each
+    // instance brings its own model matrix, which also decodes the compact positions (see MeshBatch)
+    string VertexShaderCode = "\
+        #version 330 core\n\
+        layout(location = 0) in vec3 vertexPosition;\n\
+        layout(location = 2) in vec2 uv;\n\
+        layout(location = 3) in uint layer;\n\
+        layout(location = 4) in mat4 model;\n\
+        out vec2 uv_out;\n\
+        flat out uint layer_out;\n\
+        uniform mat4 VP;\n\
+        void main(){\n\
+        gl_Position = VP * model * vec4(vertexPosition, 1);\n\
+        uv_out = uv;\n\
+        layer_out = layer;\n\
+    }\n";
+
+    // Create fragment shader code; every mesh samples its own layer of the same array texture
+    string FragmentShaderCode = "\
+        #version 330 core\n\
+        in vec2 uv_out;\n\
+        flat in uint layer_out;\n\
+        uniform sampler2DArray tex;\n\
+        void main() {\n\
+        gl_FragColor = texture(tex, vec3(uv_out, layer_out));\n\
+    }\n";
+
+    // Convert vertex shader source code to a C-style string and set it as the source for the vertex shader object
+    char const *VertexSourcePointer = VertexShaderCode.c_str();
+    glShaderSource(VertexShaderID, 1, &VertexSourcePointer, NULL);
+    glCompileShader(VertexShaderID); // Compile the vertex shader
+
+    // Convert fragment shader source code to a C-style string and set it as the source for the fragment shader object
+    char const *FragmentSourcePointer = FragmentShaderCode.c_str();
+    glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer, NULL);
+    glCompileShader(FragmentShaderID); // Compile the fragment shader
+
+    // Create a shader program object and attach the compiled vertex and fragment shaders to it
+    GLuint shaderProgramID = glCreateProgram();
+    glAttachShader(shaderProgramID, VertexShaderID);
+    glAttachShader(shaderProgramID, FragmentShaderID);
+    glLinkProgram(shaderProgramID); // Link the attached shaders to create an executable program
+
+    // Once linked, the shaders can be detached and deleted
+    glDetachShader(shaderProgramID, VertexShaderID);
+    glDetachShader(shaderProgramID, FragmentShaderID);
+    glDeleteShader(VertexShaderID);
+    glDeleteShader(FragmentShaderID);
+    return shaderProgramID;
 }
 
 // A class designed to represent a textured 3D mesh within an OpenGL context and render the mesh with textures applied to it
 class TexturedMesh {
 
-
-    // OpenGL IDs for vertex buffer objects (VBOs), texture objects, and shader program associated with this textured mesh.
-
-    GLuint vertexPosID; // ID for the VBO that stores vertex positions
-    GLuint textureCoordinateID; // ID for the VBO that stores texture coordinates for each vertex
-    GLuint faceIndicesID; // ID for the Element Buffer Object (EBO) or Index Buffer that stores indices of vertices that form each face (triangle) of the mesh
-    GLuint textureObjID; // ID for the texture object that holds the texture image used on the mesh
-    GLuint textureMeshID; // ID for the Vertex Array Object (VAO) that encapsulates the VBOs and EBO for the mesh
-    GLuint shaderProgramID; // ID for the shader program used to render this mesh
+    // Shared handle to the GPU copy of the mesh; objects using the same file share it, and it is freed when the last
+    // object using it goes away
+    MeshHandle mesh; // Compact vertices and indices in the asset manager's shared buffers, plus the meshlets used for culling; empty until loaded
+    // The mesh loading in the background; it is picked up by the first draw after it has been uploaded
+    std::shared_future<MeshHandle> pendingMesh;
 
 	public:
         // Paths to the source files for the mesh and texture data.
         string plyFilePath; // Path to the PLY file containing the mesh data
         string bitmapImgFilePath; // Path to the bitmap image file used as a texture for the mesh
 
-        // Vectors to hold the vertex and face data extracted from the PLY file.
-        vector<VertexData> verticesDataObj;
-        vector<TriData> facesDataObj;
+        // Whether clusters facing away from the camera are skipped; only for meshes whose back faces are never seen
+        bool cullBackfaces;
+        // Whether the texture is see-through, so the mesh is blended over what is behind it, after the opaque meshes
+        bool transparent;
+        // Where the mesh is placed in the world (see SceneEntry::model)
+        mat4 model;
 
-        // Texture data and its dimensions.
-        unsigned char* texture_data;
-        unsigned int texture_width, texture_height;
 
-
-    // Constructor for the TexturedMesh class that initializes a textured mesh object using the specified PLY and bitmap image file paths
-    TexturedMesh(string plyfile_path, string bitmapimg_path){
+    // Constructor for the TexturedMesh class that starts loading the mesh for the specified PLY file path in the background
+    // from 'assets', which loads each file only once however many meshes use it. The bitmap image must be
+    // one of 'texture_layers', the files of the array texture shared by the whole scene, so all meshes can be drawn with it
+    // bound once
+    TexturedMesh(AssetManager& assets, const vector<string>& texture_layers, string plyfile_path, string bitmapimg_path, bool cull_backfaces = false,
+                 bool is_transparent = false, mat4 model_matrix = mat4(1.0f)){
         // Store the file paths for the PLY file and bitmap image to instance variables
         bitmapImgFilePath = bitmapimg_path;
         plyFilePath = plyfile_path;
-
-        // Read the vertex and face (triangle) data from the specified PLY file and store it in the `verticesDataObj` and `facesDataObj` vectors
-        readPLYfile(plyFilePath, verticesDataObj, facesDataObj);
-
-        // Load the texture data from the specified bitmap image file
-        loadARGB_BMP(bitmapImgFilePath.data(), &texture_data, &texture_width, &texture_height);
-
-        // Create shader objects for the vertex and fragment shaders
-        GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-        GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-
-        // Create vertex shader code:
-        string VertexShaderCode = "\
-            #version 330 core\n\
-            layout(location = 0) in vec3 vertexPosition;\n\
-            layout(location = 1) in vec2 uv;\n\
-            out vec2 uv_out;\n\
-            uniform mat4 MVP;\n\
-            void main(){\n\
-            gl_Position = MVP * vec4(vertexPosition, 1);\n\
-            uv_out = uv;\n\
-        }\n";
-
-        // Create fragment shader code:
-        string FragmentShaderCode = "\
-            #version 330 core\n\
-            in vec2 uv_out;\n\
-            uniform sampler2D tex;\n\
-            void main() {\n\
-            gl_FragColor = texture(tex, uv_out);\n\
-        }\n";
-
-        // Generate a VBO for vertex positions and bind it
-        glGenBuffers(1, &vertexPosID);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexPosID);
-
-        // Generate a Vertex Array Object (VAO) and bind it
-        glGenVertexArrays(1, &textureMeshID);
-        glBindVertexArray(textureMeshID);
-
-        // Upload the vertex position data to the GPU and store it in the bound VBO
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GL_FLOAT) * 11 * verticesDataObj.size(), &(verticesDataObj[0]), GL_STATIC_DRAW);
-
-        // Enable the vertex attribute at location 0
-        glEnableVertexAttribArray(0);
-        // Define the layout of the vertex position data in the VBO
-        glVertexAttribPointer(
-            0, // The index of the vertex attribute to configure
-            3, // The number of components per vertex attribute
-            GL_FLOAT, // The data type of each component
-            GL_FALSE, // Whether the data should be normalized
-            sizeof(GL_FLOAT) * 11, // The stride, or distance in bytes, between consecutive vertex attributes
-            (void*) 0 // The first component of the first vertex attribute in the buffer
-        );
-
-        // Generate and bind a buffer for texture coordinates
-        glGenBuffers(1, &textureCoordinateID);
-        glBindBuffer(GL_ARRAY_BUFFER, textureCoordinateID);
-        // Upload texture coordinate data for the vertices to the GPU, storing it in the currently bound buffer
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GL_FLOAT) * 11 * verticesDataObj.size(), &(verticesDataObj[0]), GL_STATIC_DRAW);
-        // Enable the vertex attribute array for texture coordinates at location 1, as it will be used in the shader
-        glEnableVertexAttribArray(1);
-
-        // Specify how the texture coordinate data should be read by the vertex shader from the currently bound buffer
-        glVertexAttribPointer(
-            1, // Attribute index 1 in the shader, where the texture coordinate data will be accessed
-            2, // Number of components per texture coordinate
-            GL_FLOAT, // Type of the components
-            GL_FALSE, // Normalization not required
-            sizeof(GL_FLOAT) * 11, // Bytes between consecutive sets of texture coordinates in the buffer
-            (void*) 36 // The first texture coordinate in the buffer
-        );
-
-        // Generate and bind a buffer for the indices of the mesh faces.
-        glGenBuffers(1, &faceIndicesID);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faceIndicesID);
-        // Upload the indices data to the GPU, storing it in the currently bound element buffer
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GL_UNSIGNED_INT) * 3 * facesDataObj.size(), &(facesDataObj[0]), GL_STATIC_DRAW);
-        // Unbind the Vertex Array Object to avoid accidental modifications
-        glBindVertexArray(0);
-
-        // Convert vertex shader source code to a C-style string and set it as the source for the vertex shader object
-        char const *VertexSourcePointer = VertexShaderCode.c_str();
-        glShaderSource(VertexShaderID, 1, &VertexSourcePointer, NULL);
-        glCompileShader(VertexShaderID); // Compile the vertex shader
-
-        // Convert fragment shader source code to a C-style string and set it as the source for the fragment shader object
-        char const *FragmentSourcePointer = FragmentShaderCode.c_str();
-        glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer, NULL);
-        glCompileShader(FragmentShaderID); // Compile the fragment shader
-
-        // Create a shader program object and attach the compiled vertex and fragment shaders to it
-        shaderProgramID = glCreateProgram();
-        glAttachShader(shaderProgramID, VertexShaderID);
-        glAttachShader(shaderProgramID, FragmentShaderID);
-        glLinkProgram(shaderProgramID); // Link the attached shaders to create an executable program
-
-        // Once linked, the shaders can be detached and deleted
-        glDetachShader(shaderProgramID, VertexShaderID);
-        glDetachShader(shaderProgramID, FragmentShaderID);
-        glDeleteShader(VertexShaderID);
-        glDeleteShader(FragmentShaderID);
-
-        // Generate and bind a texture object to store the texture image.
-        glGenTextures(1, &textureObjID);
-        glBindTexture(GL_TEXTURE_2D, textureObjID);
-
-        // Upload the texture data to the GPU and store it in the currently bound texture object
-        glTexImage2D(
-            GL_TEXTURE_2D, // Target texture type
-            0, // Mipmap level, 0 is the base level
-            GL_RGBA, // Format to store the texture on the GPU
-            texture_width, // Texture width
-            texture_height, // Texture height
-            0, // Border, must be 0
-            GL_BGRA, // Format of the pixel data (matches the loaded texture data)
-            GL_UNSIGNED_BYTE, // Data type of the pixel data
-            texture_data // Pointer to the texture data in memory
-        );
-
-        // Generate mipmaps for the texture to improve texture quality at various distances
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        // Unbind the texture object to avoid accidental modifications
-        glBindTexture(GL_TEXTURE_2D, 0);
+        cullBackfaces = cull_backfaces;
+        transparent = is_transparent;
+        model = model_matrix;
+
+        // On the first load, the PLY file is parsed with readPLYfile, its triangles and vertices are reordered for the
+        // GPU's caches and grouped into clusters with a bounding sphere and a cone around their normals (see optimizeMesh),
+        // and the vertices are quantized to 16 bytes each; the baked copy keeps all of this for the next run
+        // Every vertex carries the layer of the bitmap image in the array texture
+        auto layer = find(texture_layers.begin(), texture_layers.end(), bitmapImgFilePath);
+        if (layer == texture_layers.end()) {
+            printf("ERROR: %s is not a layer of the scene's array texture\n", bitmapImgFilePath.c_str());
+            layer = texture_layers.begin();
+        }
+        // The parsing and baking run on the asset manager's worker threads while frames are drawn
+        pendingMesh = assets.meshAsync<VertexData, TriData>(plyFilePath, readPLYfile, offsetof(VertexData, nx), offsetof(VertexData, u),
+                                                            (uint16_t)(layer - texture_layers.begin()));
+    }
+    // Meshes are moved, never copied: containers build them in place (emplace) and keep them where they are
+    TexturedMesh(TexturedMesh&&) = default;
+    TexturedMesh& operator=(TexturedMesh&&) = default;
+    TexturedMesh(const TexturedMesh&) = delete;
+    TexturedMesh& operator=(const TexturedMesh&) = delete;
+    // Queues the mesh on 'queue' with the scene's program and array texture in 'state'. When the queue reaches it, the mesh
+    // is added to 'batch', which draws the meshes of each of the queue's passes at once, placed in the scene with their model
+    // matrices. Only the clusters that can be on screen with the camera's View-Projection matrix are drawn: those inside the
+    // view frustum and, if enabled, not facing away. The queue sorts the meshes by the depth of their centre in 'view'
+    void submit(DrawQueue& queue, MeshBatch& batch, DrawState state, mat4 VP, mat4 view){
+        // Nothing is drawn until the mesh has been uploaded
+        if (!mesh && isLoaded(pendingMesh)) {
+            mesh = pendingMesh.get();
+        }
+        if (!mesh) {
+            return;
+        }
+        state.vao = mesh->arena != NULL ? mesh->arena->vao() : mesh->vao.id();
+        vec3 center = vec3(model * vec4(mesh->positionOffset + mesh->positionScale * 0.5f, 1.0f));
+        queue.submit(state, viewDepth(view, center), transparent, [this, &batch, VP]() {
+            batch.add(*mesh, model, VP, cullBackfaces);
+        });
     }
-    // The draw function takes a Model-View-Projection matrix (MVP) as input to control the positioning, rotation, and scaling of the mesh in the scene
-    void draw(mat4 MVP){
-
-        // Enable blending to allow for transparent textures
-        glEnable(GL_BLEND);
-        // Set blending function to interpolate pixel alpha values
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-        // Activate the shader program to be used for rendering
-        glUseProgram(shaderProgramID);
-        // Get the location of the 'MVP' uniform variable within the shader program
-        GLuint MatrixID = glGetUniformLocation(shaderProgramID, "MVP");
-        // Pass the MVP matrix to the shader program
-        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-        // Enable 2D texturing
-        glEnable(GL_TEXTURE_2D);
-        // Bind the texture object to be used for the mesh
-        glBindTexture(GL_TEXTURE_2D, textureObjID);
-        // Bind the Vertex Array Object (VAO) that contains our vertex attributes configuration
-        glBindVertexArray(textureMeshID);
-
-        // Draw call to render the mesh as a series of triangles
-        // The number of elements is the total number of indices in the faces data, multiplied by 3 because each face is a triangle (3 vertices)
-        glDrawElements(
-            GL_TRIANGLES,             // Render triangles
-            facesDataObj.size() * 3,  // Total number of vertices to render
-            GL_UNSIGNED_INT,          // Type of the indices
-            0                         // Offset in the EBO (Element Buffer Object)
-        );
-        // Unbind the VAO, shader program, and texture to leave a clean state
-        glBindVertexArray(0);
-        glUseProgram(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
 
+    // Asks 'assets' for the mip levels of 'texture' this mesh needs, from how large its closest visible part appears on screen;
+    // 'focalPixels' is the viewport height divided by 2 tan(fovY / 2)
+    void requestTextureDetail(AssetManager& assets, const TextureHandle& texture, mat4 VP, float focalPixels){
+        if (mesh && texture) {
+            assets.requestTexture(texture, textureDemand(*mesh, Frustum(VP * model), focalPixels, 0.1f));
+        }
     }
 
 };
@@ -465,21 +261,43 @@ int main(){
 		return -1;
 	}
 
-    // Vector to store multiple textured mesh objects
-	vector<TexturedMesh> TextureMesh;
-
-    // Populate the vector with textured mesh objects, specifying paths to PLY files for geometry and bitmap files for textures
-    // Each `TexturedMesh` object loads its data and sets up OpenGL resources in its constructor
-	TextureMesh.push_back(TexturedMesh("./files/Walls.ply", "./files/walls.bmp"));
-	TextureMesh.push_back(TexturedMesh("./files/WoodObjects.ply", "./files/woodobjects.bmp"));
-	TextureMesh.push_back(TexturedMesh("./files/Table.ply", "./files/table.bmp"));
-	TextureMesh.push_back(TexturedMesh("./files/WindowBG.ply", "./files/windowbg.bmp"));
-	TextureMesh.push_back(TexturedMesh("./files/Patio.ply", "./files/patio.bmp"));
-	TextureMesh.push_back(TexturedMesh("./files/Floor.ply", "./files/floor.bmp"));
-	TextureMesh.push_back(TexturedMesh("./files/Bottles.ply", "./files/bottles.bmp"));
-	TextureMesh.push_back(TexturedMesh("./files/DoorBG.ply", "./files/doorbg.bmp"));
-	TextureMesh.push_back(TexturedMesh("./files/MetalObjects.ply", "./files/metalobjects.bmp"));
-	TextureMesh.push_back(TexturedMesh("./files/Curtains.ply", "./files/curtains.bmp"));
+    // Loads each file once and shares it between the meshes using it; declared first so it outlives them
+    AssetManager assets;
+    // The textures start with their mip levels of 64 x 64 texels and smaller, and finer levels are streamed in as the camera comes
+    // closer, within this much GPU memory
+    assets.textureBudget = 16 * 1024 * 1024;
+    // The meshes go into shared buffers, so the whole scene is drawn with one call
+    assets.shareMeshBuffers = true;
+    // The program every mesh is drawn with, and where its View-Projection matrix goes
+    ProgramHandle texturedProgram = assets.program("textured", buildTexturedProgram);
+    GLint VPID = texturedProgram ? glGetUniformLocation(texturedProgram->id, "VP") : -1;
+    // The meshes in view this frame: opaque ones first, front to back, then transparent ones, back to front. The meshes of
+    // each pass are drawn together
+    DrawQueue sceneQueue;
+    MeshBatch sceneBatch;
+
+    // When loading started, to report how long the scene took to appear in full
+    double loadStart = glfwGetTime();
+
+    // The meshes of the scene, where they are placed and how near the camera must come for them to be loaded
+    SceneManifest scene;
+    if (!loadSceneManifest("./files/house.scene", scene)){
+        glfwTerminate();
+        return -1;
+    }
+
+    // The textures of the whole scene, packed into the layers of one array texture so that every mesh is drawn with the same
+    // texture bound; the manifest lists them in the order of the files, so `texbake --array ./files/*.bmp` prebakes the same array.
+    // Unlike the meshes, every layer is loaded whatever the camera's position: the layer numbers are baked into the meshes, so the
+    // array can't change as meshes come and go. Only the 64 x 64 levels of each layer and the finer ones within textureBudget reach
+    // the GPU, but the number of layers, and the first run's bake, still grow with the scene
+    std::shared_future<TextureHandle> pendingHouseTextures = assets.textureArrayAsync(scene.textures);
+    TextureHandle houseTextures; // Empty until the array has been uploaded
+
+    // The meshes of the scene that are loaded, by their index in the manifest. Each `TexturedMesh` object starts loading its data in
+    // its constructor; the meshes appear as they finish loading, while the window is already showing frames
+	map<size_t, TexturedMesh> TextureMesh;
+    bool loading = true; // Until every asset has been uploaded
 
     // Enable depth testing to ensure proper rendering of 3D objects based on their distance from the camera
 	glEnable(GL_DEPTH_TEST);
@@ -495,6 +313,8 @@ int main(){
 
     // Define constants for the field of view, camera movement speed, and camera rotation speed
 	const float FIELD_OF_VIEW = 45.0f;
+    // Pixels per unit of size at unit distance from the camera, for the 800 pixel high window
+    const float FOCAL_PIXELS = 800.0f / (2.0f * tan(radians(FIELD_OF_VIEW) / 2.0f));
     const float CAMERA_FORWARD = 0.05f;
     const float CAMERA_ROTATION = 3.0f;
 
@@ -514,6 +334,32 @@ int main(){
         // Process pending GLFW events.
 		glfwPollEvents();
 
+        // Start loading the meshes the camera has come near, and drop those it has left far behind; a mesh's GPU memory is freed
+        // as soon as the last of its placements is erased
+        for (size_t i = 0; i < scene.entries.size(); i++){
+            const SceneEntry& entry = scene.entries[i];
+            float distance = entry.distance(cameraPos);
+            auto placed = TextureMesh.find(i);
+            if (placed == TextureMesh.end() && distance < scene.loadRadius){
+                TextureMesh.emplace(piecewise_construct, forward_as_tuple(i),
+                                    forward_as_tuple(assets, scene.textures, entry.ply, entry.bmp, entry.cullBackfaces, entry.transparent, entry.model()));
+            } else if (placed != TextureMesh.end() && distance > scene.unloadRadius){
+                TextureMesh.erase(placed);
+            }
+        }
+
+        // Upload the assets that finished loading in the background since the last frame
+        assets.update();
+        if (!houseTextures && isLoaded(pendingHouseTextures)) {
+            houseTextures = pendingHouseTextures.get();
+        }
+        // Report what the scene keeps resident once everything has loaded
+        if (loading && assets.pendingLoads() == 0) {
+            printf("Scene loaded in %.0f ms\n", (glfwGetTime() - loadStart) * 1000.0);
+            assets.printResidency();
+            loading = false;
+        }
+
         // Handle user input to control the camera's position and orientation
 		if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS){
 			cameraPos = cameraPos + (cameraDir * CAMERA_FORWARD); // Move camera forward
@@ -539,15 +385,35 @@ int main(){
         mat4 viewMatrix = lookAt(cameraPos, center, upVector);
 
         // Combine the projection and view matrices for use in the shader
-		mat4 MVP = projectionMatrix * viewMatrix;
+		mat4 VP = projectionMatrix * viewMatrix;
 
         // Clear the color and depth buffers.
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Render each textured mesh using the combined Model-View-Projection matrix.
-		for (int i = 0; i < TextureMesh.size(); i++){
-			TextureMesh[i].draw(MVP);
-		}
+        // Queue every loaded mesh with the scene's program and array texture. The queue sorts them, and the visible clusters of
+        // the opaque meshes are rendered in one call with blending off, then those of the transparent ones in another, blended;
+        // CPU time no longer grows with the number of draw calls
+        if (texturedProgram) {
+            glUseProgram(texturedProgram->id);
+            glUniformMatrix4fv(VPID, 1, GL_FALSE, &VP[0][0]);
+            DrawState sceneState;
+            sceneState.program = texturedProgram->id;
+            sceneState.textureTarget = GL_TEXTURE_2D_ARRAY;
+            sceneState.texture = houseTextures ? houseTextures->id.id() : 0;
+            sceneQueue.clear();
+            for (auto& placed : TextureMesh){
+                placed.second.submit(sceneQueue, sceneBatch, sceneState, VP, viewMatrix);
+            }
+            sceneBatch.clear();
+            sceneQueue.flush([&](bool) {
+                sceneBatch.draw();
+                sceneBatch.clear();
+            });
+        }
+        // Ask for the texture detail the visible meshes need; the next frames stream in finer levels of the scene's textures
+        for (auto& placed : TextureMesh){
+            placed.second.requestTextureDetail(assets, houseTextures, VP, FOCAL_PIXELS);
+        }
 
         // Swap the front and back buffers, displaying the rendered frame.
 		glfwSwapBuffers(window);
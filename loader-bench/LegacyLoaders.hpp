@@ -0,0 +1,280 @@
+#ifndef LEGACY_LOADERS_HPP
+#define LEGACY_LOADERS_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// The loaders the Linked House Navigator and the Water Simulation used before PlyLoader.hpp and BmpLoader.hpp,
+// kept as the baseline the benchmark compares the current ones with. The code is the original's apart from
+// plain types in place of the GL ones, checked fread() results and the removal of the progress messages and
+// of the getchar() on a missing file, so the timings measure the loading alone. They read ASCII PLY files only, the house loader expects exactly
+// the x y z nx ny nz u v layout, and each BMP loader reads one pixel format (32-bit with bit fields, or 24-bit).
+namespace legacy {
+
+// Vertex and triangle types of a4.cpp, also used for its current loader
+struct HouseVertex {
+    float x, y, z;
+    float nx, ny, nz;
+    float red, green, blue;
+    float u, v;
+};
+struct HouseTri {
+    uint32_t vertIndex1, vertIndex2, vertIndex3;
+};
+
+// Vertex and triangle types of A6-Water.cpp, also used for its current loader
+struct WaterVertex {
+    glm::vec3 pos;
+    glm::vec3 normal;
+    glm::vec3 color;
+    glm::vec2 texturePoints;
+
+    WaterVertex(glm::vec3 pos, glm::vec3 norm, glm::vec3 col, glm::vec2 tex) : pos(pos), normal(norm), color(col), texturePoints(tex) {}
+    WaterVertex() : pos(0.0f), normal(0.0f), color(1.0f), texturePoints(0.0f) {} // As in A6-Water.cpp, for loadPLY()
+};
+struct WaterTri {
+    uint32_t vertex_indices[3];
+};
+
+// a4.cpp's readPLYfile: every line split into strings, then converted with stof/stoi.
+inline void readPLYfile(std::string fname, std::vector<HouseVertex>& vertices, std::vector<HouseTri>& faces) {
+    using namespace std;
+    ifstream file(fname);
+    string line, word;
+    int faceCounter = 0;
+    int verticesCounter = 0;
+
+    getline(file, line);
+    while (getline(file, line)) {
+        istringstream iss(line);
+        vector<string> wordArr;
+        while (getline(iss, word, ' ')) {
+            wordArr.push_back(word);
+        }
+        if (wordArr[0] == "end_header") {
+            break;
+        } else if (wordArr[0] == "element") {
+            if (wordArr[1] == "face") {
+                faceCounter = stoi(wordArr[2]);
+            } else if (wordArr[1] == "vertex") {
+                verticesCounter = stoi(wordArr[2]);
+            }
+        }
+    }
+
+    for (int i = 0; i < verticesCounter; i++) {
+        getline(file, line);
+        istringstream iss(line);
+        vector<float> vertex_values;
+        while (getline(iss, word, ' ')) {
+            vertex_values.push_back(stof(word));
+        }
+        HouseVertex vertex_properties;
+        vertex_properties.x = vertex_values[0];
+        vertex_properties.y = vertex_values[1];
+        vertex_properties.z = vertex_values[2];
+        vertex_properties.nx = vertex_values[3];
+        vertex_properties.ny = vertex_values[4];
+        vertex_properties.nz = vertex_values[5];
+        vertex_properties.u = vertex_values[6];
+        vertex_properties.v = vertex_values[7];
+        vertices.push_back(vertex_properties);
+    }
+
+    for (int i = 0; i < faceCounter; i++) {
+        int vertexVal = 0;
+        vector<int> vertex_values;
+        getline(file, line);
+        istringstream iss(line);
+        getline(iss, word, ' ');
+        vertexVal = stoi(word);
+        (void)vertexVal;
+        while (getline(iss, word, ' ')) {
+            vertex_values.push_back(stoi(word));
+        }
+        HouseTri vertex_indices;
+        vertex_indices.vertIndex1 = vertex_values[0];
+        vertex_indices.vertIndex2 = vertex_values[1];
+        vertex_indices.vertIndex3 = vertex_values[2];
+        faces.push_back(vertex_indices);
+    }
+}
+
+// A6-Water.cpp's readPLYFile: properties matched by name, values read with operator>>.
+inline void readPLYFile(const std::string& fname, std::vector<WaterVertex>& vertices, std::vector<WaterTri>& faces) {
+    std::ifstream file(fname);
+    if (!file) {
+        std::cerr << "Error opening file: " << fname << std::endl;
+        return;
+    }
+
+    std::string line;
+    int numVerts = 0, numFaces = 0;
+    std::vector<std::string> properties;
+    while (std::getline(file, line) && line != "end_header") {
+        std::istringstream stream(line);
+        std::string token;
+        stream >> token;
+        if (token == "element") {
+            stream >> token;
+            if (token == "vertex") stream >> numVerts;
+            else if (token == "face") stream >> numFaces;
+        } else if (token == "property") {
+            stream >> token;
+            stream >> token;
+            properties.push_back(token);
+        }
+    }
+
+    for (int i = 0; i < numVerts; ++i) {
+        std::getline(file, line);
+        std::istringstream stream(line);
+        glm::vec3 position, normal, color(1.0f);
+        glm::vec2 textureCoords;
+        for (size_t i = 0; i < properties.size(); ++i) {
+            const auto& prop = properties[i];
+            if (prop == "x") stream >> position.x;
+            else if (prop == "red") {
+                float r;
+                stream >> r;
+                color.r = r / 255.0f;
+            }
+            else if (prop == "green") {
+                float g;
+                stream >> g;
+                color.g = g / 255.0f;
+            }
+            else if (prop == "ny") stream >> normal.y;
+            else if (prop == "y") stream >> position.y;
+            else if (prop == "nx") stream >> normal.x;
+            else if (prop == "z") stream >> position.z;
+            else if (prop == "blue") {
+                float b;
+                stream >> b;
+                color.b = b / 255.0f;
+            }
+            else if (prop == "u") stream >> textureCoords.x;
+            else if (prop == "nz") stream >> normal.z;
+            else if (prop == "v") stream >> textureCoords.y;
+        }
+        vertices.emplace_back(position, normal, color, textureCoords);
+    }
+
+    for (int i = 0; i < numFaces; ++i) {
+        std::getline(file, line);
+        std::istringstream stream(line);
+        unsigned int numVertices;
+        stream >> numVertices;
+        WaterTri tri;
+        for (int j = 0; j < 3; ++j) {
+            stream >> tri.vertex_indices[j];
+        }
+        faces.push_back(tri);
+    }
+    file.close();
+}
+
+// a4.cpp's loadARGB_BMP: 32-bit files with bit fields (compression 3), read into a new[] buffer as stored.
+inline void loadARGB_BMP(const char* imagepath, unsigned char** data, unsigned int* width, unsigned int* height) {
+    unsigned char header[54];
+    unsigned int dataPos;
+    unsigned int imageSize;
+
+    FILE* file = fopen(imagepath, "rb");
+    if (!file) {
+        printf("%s could not be opened. Are you in the right directory?\n", imagepath);
+        return;
+    }
+    if (fread(header, 1, 54, file) != 54) {
+        printf("Not a correct BMP file1\n");
+        fclose(file);
+        return;
+    }
+
+    dataPos = *(int*)&(header[0x0A]);
+    imageSize = *(int*)&(header[0x22]);
+    *width = *(int*)&(header[0x12]);
+    *height = *(int*)&(header[0x16]);
+    if (header[0] != 'B' || header[1] != 'M') {
+        printf("Not a correct BMP file2\n");
+        fclose(file);
+        return;
+    }
+    if (*(int*)&(header[0x1E]) != 3) {
+        printf("Not a correct BMP file3\n");
+        fclose(file);
+        return;
+    }
+
+    if (imageSize == 0) imageSize = (*width) * (*height) * 4;
+    if (dataPos == 0) dataPos = 54;
+
+    *data = new unsigned char[imageSize];
+    if (dataPos != 54) {
+        if (fread(header, 1, dataPos - 54, file) != dataPos - 54) {
+            printf("Not a correct BMP file1\n");
+        }
+    }
+    if (fread(*data, 1, imageSize, file) != imageSize) {
+        printf("Not a correct BMP file1\n");
+    }
+    fclose(file);
+}
+
+// The water simulation's loadBMP (PlaneMesh.hpp): uncompressed 24-bit files, read into a new[] buffer as stored.
+inline void loadBMP(const char* imagepath, unsigned char** data, unsigned int* width, unsigned int* height) {
+    unsigned char header[54];
+    unsigned int dataPos;
+    unsigned int imageSize;
+
+    FILE* file = fopen(imagepath, "rb");
+    if (!file) {
+        printf("%s could not be opened. Are you in the right directory?\n", imagepath);
+        return;
+    }
+    if (fread(header, 1, 54, file) != 54) {
+        printf("Not a correct BMP file\n");
+        fclose(file);
+        return;
+    }
+    if (header[0] != 'B' || header[1] != 'M') {
+        printf("Not a correct BMP file\n");
+        fclose(file);
+        return;
+    }
+    if (*(int*)&(header[0x1E]) != 0) {
+        printf("Not a correct BMP file\n");
+        fclose(file);
+        return;
+    }
+    if (*(int*)&(header[0x1C]) != 24) {
+        printf("Not a correct BMP file\n");
+        fclose(file);
+        return;
+    }
+
+    dataPos = *(int*)&(header[0x0A]);
+    imageSize = *(int*)&(header[0x22]);
+    *width = *(int*)&(header[0x12]);
+    *height = *(int*)&(header[0x16]);
+
+    if (imageSize == 0) imageSize = (*width) * (*height) * 3;
+    if (dataPos == 0) dataPos = 54;
+
+    *data = new unsigned char[imageSize];
+    if (fread(*data, 1, imageSize, file) != imageSize) {
+        printf("Not a correct BMP file\n");
+    }
+    fclose(file);
+}
+
+}
+
+#endif
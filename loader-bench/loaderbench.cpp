@@ -0,0 +1,410 @@
+// Benchmarks every asset loader in the tree on synthetic files far larger than the real assets, so changes to
+// the loaders can be judged by how they scale. It writes ASCII and binary PLY files with the property layout of
+// the house files (x y z nx ny nz u v, triangles as uchar/uint lists) and 24- and 32-bit BMP files, then
+// loads each with:
+//
+//     readPLYfile, readPLYFile    the current loaders of the two programs (loadPLY() with their attribute tables)
+//     loadBMP                     the current BMP loader of both programs
+//     ... (original)              the loaders they replaced, from LegacyLoaders.hpp, on the files they can read
+//
+// Each load runs in a child process of its own, so the peak resident memory reported is that of one load,
+// mapped file pages included. Loads are repeated until they have taken a quarter of a second (at most 5 times)
+// and the fastest is reported. The files are read from the page cache, so this measures parsing, not the disk.
+//
+// Build with `g++ -O2 -std=c++17 loaderbench.cpp -o loaderbench -pthread` and run it from any folder:
+//
+//     ./loaderbench [--full] [--keep] [--dir folder]
+//
+// By default it goes up to 1M vertices and 4096 x 4096 texels. --full goes on to 50M vertices and 16384 x 16384
+// texels, which needs about 6 GB of disk and as much memory. The files are written to --dir (bench-data by
+// default) and deleted once measured, unless --keep is given; kept files are reused by the next run.
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <algorithm>
+
+#include "../common/PlyLoader.hpp"
+#include "../common/BmpLoader.hpp"
+#include "LegacyLoaders.hpp"
+
+// Repetitions of one load: until they add up to BENCH_MIN_SECONDS, at most BENCH_MAX_RUNS.
+#define BENCH_MIN_SECONDS 0.25
+#define BENCH_MAX_RUNS 5
+
+using legacy::HouseVertex;
+using legacy::HouseTri;
+using legacy::WaterVertex;
+using legacy::WaterTri;
+
+// The attribute tables readPLYfile in a4.cpp and readPLYFile in A6-Water.cpp pass to loadPLY().
+static const std::vector<PlyAttribute> houseAttributes = {
+    {"x", offsetof(HouseVertex, x), 1.0f}, {"y", offsetof(HouseVertex, y), 1.0f}, {"z", offsetof(HouseVertex, z), 1.0f},
+    {"nx", offsetof(HouseVertex, nx), 1.0f}, {"ny", offsetof(HouseVertex, ny), 1.0f}, {"nz", offsetof(HouseVertex, nz), 1.0f},
+    {"red", offsetof(HouseVertex, red), 1.0f / 255.0f}, {"green", offsetof(HouseVertex, green), 1.0f / 255.0f},
+    {"blue", offsetof(HouseVertex, blue), 1.0f / 255.0f},
+    {"u|s|texture_u", offsetof(HouseVertex, u), 1.0f}, {"v|t|texture_v", offsetof(HouseVertex, v), 1.0f},
+};
+static const std::vector<PlyAttribute> waterAttributes = {
+    {"x", offsetof(WaterVertex, pos), 1.0f},
+    {"y", offsetof(WaterVertex, pos) + sizeof(float), 1.0f},
+    {"z", offsetof(WaterVertex, pos) + 2 * sizeof(float), 1.0f},
+    {"nx", offsetof(WaterVertex, normal), 1.0f},
+    {"ny", offsetof(WaterVertex, normal) + sizeof(float), 1.0f},
+    {"nz", offsetof(WaterVertex, normal) + 2 * sizeof(float), 1.0f},
+    {"red", offsetof(WaterVertex, color), 1.0f / 255.0f},
+    {"green", offsetof(WaterVertex, color) + sizeof(float), 1.0f / 255.0f},
+    {"blue", offsetof(WaterVertex, color) + 2 * sizeof(float), 1.0f / 255.0f},
+    {"u|s|texture_u", offsetof(WaterVertex, texturePoints), 1.0f},
+    {"v|t|texture_v", offsetof(WaterVertex, texturePoints) + sizeof(float), 1.0f},
+};
+
+// ---- Synthetic files ----
+
+// Number of triangles writePLY() writes for 'vertexCount' vertices: two for each grid cell whose four corners exist.
+static size_t gridTriangles(size_t vertexCount, size_t columns) {
+    size_t fullRows = vertexCount / columns, rest = vertexCount % columns;
+    size_t cells = fullRows > 0 ? (fullRows - 1) * (columns - 1) : 0;
+    if (fullRows > 0 && rest > 1) {
+        cells += rest - 1;
+    }
+    return cells * 2;
+}
+
+// Writes a PLY file of 'vertexCount' vertices laid out as a square grid, a gently rolling surface with its normals
+// and texture coordinates, and the triangles of the grid. Values are written as Blender writes them.
+static bool writePLY(const std::string& path, size_t vertexCount, bool binary) {
+    FILE* out = fopen(path.c_str(), "wb");
+    if (out == NULL) {
+        printf("ERROR: Can't create %s\n", path.c_str());
+        return false;
+    }
+    size_t columns = std::max<size_t>(2, (size_t)ceil(sqrt((double)vertexCount)));
+    size_t rows = (vertexCount + columns - 1) / columns;
+    size_t triangles = gridTriangles(vertexCount, columns);
+    fprintf(out, "ply\nformat %s 1.0\ncomment Synthetic mesh written by loaderbench\n", binary ? "binary_little_endian" : "ascii");
+    fprintf(out, "element vertex %zu\n", vertexCount);
+    fprintf(out, "property float x\nproperty float y\nproperty float z\nproperty float nx\nproperty float ny\nproperty float nz\n");
+    fprintf(out, "property float u\nproperty float v\nelement face %zu\nproperty list uchar uint vertex_indices\nend_header\n", triangles);
+
+    for (size_t n = 0; n < vertexCount; n++) {
+        size_t column = n % columns, row = n / columns;
+        float x = column * 0.01f - 1.0f, z = row * 0.01f - 1.0f;
+        float slope = 0.3f * cosf(x * 3.0f);
+        float y = 0.1f * sinf(x * 3.0f);
+        float length = sqrtf(1.0f + slope * slope);
+        float values[8] = {x, y, z, -slope / length, 1.0f / length, 0.0f,
+                           (float)column / (columns - 1), rows > 1 ? (float)row / (rows - 1) : 0.0f};
+        if (binary) {
+            fwrite(values, sizeof(values), 1, out);
+        } else {
+            fprintf(out, "%f %f %f %f %f %f %f %f\n", values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7]);
+        }
+    }
+    for (size_t n = 0; n + columns + 1 < vertexCount; n++) {
+        if (n % columns == columns - 1) {
+            continue; // Last column
+        }
+        size_t below = n + columns;
+        uint32_t corners[2][3] = {{(uint32_t)n, (uint32_t)below, (uint32_t)(below + 1)}, {(uint32_t)n, (uint32_t)(below + 1), (uint32_t)(n + 1)}};
+        for (const uint32_t* tri : corners) {
+            if (binary) {
+                unsigned char count = 3;
+                fwrite(&count, 1, 1, out);
+                fwrite(tri, sizeof(uint32_t), 3, out);
+            } else {
+                fprintf(out, "3 %u %u %u\n", tri[0], tri[1], tri[2]);
+            }
+        }
+    }
+    bool ok = !ferror(out);
+    ok = fclose(out) == 0 && ok;
+    if (!ok) {
+        printf("ERROR: Can't write %s\n", path.c_str());
+        remove(path.c_str());
+    }
+    return ok;
+}
+
+// Stores 'value' little-endian at 'p'.
+static void put32(unsigned char* p, uint32_t value) {
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = value >> 24;
+}
+static void put16(unsigned char* p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+// Writes a 'size' x 'size' BMP file of a colorful pattern. 24-bit files are plain (BITMAPINFOHEADER); 32-bit files
+// have bit field masks with alpha, in a 56-byte info header, as the house textures are stored.
+static bool writeBMP(const std::string& path, uint32_t size, uint32_t bitsPerPixel) {
+    FILE* out = fopen(path.c_str(), "wb");
+    if (out == NULL) {
+        printf("ERROR: Can't create %s\n", path.c_str());
+        return false;
+    }
+    uint32_t bytes = bitsPerPixel / 8;
+    uint32_t infoSize = bytes == 4 ? 56 : 40;
+    uint32_t stride = (size * bytes + 3) & ~3u;
+    uint32_t pixelOffset = 14 + infoSize;
+    unsigned char header[14 + 56] = {};
+    header[0] = 'B';
+    header[1] = 'M';
+    put32(header + 2, (uint32_t)std::min<uint64_t>(0xFFFFFFFFu, pixelOffset + (uint64_t)stride * size));
+    put32(header + 10, pixelOffset);
+    put32(header + 14, infoSize);
+    put32(header + 18, size);
+    put32(header + 22, size);
+    put16(header + 26, 1);
+    put16(header + 28, (uint16_t)bitsPerPixel);
+    put32(header + 30, bytes == 4 ? 3 : 0);
+    put32(header + 34, stride * size);
+    put32(header + 38, 3779); // 96 DPI
+    put32(header + 42, 3779);
+    if (bytes == 4) {
+        put32(header + 54, 0x00FF0000);
+        put32(header + 58, 0x0000FF00);
+        put32(header + 62, 0x000000FF);
+        put32(header + 66, 0xFF000000);
+    }
+    fwrite(header, 1, pixelOffset, out);
+
+    std::vector<unsigned char> row(stride, 0);
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            unsigned char* pixel = row.data() + (size_t)x * bytes;
+            pixel[0] = (unsigned char)(x ^ y); // Blue, green, red, alpha
+            pixel[1] = (unsigned char)(y * 3);
+            pixel[2] = (unsigned char)(x + y);
+            if (bytes == 4) {
+                pixel[3] = (unsigned char)(255 - (x & 63));
+            }
+        }
+        fwrite(row.data(), 1, stride, out);
+    }
+    bool ok = !ferror(out);
+    ok = fclose(out) == 0 && ok;
+    if (!ok) {
+        printf("ERROR: Can't write %s\n", path.c_str());
+        remove(path.c_str());
+    }
+    return ok;
+}
+
+static size_t fileSize(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? (size_t)info.st_size : 0;
+}
+
+// ---- Measurement ----
+
+// Result of one loader on one file.
+struct Measurement {
+    bool ok = false; // The load succeeded and returned the expected number of items
+    double seconds = 0.0; // Fastest run
+    size_t items = 0; // Vertices or texels loaded
+    double peakMB = 0.0; // Peak resident memory of the process that ran the load
+};
+
+// Runs 'load' (which returns the number of vertices or texels it loaded, 0 on failure) in a child process,
+// repeated as described at the top, and measures it.
+static Measurement measure(const std::function<size_t()>& load) {
+    Measurement result;
+    fflush(stdout);
+    int channel[2];
+    if (pipe(channel) != 0) {
+        printf("ERROR: Can't create a pipe\n");
+        return result;
+    }
+    pid_t child = fork();
+    if (child < 0) {
+        printf("ERROR: Can't start a process\n");
+        close(channel[0]);
+        close(channel[1]);
+        return result;
+    }
+    if (child == 0) {
+        close(channel[0]);
+        double best = 0.0, total = 0.0;
+        size_t items = 0;
+        for (int run = 0; run < BENCH_MAX_RUNS && total < BENCH_MIN_SECONDS; run++) {
+            auto start = std::chrono::steady_clock::now();
+            items = load();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            best = run == 0 ? seconds : std::min(best, seconds);
+            total += seconds;
+            if (items == 0) {
+                break;
+            }
+        }
+        double message[2] = {best, (double)items};
+        ssize_t written = write(channel[1], message, sizeof(message));
+        _exit(written == (ssize_t)sizeof(message) ? 0 : 1);
+    }
+
+    close(channel[1]);
+    double message[2] = {0.0, 0.0};
+    bool received = read(channel[0], message, sizeof(message)) == (ssize_t)sizeof(message);
+    close(channel[0]);
+    int status = 0;
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+    wait4(child, &status, 0, &usage);
+    result.ok = received && WIFEXITED(status) && WEXITSTATUS(status) == 0 && message[1] > 0.0;
+    result.seconds = message[0];
+    result.items = (size_t)message[1];
+    result.peakMB = usage.ru_maxrss / 1024.0; // Kilobytes on Linux
+    return result;
+}
+
+// One loader to measure, and the files it can read.
+struct Loader {
+    const char* name;
+    std::function<bool(const std::string& kind)> reads; // Whether it reads files of this kind ("ascii", "32-bit", ...)
+    std::function<size_t(const std::string& path)> load;
+};
+
+// Measures every loader in 'loaders' that reads 'path' and prints a line for each. 'expected' is the number of
+// vertices or texels in the file, counted in units of 'unit'.
+static int report(const std::vector<Loader>& loaders, const std::string& path, const std::string& kind, size_t expected, const char* unit) {
+    double megabytes = fileSize(path) / (1024.0 * 1024.0);
+    int failed = 0;
+    for (const Loader& loader : loaders) {
+        if (!loader.reads(kind)) {
+            printf("  %-24s   (can't read %s files)\n", loader.name, kind.c_str());
+            continue;
+        }
+        Measurement m = measure([&]() { return loader.load(path); });
+        if (!m.ok || m.items != expected) {
+            printf("  %-24s   ERROR: loaded %zu of %zu %s\n", loader.name, m.items, expected, unit);
+            failed++;
+            continue;
+        }
+        printf("  %-24s %10.1f ms %9.1f MB/s %9.2f M%s/s   peak RSS %8.1f MB\n", loader.name, m.seconds * 1000.0,
+               megabytes / m.seconds, expected / m.seconds / 1e6, unit, m.peakMB);
+    }
+    return failed;
+}
+
+int main(int argc, char* argv[]) {
+    bool full = false, keep = false;
+    std::string folder = "bench-data";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--full") == 0) {
+            full = true;
+        } else if (strcmp(argv[i], "--keep") == 0) {
+            keep = true;
+        } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            folder = argv[++i];
+        } else {
+            printf("Usage: %s [--full] [--keep] [--dir folder]\n", argv[0]);
+            return 1;
+        }
+    }
+    mkdir(folder.c_str(), 0755);
+
+    std::vector<size_t> vertexCounts = {1000, 10000, 100000, 1000000};
+    std::vector<uint32_t> imageSizes = {256, 1024, 4096};
+    if (full) {
+        vertexCounts.insert(vertexCounts.end(), {10000000, 50000000});
+        imageSizes.insert(imageSizes.end(), {8192, 16384});
+    }
+    printf("%u hardware threads\n", std::max(1u, std::thread::hardware_concurrency()));
+
+    std::vector<Loader> plyLoaders = {
+        {"readPLYfile (original)", [](const std::string& kind) { return kind == "ascii"; }, [](const std::string& path) {
+            std::vector<HouseVertex> vertices;
+            std::vector<HouseTri> faces;
+            legacy::readPLYfile(path, vertices, faces);
+            return vertices.size();
+        }},
+        {"readPLYFile (original)", [](const std::string& kind) { return kind == "ascii"; }, [](const std::string& path) {
+            std::vector<WaterVertex> vertices;
+            std::vector<WaterTri> faces;
+            legacy::readPLYFile(path, vertices, faces);
+            return vertices.size();
+        }},
+        {"readPLYfile", [](const std::string&) { return true; }, [](const std::string& path) {
+            std::vector<HouseVertex> vertices;
+            std::vector<HouseTri> faces;
+            return loadPLY(path, houseAttributes, vertices, faces) ? vertices.size() : 0;
+        }},
+        {"readPLYFile", [](const std::string&) { return true; }, [](const std::string& path) {
+            std::vector<WaterVertex> vertices;
+            std::vector<WaterTri> faces;
+            return loadPLY(path, waterAttributes, vertices, faces) ? vertices.size() : 0;
+        }},
+    };
+    std::vector<Loader> bmpLoaders = {
+        {"loadARGB_BMP (original)", [](const std::string& kind) { return kind == "32-bit"; }, [](const std::string& path) {
+            unsigned char* data = NULL;
+            unsigned int width = 0, height = 0;
+            legacy::loadARGB_BMP(path.c_str(), &data, &width, &height);
+            size_t texels = data != NULL ? (size_t)width * height : 0;
+            delete[] data;
+            return texels;
+        }},
+        {"loadBMP (original)", [](const std::string& kind) { return kind == "24-bit"; }, [](const std::string& path) {
+            unsigned char* data = NULL;
+            unsigned int width = 0, height = 0;
+            legacy::loadBMP(path.c_str(), &data, &width, &height);
+            size_t texels = data != NULL ? (size_t)width * height : 0;
+            delete[] data;
+            return texels;
+        }},
+        {"loadBMP", [](const std::string&) { return true; }, [](const std::string& path) {
+            std::vector<unsigned char> rgba;
+            unsigned int width = 0, height = 0;
+            return loadBMP(path, rgba, width, height) ? (size_t)width * height : 0;
+        }},
+    };
+
+    int failed = 0;
+    for (size_t vertexCount : vertexCounts) {
+        for (bool binary : {false, true}) {
+            std::string kind = binary ? "binary" : "ascii";
+            std::string path = folder + "/mesh-" + kind + "-" + std::to_string(vertexCount) + ".ply";
+            if (fileSize(path) == 0 && !writePLY(path, vertexCount, binary)) {
+                return 1;
+            }
+            size_t columns = std::max<size_t>(2, (size_t)ceil(sqrt((double)vertexCount)));
+            printf("PLY %s, %zu vertices, %zu triangles, %.1f MB\n", kind.c_str(), vertexCount,
+                   gridTriangles(vertexCount, columns), fileSize(path) / (1024.0 * 1024.0));
+            failed += report(plyLoaders, path, kind, vertexCount, "vertices");
+            if (!keep) {
+                remove(path.c_str());
+            }
+        }
+    }
+    for (uint32_t size : imageSizes) {
+        for (uint32_t bits : {24u, 32u}) {
+            std::string kind = std::to_string(bits) + "-bit";
+            std::string path = folder + "/image-" + kind + "-" + std::to_string(size) + ".bmp";
+            if (fileSize(path) == 0 && !writeBMP(path, size, bits)) {
+                return 1;
+            }
+            printf("BMP %s, %u x %u, %.1f MB\n", kind.c_str(), size, size, fileSize(path) / (1024.0 * 1024.0));
+            failed += report(bmpLoaders, path, kind, (size_t)size * size, "texels");
+            if (!keep) {
+                remove(path.c_str());
+            }
+        }
+    }
+    if (!keep) {
+        rmdir(folder.c_str());
+    }
+    return failed == 0 ? 0 : 1;
+}
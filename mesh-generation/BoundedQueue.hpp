@@ -0,0 +1,54 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// A blocking first-in first-out queue with a fixed capacity, used to connect the stages of a pipeline.
+// push() waits while the queue is full, so a fast producer can never run further ahead of a slow
+// consumer than 'capacity' items, which keeps the memory held by the pipeline bounded.
+template <typename T>
+class BoundedQueue {
+    private:
+        std::deque<T> items; // Items waiting to be consumed
+        size_t capacity; // Maximum number of waiting items
+        bool closed = false; // Set once the producer has pushed its last item
+        std::mutex mutex;
+        std::condition_variable notFull;
+        std::condition_variable notEmpty;
+
+    public:
+        BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+        // Adds an item, waiting for room if the queue is full.
+        void push(T item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [this] { return items.size() < capacity; });
+            items.push_back(std::move(item));
+            notEmpty.notify_one();
+        }
+
+        // Removes the oldest item into 'item', waiting for one if the queue is empty.
+        // Returns false once the queue has been closed and every item has been consumed.
+        bool pop(T& item) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+            if (items.empty()) {
+                return false;
+            }
+            item = std::move(items.front());
+            items.pop_front();
+            notFull.notify_one();
+            return true;
+        }
+
+        // Signals that no more items will be pushed.
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            notEmpty.notify_all();
+        }
+};
+
+#endif
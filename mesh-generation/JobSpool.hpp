@@ -0,0 +1,298 @@
+#ifndef JOB_SPOOL_HPP
+#define JOB_SPOOL_HPP
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "MCStats.hpp"
+
+// One meshing job: a block of cells of the domain, identified by its global cell range.
+struct MeshJob {
+    std::string name; // File name of the job in the spool
+    std::string field; // Name of the scalar field to sample (e.g. "f3")
+    float isovalue; // Isovalue of the surface
+    float min; // Minimum coordinate of the domain on every axis
+    float stepsize; // Distance between two neighbouring samples
+    int i0, i1, j0, j1, k0, k1; // Cell range [i0, i1) x [j0, j1) x [k0, k1) to mesh
+    int stats; // 1 if the worker should send marching cubes statistics (see MCStats) with the result
+    std::string claim; // File name of the job in 'claimed/', set by JobSpool::claim()
+};
+
+// A job taken by a worker: the job's name, and the host and process id of that worker.
+struct JobClaim {
+    std::string file; // File name in 'claimed/': "<job>@<host>@<pid>"
+    std::string name; // Name of the job
+    std::string host; // Host name of the worker
+    int pid; // Process id of the worker on its host
+};
+
+// A directory-based job queue shared by a coordinator and any number of worker processes, which may run
+// on other machines as long as they see the same directory (e.g. over NFS).
+//
+// Jobs are files in 'pending/'. A worker claims one by renaming it into 'claimed/' under a name that adds
+// its host and process id; rename() is atomic, so exactly one worker wins each job and its owner is known
+// from the start. Results are written to 'done/' under a temporary name and renamed into place once
+// complete, so the coordinator never reads a partial result; the claim is then removed. A job a worker can't
+// mesh at all (e.g. one built without the job's field) is reported in 'failed/' the same way.
+//
+// Several coordinators can share a spool: each one names its jobs with a prefix of its own (see
+// runPrefix()) and only touches the jobs with that prefix.
+class JobSpool {
+    public:
+        std::string dir; // Root directory of the spool
+
+        JobSpool(const std::string& dir) : dir(dir) {}
+
+        // Creates the spool directories if they don't exist yet. Returns false on failure.
+        bool create() const {
+            const char* subdirs[] = {"", "/pending", "/claimed", "/done", "/failed"};
+            for (const char* sub : subdirs) {
+                std::string path = dir + sub;
+                if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+                    printf("ERROR: Can't create spool directory %s\n", path.c_str());
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Adds a job to the queue.
+        bool submit(const MeshJob& job) const {
+            // Floats are written in hexadecimal so that workers read back exactly the same values.
+            std::string tmp = dir + "/pending/." + job.name;
+            FILE* file = fopen(tmp.c_str(), "w");
+            if (file == NULL) {
+                return false;
+            }
+            fprintf(file, "%s %a %a %a %d %d %d %d %d %d %d\n", job.field.c_str(), job.isovalue, job.min, job.stepsize,
+                    job.i0, job.i1, job.j0, job.j1, job.k0, job.k1, job.stats);
+            fclose(file);
+            return rename(tmp.c_str(), (dir + "/pending/" + job.name).c_str()) == 0;
+        }
+
+        // Claims the next pending job whose name starts with 'prefix'. Returns false when no such job is left.
+        bool claim(MeshJob& job, const std::string& prefix = "") const {
+            for (const std::string& name : list("/pending")) {
+                if (name.compare(0, prefix.size(), prefix) != 0) {
+                    continue;
+                }
+                job.claim = name + "@" + hostName() + "@" + std::to_string((int)getpid());
+                std::string claimed = dir + "/claimed/" + job.claim;
+                if (rename((dir + "/pending/" + name).c_str(), claimed.c_str()) != 0) {
+                    continue; // Another worker was faster.
+                }
+
+                FILE* file = fopen(claimed.c_str(), "r");
+                if (file == NULL) {
+                    continue;
+                }
+                char field[64];
+                int read = fscanf(file, "%63s %a %a %a %d %d %d %d %d %d %d", field, &job.isovalue, &job.min, &job.stepsize,
+                                  &job.i0, &job.i1, &job.j0, &job.j1, &job.k0, &job.k1, &job.stats);
+                fclose(file);
+                if (read != 11) {
+                    printf("ERROR: Malformed job %s\n", name.c_str());
+                    continue;
+                }
+                job.name = name;
+                job.field = field;
+                return true;
+            }
+            return false;
+        }
+
+        // Publishes the triangles (9 floats each) produced for a claimed job, and the statistics of meshing it
+        // if 'stats' is not NULL, and gives up the claim.
+        bool complete(const MeshJob& job, const std::vector<float>& vertices, const MCStats* stats = NULL) const {
+            std::string tmp = dir + "/done/." + job.name;
+            FILE* file = fopen(tmp.c_str(), "wb");
+            if (file == NULL) {
+                return false;
+            }
+            uint64_t count = vertices.size();
+            uint8_t hasStats = stats != NULL;
+            bool ok = fwrite(&count, sizeof(count), 1, file) == 1
+                && fwrite(vertices.data(), sizeof(float), vertices.size(), file) == vertices.size()
+                && fwrite(&hasStats, sizeof(hasStats), 1, file) == 1
+                && (stats == NULL || stats->write(file));
+            ok = (fclose(file) == 0) && ok;
+            if (!ok || rename(tmp.c_str(), (dir + "/done/" + job.name).c_str()) != 0) {
+                return false;
+            }
+            // The claim may have been requeued meanwhile; the job is then simply done twice.
+            unlink((dir + "/claimed/" + job.claim).c_str());
+            return true;
+        }
+
+        // Publishes that a claimed job can't be meshed here, with the reason, and gives up the claim. The job
+        // is not put back in the queue, so the coordinator gives up on the run instead of waiting for it.
+        bool fail(const MeshJob& job, const std::string& error) const {
+            std::string tmp = dir + "/failed/." + job.name;
+            FILE* file = fopen(tmp.c_str(), "w");
+            if (file == NULL) {
+                return false;
+            }
+            bool ok = fprintf(file, "%s@%d: %s\n", hostName().c_str(), (int)getpid(), error.c_str()) > 0;
+            ok = (fclose(file) == 0) && ok;
+            if (!ok || rename(tmp.c_str(), (dir + "/failed/" + job.name).c_str()) != 0) {
+                return false;
+            }
+            unlink((dir + "/claimed/" + job.claim).c_str());
+            return true;
+        }
+
+        // Whether a job failed, and if so the reason given by its worker in 'error'.
+        bool failure(const std::string& name, std::string& error) const {
+            FILE* file = fopen((dir + "/failed/" + name).c_str(), "r");
+            if (file == NULL) {
+                return false;
+            }
+            char line[512] = "";
+            if (fgets(line, sizeof(line), file) != NULL) {
+                line[strcspn(line, "\n")] = 0;
+            }
+            fclose(file);
+            error = line;
+            return true;
+        }
+
+        // Whether the result of a job is available.
+        bool hasResult(const std::string& name) const {
+            return access((dir + "/done/" + name).c_str(), F_OK) == 0;
+        }
+
+        // Reads the result of a job, and adds the statistics sent with it to 'stats' if it is not NULL. Returns
+        // false if it is not (yet) available.
+        bool result(const std::string& name, std::vector<float>& vertices, MCStats* stats = NULL) const {
+            FILE* file = fopen((dir + "/done/" + name).c_str(), "rb");
+            if (file == NULL) {
+                return false;
+            }
+            uint64_t count = 0;
+            bool ok = fread(&count, sizeof(count), 1, file) == 1;
+            if (ok) {
+                vertices.resize(count);
+                ok = fread(vertices.data(), sizeof(float), count, file) == count;
+            }
+            uint8_t hasStats = 0;
+            ok = ok && fread(&hasStats, sizeof(hasStats), 1, file) == 1;
+            if (ok && hasStats && stats != NULL) {
+                MCStats jobStats;
+                ok = jobStats.read(file);
+                stats->merge(jobStats);
+            }
+            fclose(file);
+            return ok;
+        }
+
+        // The current claims on jobs whose name starts with 'prefix'.
+        std::vector<JobClaim> claims(const std::string& prefix = "") const {
+            std::vector<JobClaim> result;
+            for (const std::string& file : list("/claimed")) {
+                size_t first = file.find('@'), last = file.rfind('@');
+                if (first == std::string::npos || first == last || file.compare(0, prefix.size(), prefix) != 0) {
+                    continue;
+                }
+                JobClaim claim;
+                claim.file = file;
+                claim.name = file.substr(0, first);
+                claim.host = file.substr(first + 1, last - first - 1);
+                claim.pid = atoi(file.c_str() + last + 1);
+                result.push_back(claim);
+            }
+            return result;
+        }
+
+        // Whether the worker holding a claim is known to have died. Only processes on this host can be
+        // checked; for the others, the caller has to decide from how long the claim has been held.
+        static bool ownerDead(const JobClaim& claim) {
+            return claim.host == hostName() && kill(claim.pid, 0) != 0 && errno == ESRCH;
+        }
+
+        // Puts a claimed job back into the queue, e.g. because its worker died.
+        bool requeue(const JobClaim& claim) const {
+            return rename((dir + "/claimed/" + claim.file).c_str(), (dir + "/pending/" + claim.name).c_str()) == 0;
+        }
+
+        // Removes every file of a job: its queue entry, its claims and its result or failure.
+        void remove(const std::string& name) const {
+            unlink((dir + "/pending/" + name).c_str());
+            for (const JobClaim& claim : claims(name + "@")) {
+                unlink((dir + "/claimed/" + claim.file).c_str());
+            }
+            unlink((dir + "/done/" + name).c_str());
+            unlink((dir + "/failed/" + name).c_str());
+        }
+
+        // Name of this host, as recorded in the claims of its workers.
+        static std::string hostName() {
+            char name[256] = "";
+            gethostname(name, sizeof(name) - 1);
+            return name;
+        }
+
+        // A job name prefix unique to one run of a coordinator on this host.
+        static std::string runPrefix() {
+            return "run_" + hostName() + "_" + std::to_string((int)getpid()) + "_" + std::to_string((long long)time(NULL)) + "_";
+        }
+
+    private:
+        // Sorted names of the files in a spool subdirectory, skipping temporary (dot) files.
+        std::vector<std::string> list(const char* sub) const {
+            std::vector<std::string> names;
+            DIR* d = opendir((dir + sub).c_str());
+            if (d == NULL) {
+                return names;
+            }
+            while (struct dirent* entry = readdir(d)) {
+                if (entry->d_name[0] == '.') {
+                    continue;
+                }
+                names.push_back(entry->d_name);
+            }
+            closedir(d);
+            std::sort(names.begin(), names.end());
+            return names;
+        }
+};
+
+// Starts 'count' copies of the running executable with the given arguments and returns their process ids.
+// Workers on other machines are started by hand with the same arguments on a shared spool directory.
+inline std::vector<pid_t> launchWorkers(int count, const std::vector<std::string>& args) {
+    std::vector<pid_t> pids;
+    fflush(stdout); // Otherwise buffered output would be printed again by every child.
+    for (int w = 0; w < count; w++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            std::vector<char*> argv;
+            argv.push_back(const_cast<char*>("meshgen"));
+            for (const std::string& arg : args) {
+                argv.push_back(const_cast<char*>(arg.c_str()));
+            }
+            argv.push_back(NULL);
+            execv("/proc/self/exe", argv.data());
+            _exit(127); // Only reached if exec failed.
+        }
+        if (pid > 0) {
+            pids.push_back(pid);
+        } else {
+            printf("ERROR: Can't start worker process\n");
+        }
+    }
+    return pids;
+}
+
+#endif
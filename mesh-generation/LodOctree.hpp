@@ -0,0 +1,174 @@
+#ifndef LOD_OCTREE_HPP
+#define LOD_OCTREE_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+// Number of cells along one edge of an octree leaf, whatever its level.
+#define LOD_LEAF_CELLS 8
+
+// One leaf of the octree: a block of LOD_LEAF_CELLS^3 cells, each (1 << level) finest cells wide.
+struct LodLeaf {
+    int level; // 0 is the finest resolution, every level above doubles the cell size
+    int x, y, z; // Lowest corner of the leaf, in finest cells
+};
+
+// An octree that decides at which resolution each part of the [0, num)^3 cell domain is meshed.
+//
+// Leaves near a focus point (the camera or a region of interest) are split down to the finest
+// level, and leaves further away stay coarse. The tree is kept 2:1 balanced: two leaves that
+// touch, even only at a corner, are never more than one level apart, which is what allows the
+// mesher to stitch neighbouring levels without cracks.
+class LodOctree {
+    public:
+        int num; // Number of finest cells along one axis of the domain
+        int maxLevel; // Level of the root leaf
+        int rootCells; // Number of finest cells along one edge of the root
+
+        // Builds the tree for a domain of 'num' finest cells per axis. A leaf is split while the
+        // distance from 'focus' (in finest cells) to the leaf is below 'detail' times its size.
+        LodOctree(int num, const glm::vec3& focus, float detail) {
+            this->num = num;
+            this->maxLevel = 0;
+            while ((LOD_LEAF_CELLS << maxLevel) < num) {
+                maxLevel++;
+            }
+            this->rootCells = LOD_LEAF_CELLS << maxLevel;
+
+            refine(maxLevel, 0, 0, 0, focus, detail);
+            balance();
+        }
+
+        // Size in finest cells of a leaf at 'level'.
+        static int leafCells(int level) {
+            return LOD_LEAF_CELLS << level;
+        }
+
+        // Returns the level of the leaf containing the finest cell (cx, cy, cz), or -1 outside the root.
+        int leafLevelAt(int cx, int cy, int cz) const {
+            if (cx < 0 || cy < 0 || cz < 0 || cx >= rootCells || cy >= rootCells || cz >= rootCells) {
+                return -1;
+            }
+            for (int level = 0; level <= maxLevel; level++) {
+                int shift = level + 3;
+                if (leafKeys.count(key(level, cx >> shift, cy >> shift, cz >> shift))) {
+                    return level;
+                }
+            }
+            return -1;
+        }
+
+        // All leaves that overlap the domain, sorted by position so that neighbouring leaves are close together.
+        std::vector<LodLeaf> leaves() const {
+            std::vector<LodLeaf> result;
+            for (uint64_t k : leafKeys) {
+                LodLeaf leaf;
+                leaf.level = static_cast<int>(k >> 57);
+                leaf.x = static_cast<int>((k >> 38) & 0x7FFFF) * leafCells(leaf.level);
+                leaf.y = static_cast<int>((k >> 19) & 0x7FFFF) * leafCells(leaf.level);
+                leaf.z = static_cast<int>(k & 0x7FFFF) * leafCells(leaf.level);
+                if (leaf.x < num && leaf.y < num && leaf.z < num) {
+                    result.push_back(leaf);
+                }
+            }
+            std::sort(result.begin(), result.end(), [](const LodLeaf& a, const LodLeaf& b) {
+                if (a.x != b.x) return a.x < b.x;
+                if (a.y != b.y) return a.y < b.y;
+                if (a.z != b.z) return a.z < b.z;
+                return a.level < b.level;
+            });
+            return result;
+        }
+
+    private:
+        // Keys of the current leaves; see key().
+        std::unordered_set<uint64_t> leafKeys;
+
+        // Packs a level and a leaf position (in leaves of that level) into one integer.
+        static uint64_t key(int level, int ix, int iy, int iz) {
+            return ((uint64_t)level << 57) | ((uint64_t)ix << 38) | ((uint64_t)iy << 19) | (uint64_t)iz;
+        }
+
+        // Whether the cells of a leaf at 'level' starting at finest cell 'start' on some axis include one that
+        // crosses the end of the domain, which happens when 'num' isn't a multiple of the cell size.
+        bool crossesEdge(int level, int start) const {
+            return num % (1 << level) != 0 && start < num && num < start + leafCells(level);
+        }
+
+        // Splits leaves around the focus point, starting from the leaf (level, ix, iy, iz). Leaves whose cells
+        // would cross the end of the domain are split too, until their cells end on it, so that no cell is
+        // meshed from samples outside the domain.
+        void refine(int level, int ix, int iy, int iz, const glm::vec3& focus, float detail) {
+            float size = static_cast<float>(leafCells(level));
+            glm::vec3 boxMin(ix * size, iy * size, iz * size);
+            glm::vec3 boxMax = boxMin + glm::vec3(size);
+
+            // Distance from the focus point to the closest point of the leaf.
+            glm::vec3 closest = glm::clamp(focus, boxMin, boxMax);
+            bool outside = ix * leafCells(level) >= num || iy * leafCells(level) >= num || iz * leafCells(level) >= num;
+            bool edge = crossesEdge(level, ix * leafCells(level)) || crossesEdge(level, iy * leafCells(level))
+                || crossesEdge(level, iz * leafCells(level));
+
+            if (level > 0 && !outside && (edge || glm::length(focus - closest) < detail * size)) {
+                for (int c = 0; c < 8; c++) {
+                    refine(level - 1, 2 * ix + (c & 1), 2 * iy + ((c >> 1) & 1), 2 * iz + ((c >> 2) & 1), focus, detail);
+                }
+            } else {
+                leafKeys.insert(key(level, ix, iy, iz));
+            }
+        }
+
+        // Replaces a leaf by its eight children and queues them for balancing.
+        void split(int level, int ix, int iy, int iz, std::vector<LodLeaf>& pending) {
+            leafKeys.erase(key(level, ix, iy, iz));
+            for (int c = 0; c < 8; c++) {
+                LodLeaf child = {level - 1, 2 * ix + (c & 1), 2 * iy + ((c >> 1) & 1), 2 * iz + ((c >> 2) & 1)};
+                leafKeys.insert(key(child.level, child.x, child.y, child.z));
+                pending.push_back(child);
+            }
+        }
+
+        // Splits coarse leaves until every leaf's 26 neighbours are at most one level coarser.
+        // Leaves in 'pending' store their position in leaves of their level, not in cells.
+        void balance() {
+            std::vector<LodLeaf> pending;
+            for (uint64_t k : leafKeys) {
+                pending.push_back({static_cast<int>(k >> 57), static_cast<int>((k >> 38) & 0x7FFFF),
+                                   static_cast<int>((k >> 19) & 0x7FFFF), static_cast<int>(k & 0x7FFFF)});
+            }
+
+            while (!pending.empty()) {
+                LodLeaf leaf = pending.back();
+                pending.pop_back();
+
+                // The leaf may have been split since it was queued; its children are queued already.
+                if (!leafKeys.count(key(leaf.level, leaf.x, leaf.y, leaf.z))) {
+                    continue;
+                }
+
+                int size = leafCells(leaf.level);
+                for (int d = 0; d < 27; d++) {
+                    int dx = d % 3 - 1, dy = (d / 3) % 3 - 1, dz = d / 9 - 1;
+                    if (dx == 0 && dy == 0 && dz == 0) {
+                        continue;
+                    }
+
+                    // Any cell of the neighbouring region of the same size tells which leaf covers it.
+                    int cx = (leaf.x + dx) * size, cy = (leaf.y + dy) * size, cz = (leaf.z + dz) * size;
+                    int neighbourLevel = leafLevelAt(cx, cy, cz);
+                    while (neighbourLevel > leaf.level + 1) {
+                        int shift = neighbourLevel + 3;
+                        split(neighbourLevel, cx >> shift, cy >> shift, cz >> shift, pending);
+                        neighbourLevel = leafLevelAt(cx, cy, cz);
+                    }
+                }
+            }
+        }
+};
+
+#endif
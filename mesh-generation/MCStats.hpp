@@ -0,0 +1,122 @@
+#ifndef MC_STATS_HPP
+#define MC_STATS_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Counters collected while extracting an isosurface, used to choose the step size and the empty-space
+// skipping strategy for a field. Each thread fills its own instance through a plain pointer (NULL when
+// telemetry is off, which costs one branch per cell), and the instances are merged once the threads are done.
+struct MCStats {
+    uint64_t cellsVisited = 0; // Cells whose case was computed
+    uint64_t emptyCells = 0; // Visited cells that produced no triangle
+    uint64_t activeCells = 0; // Visited cells that produced at least one triangle
+    uint64_t fieldEvaluations = 0; // Calls to the scalar field
+    uint64_t triangles = 0; // Triangles produced
+    uint64_t caseCells[256] = {}; // Number of cells for each 'marching_cubes_lut' case
+    uint64_t caseTriangles[256] = {}; // Number of triangles produced by each case
+    std::vector<double> slabSeconds; // Time spent on each slab, indexed by slab
+
+    // Records one polygonised cell.
+    void recordCell(int cubeCase, int cellTriangles) {
+        cellsVisited++;
+        caseCells[cubeCase]++;
+        caseTriangles[cubeCase] += cellTriangles;
+        triangles += cellTriangles;
+        if (cellTriangles == 0) emptyCells++; else activeCells++;
+    }
+
+    // Adds time spent on slab 'slab'.
+    void recordSlab(int slab, double seconds) {
+        if ((int)slabSeconds.size() <= slab) {
+            slabSeconds.resize(slab + 1, 0.0);
+        }
+        slabSeconds[slab] += seconds;
+    }
+
+    // Adds the counters of another instance (typically another thread's) to these.
+    void merge(const MCStats& other) {
+        cellsVisited += other.cellsVisited;
+        emptyCells += other.emptyCells;
+        activeCells += other.activeCells;
+        fieldEvaluations += other.fieldEvaluations;
+        triangles += other.triangles;
+        for (int c = 0; c < 256; c++) {
+            caseCells[c] += other.caseCells[c];
+            caseTriangles[c] += other.caseTriangles[c];
+        }
+        for (size_t s = 0; s < other.slabSeconds.size(); s++) {
+            recordSlab((int)s, other.slabSeconds[s]);
+        }
+    }
+
+    // Writes the counters to a binary file, e.g. to send them to another process. Returns false on failure.
+    bool write(FILE* file) const {
+        uint64_t slabs = slabSeconds.size();
+        uint64_t counters[5] = {cellsVisited, emptyCells, activeCells, fieldEvaluations, triangles};
+        return fwrite(counters, sizeof(counters), 1, file) == 1
+            && fwrite(caseCells, sizeof(caseCells), 1, file) == 1
+            && fwrite(caseTriangles, sizeof(caseTriangles), 1, file) == 1
+            && fwrite(&slabs, sizeof(slabs), 1, file) == 1
+            && fwrite(slabSeconds.data(), sizeof(double), slabs, file) == slabs;
+    }
+
+    // Reads counters written by write(). Returns false on failure.
+    bool read(FILE* file) {
+        uint64_t slabs = 0;
+        uint64_t counters[5];
+        if (fread(counters, sizeof(counters), 1, file) != 1 || fread(caseCells, sizeof(caseCells), 1, file) != 1
+            || fread(caseTriangles, sizeof(caseTriangles), 1, file) != 1 || fread(&slabs, sizeof(slabs), 1, file) != 1
+            || slabs > (1u << 24)) {
+            return false;
+        }
+        cellsVisited = counters[0]; emptyCells = counters[1]; activeCells = counters[2];
+        fieldEvaluations = counters[3]; triangles = counters[4];
+        slabSeconds.resize(slabs);
+        return fread(slabSeconds.data(), sizeof(double), slabs, file) == slabs;
+    }
+
+    // Prints a short summary.
+    void print() const {
+        double total = 0.0;
+        for (double seconds : slabSeconds) total += seconds;
+        printf("Marching cubes: %llu cells (%llu empty, %llu active), %llu field evaluations, %llu triangles, %.3f s over %zu slabs\n",
+               (unsigned long long)cellsVisited, (unsigned long long)emptyCells, (unsigned long long)activeCells,
+               (unsigned long long)fieldEvaluations, (unsigned long long)triangles, total, slabSeconds.size());
+    }
+
+    // Writes all counters to a JSON file. Only the cases that occurred are listed. Returns false on failure.
+    bool writeJSON(const std::string& fileName) const {
+        FILE* file = fopen(fileName.c_str(), "w");
+        if (file == NULL) {
+            printf("ERROR: Can't create file %s\n", fileName.c_str());
+            return false;
+        }
+        fprintf(file, "{\n");
+        fprintf(file, "  \"cellsVisited\": %llu,\n", (unsigned long long)cellsVisited);
+        fprintf(file, "  \"emptyCells\": %llu,\n", (unsigned long long)emptyCells);
+        fprintf(file, "  \"activeCells\": %llu,\n", (unsigned long long)activeCells);
+        fprintf(file, "  \"fieldEvaluations\": %llu,\n", (unsigned long long)fieldEvaluations);
+        fprintf(file, "  \"triangles\": %llu,\n", (unsigned long long)triangles);
+        fprintf(file, "  \"cases\": [");
+        bool first = true;
+        for (int c = 0; c < 256; c++) {
+            if (caseCells[c] == 0) continue;
+            fprintf(file, "%s\n    {\"case\": %d, \"cells\": %llu, \"triangles\": %llu}", first ? "" : ",", c,
+                    (unsigned long long)caseCells[c], (unsigned long long)caseTriangles[c]);
+            first = false;
+        }
+        fprintf(file, "\n  ],\n");
+        fprintf(file, "  \"slabSeconds\": [");
+        for (size_t s = 0; s < slabSeconds.size(); s++) {
+            fprintf(file, "%s%.6f", s == 0 ? "" : ", ", slabSeconds[s]);
+        }
+        fprintf(file, "]\n}\n");
+        return fclose(file) == 0;
+    }
+};
+
+#endif
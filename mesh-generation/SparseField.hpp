@@ -0,0 +1,254 @@
+#ifndef SPARSE_FIELD_HPP
+#define SPARSE_FIELD_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+// Number of cells along one edge of a brick.
+#define BRICK_SIZE 8
+// Number of samples along one edge of a brick. One extra layer is kept so that every
+// cell of a brick can be marched using only the brick's own samples.
+#define BRICK_SAMPLES (BRICK_SIZE + 1)
+// Number of floats stored for one allocated brick.
+#define BRICK_VOLUME (BRICK_SAMPLES * BRICK_SAMPLES * BRICK_SAMPLES)
+
+// A sparse, VDB-like cache of a sampled scalar field.
+//
+// The [min, max]^3 domain is split into bricks of BRICK_SIZE^3 cells. A brick is only
+// allocated when the isosurface passes through it, i.e. when its samples lie on both sides
+// of the isovalue. Every other brick is a constant tile and stores a single value (the
+// mean of its samples), which is enough to classify it as inside or outside.
+class SparseBrickGrid {
+    public:
+        float isovalue; // Isovalue the active bricks were selected for
+        float min; // Minimum coordinate of the sampled domain on every axis
+        float stepsize; // Distance between two neighbouring samples
+        int num; // Number of cells along one axis (same meaning as in marching_cubes)
+        int bricksPerAxis; // Number of bricks along one axis
+
+        // For every brick, the index of its samples in 'brickData' or -1 for a constant tile.
+        std::vector<int32_t> brickIndex;
+        // For every brick, the single value that represents it when it is a constant tile.
+        std::vector<float> tileValue;
+        // Samples of all allocated bricks, BRICK_VOLUME floats each.
+        std::vector<float> brickData;
+        // Linear ids of the allocated bricks, in increasing order, for marching only those.
+        std::vector<int> activeBricks;
+        // Number of calls made to the field so far, by the constructor and resample().
+        uint64_t fieldEvaluations = 0;
+
+        // Samples 'f' over [min, max]^3 with the given step size and keeps only the bricks
+        // the isosurface at 'isovalue' passes through.
+        SparseBrickGrid(std::function<float(float, float, float)> f, float isovalue, float min, float max, float stepsize) {
+            this->isovalue = isovalue;
+            this->min = min;
+            this->stepsize = stepsize;
+            this->num = static_cast<int>((max - min) / stepsize);
+            this->bricksPerAxis = (num + BRICK_SIZE - 1) / BRICK_SIZE;
+
+            size_t brickCount = (size_t)bricksPerAxis * bricksPerAxis * bricksPerAxis;
+            brickIndex.assign(brickCount, -1);
+            tileValue.assign(brickCount, 0.0f);
+
+            build(f);
+        }
+
+        // Returns the linear id of the brick at brick coordinates (bx, by, bz).
+        int brickId(int bx, int by, int bz) const {
+            return (bx * bricksPerAxis + by) * bricksPerAxis + bz;
+        }
+
+        // Converts a linear brick id back to brick coordinates.
+        void brickCoords(int id, int& bx, int& by, int& bz) const {
+            bz = id % bricksPerAxis;
+            by = (id / bricksPerAxis) % bricksPerAxis;
+            bx = id / (bricksPerAxis * bricksPerAxis);
+        }
+
+        // Number of cells of brick coordinate 'b' along one axis; bricks on the far side of
+        // the domain are cut short when 'num' is not a multiple of BRICK_SIZE.
+        int cellsInBrick(int b) const {
+            return std::min(BRICK_SIZE, num - b * BRICK_SIZE);
+        }
+
+        // Whether the brick with linear id 'id' holds real samples.
+        bool isActive(int id) const {
+            return brickIndex[id] >= 0;
+        }
+
+        // Samples of an allocated brick, indexed with brickSample().
+        const float* brickSamples(int id) const {
+            return &brickData[(size_t)brickIndex[id] * BRICK_VOLUME];
+        }
+
+        // Offset of the local sample (li, lj, lk) inside a brick's samples.
+        static int brickSample(int li, int lj, int lk) {
+            return (li * BRICK_SAMPLES + lj) * BRICK_SAMPLES + lk;
+        }
+
+        // Returns the sampled value at global sample index (i, j, k), each in [0, num].
+        // Samples inside constant tiles return the tile value.
+        float sample(int i, int j, int k) const {
+            // Samples on the far boundary belong to the last brick's extra layer.
+            int bx = std::min(i / BRICK_SIZE, bricksPerAxis - 1);
+            int by = std::min(j / BRICK_SIZE, bricksPerAxis - 1);
+            int bz = std::min(k / BRICK_SIZE, bricksPerAxis - 1);
+            int id = brickId(bx, by, bz);
+            if (!isActive(id)) {
+                return tileValue[id];
+            }
+            return brickSamples(id)[brickSample(i - bx * BRICK_SIZE, j - by * BRICK_SIZE, k - bz * BRICK_SIZE)];
+        }
+
+        // Re-samples every brick overlapping the cell range [i0, i1) x [j0, j1) x [k0, k1) from 'f', after
+        // the field has been edited there. Bricks may become active or turn back into constant tiles;
+        // slots of released bricks are reused by later allocations.
+        void resample(const std::function<float(float, float, float)>& f, int i0, int i1, int j0, int j1, int k0, int k1) {
+            // The cells touch samples [i0, i1]; a sample on a brick's lower face is also stored in the
+            // apron of the brick below it.
+            int bx0 = std::max(0, (i0 - 1) / BRICK_SIZE), bx1 = std::min(bricksPerAxis - 1, i1 / BRICK_SIZE);
+            int by0 = std::max(0, (j0 - 1) / BRICK_SIZE), by1 = std::min(bricksPerAxis - 1, j1 / BRICK_SIZE);
+            int bz0 = std::max(0, (k0 - 1) / BRICK_SIZE), bz1 = std::min(bricksPerAxis - 1, k1 / BRICK_SIZE);
+            std::vector<float> scratch(BRICK_VOLUME, 0.0f);
+
+            for (int bx = bx0; bx <= bx1; bx++) {
+                for (int by = by0; by <= by1; by++) {
+                    for (int bz = bz0; bz <= bz1; bz++) {
+                        int id = brickId(bx, by, bz);
+                        bool active = sampleBrick(f, bx, by, bz, scratch.data(), tileValue[id]);
+                        fieldEvaluations += (uint64_t)(cellsInBrick(bx) + 1) * (cellsInBrick(by) + 1) * (cellsInBrick(bz) + 1);
+                        auto pos = std::lower_bound(activeBricks.begin(), activeBricks.end(), id);
+
+                        if (active) {
+                            // Allocates a slot for a brick that has just become active.
+                            if (!isActive(id)) {
+                                if (!freeSlots.empty()) {
+                                    brickIndex[id] = freeSlots.back();
+                                    freeSlots.pop_back();
+                                } else {
+                                    brickIndex[id] = static_cast<int32_t>(brickData.size() / BRICK_VOLUME);
+                                    brickData.resize(brickData.size() + BRICK_VOLUME);
+                                }
+                                activeBricks.insert(pos, id);
+                            }
+                            std::copy(scratch.begin(), scratch.end(), brickData.begin() + (size_t)brickIndex[id] * BRICK_VOLUME);
+                        } else if (isActive(id)) {
+                            // The surface left this brick, so it goes back to being a constant tile.
+                            freeSlots.push_back(brickIndex[id]);
+                            brickIndex[id] = -1;
+                            activeBricks.erase(pos);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Bytes used by the sparse representation.
+        size_t memoryBytes() const {
+            return brickIndex.size() * sizeof(int32_t) + tileValue.size() * sizeof(float)
+                + brickData.size() * sizeof(float) + activeBricks.size() * sizeof(int)
+                + freeSlots.size() * sizeof(int32_t);
+        }
+
+        // Bytes a dense array of all (num + 1)^3 samples would use.
+        size_t denseBytes() const {
+            size_t samples = (size_t)num + 1;
+            return samples * samples * samples * sizeof(float);
+        }
+
+    private:
+        // Slots in 'brickData' released by resample() and available for reuse.
+        std::vector<int32_t> freeSlots;
+
+        // Samples one brick into 'out' and returns whether the isosurface passes through it.
+        // The tile value (mean of the samples) is written to 'tile'.
+        bool sampleBrick(const std::function<float(float, float, float)>& f, int bx, int by, int bz, float* out, float& tile) const {
+            int ci = cellsInBrick(bx), cj = cellsInBrick(by), ck = cellsInBrick(bz);
+            bool below = false, above = false;
+            double sum = 0.0;
+            int count = 0;
+
+            for (int li = 0; li <= ci; li++) {
+                float x = min + (bx * BRICK_SIZE + li) * stepsize;
+                for (int lj = 0; lj <= cj; lj++) {
+                    float y = min + (by * BRICK_SIZE + lj) * stepsize;
+                    for (int lk = 0; lk <= ck; lk++) {
+                        float z = min + (bz * BRICK_SIZE + lk) * stepsize;
+                        float value = f(x, y, z);
+                        out[brickSample(li, lj, lk)] = value;
+
+                        // Track on which sides of the isovalue the samples lie.
+                        if (value < isovalue) below = true; else above = true;
+                        sum += value;
+                        count++;
+                    }
+                }
+            }
+            tile = static_cast<float>(sum / count);
+            return below && above;
+        }
+
+        // Samples every brick, splitting the work over slabs of bricks along x between threads.
+        void build(const std::function<float(float, float, float)>& f) {
+            unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+            std::atomic<int> nextSlab(0);
+
+            // Each thread keeps the bricks it allocated until all sampling is done.
+            std::vector<std::vector<int>> localIds(threadCount);
+            std::vector<std::vector<float>> localData(threadCount);
+            std::vector<uint64_t> localEvaluations(threadCount, 0);
+
+            auto worker = [&](unsigned int t) {
+                std::vector<float> scratch(BRICK_VOLUME, 0.0f);
+                for (int bx = nextSlab++; bx < bricksPerAxis; bx = nextSlab++) {
+                    for (int by = 0; by < bricksPerAxis; by++) {
+                        for (int bz = 0; bz < bricksPerAxis; bz++) {
+                            int id = brickId(bx, by, bz);
+                            localEvaluations[t] += (uint64_t)(cellsInBrick(bx) + 1) * (cellsInBrick(by) + 1) * (cellsInBrick(bz) + 1);
+                            // Every brick owns its own tile slot, so no locking is needed.
+                            if (sampleBrick(f, bx, by, bz, scratch.data(), tileValue[id])) {
+                                localIds[t].push_back(id);
+                                localData[t].insert(localData[t].end(), scratch.begin(), scratch.end());
+                            }
+                        }
+                    }
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for (unsigned int t = 0; t < threadCount; t++) {
+                threads.emplace_back(worker, t);
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            for (uint64_t evaluations : localEvaluations) {
+                fieldEvaluations += evaluations;
+            }
+
+            // Gather the allocated bricks in id order so extraction walks memory linearly.
+            std::vector<std::pair<int, std::pair<unsigned int, size_t>>> order;
+            for (unsigned int t = 0; t < threadCount; t++) {
+                for (size_t n = 0; n < localIds[t].size(); n++) {
+                    order.push_back({localIds[t][n], {t, n}});
+                }
+            }
+            std::sort(order.begin(), order.end());
+
+            brickData.resize(order.size() * BRICK_VOLUME);
+            activeBricks.reserve(order.size());
+            for (size_t n = 0; n < order.size(); n++) {
+                const float* src = &localData[order[n].second.first][order[n].second.second * BRICK_VOLUME];
+                std::copy(src, src + BRICK_VOLUME, &brickData[n * BRICK_VOLUME]);
+                brickIndex[order[n].first] = static_cast<int32_t>(n);
+                activeBricks.push_back(order[n].first);
+            }
+        }
+};
+
+#endif
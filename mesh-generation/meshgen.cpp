@@ -8,11 +8,35 @@
 #include <vector>
 #include <functional>
 #include <array>
+#include <limits>
 #include <string.h> // For legacy C string functions
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <chrono>
+#include <memory>
 
 // Including a custom header, presumably for lookup tables used in the Marching Cubes algorithm.
 #include "TriTable.hpp"
 
+// Including the sparse brick cache used to store sampled fields without a dense num^3 array.
+#include "SparseField.hpp"
+
+// Including the view frustum used to cull mesh chunks that are off screen.
+#include "../common/Frustum.hpp"
+
+// Including the bounded queue that connects the stages of the extraction pipeline.
+#include "BoundedQueue.hpp"
+
+// Including the octree that chooses the mesh resolution of each part of the domain.
+#include "LodOctree.hpp"
+
+// Including the counters collected while extracting the surface.
+#include "MCStats.hpp"
+
+// Including the job spool shared by the coordinator and worker processes of distributed meshing.
+#include "JobSpool.hpp"
+
 // Including GLEW to manage OpenGL extensions, and GLFW for window and input handling.
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -41,6 +65,9 @@ using namespace std;
 double dragging;
 double lastXPos, lastYPos;
 
+// Set by the keyboard callback when the E key asks for an edit of the field, which the render loop then applies.
+bool editRequested = false;
+
 // Functions to define scalar fields, used as input for the Marching Cubes algorithm.
 float f1(float x, float y, float z) {
     return pow(x,2) + pow(y,2) + pow(z,2);
@@ -120,6 +147,11 @@ class Camera {
             this->pos = lookAtVector + relativePos;
         }
 
+        // Returns the camera's current position in world space.
+        vec3 getPosition() {
+            return this->pos;
+        }
+
         // This function generates the view matrix for the camera.
         // The view matrix is used in rendering to transform world coordinates to the camera's view space.
         mat4 getViewMatrix() {
@@ -155,28 +187,71 @@ class Camera {
 // The camera is initialized to look at the origin (0, 0, 0) from the position (5, 5, 5).
 Camera camera(vec3(0, 0, 0), vec3(5, 5, 5));
 
-// Declaration of the 'marching_cubes' function, which applies the Marching Cubes algorithm to generate a mesh.
-vector<float> marching_cubes(
-function<float(float, float, float)> f,
-float isovalue,
-float min,
-float max,
-float stepsize);
+// Polygonises a single cube whose lowest corner is at grid index (i, j, k). 'vertArr' holds the scalar
+// values at the eight cube corners in the order used by 'marching_cubes_lut', and the resulting
+// triangles are appended to 'vertices'. If 'stats' is not NULL, the cell is counted in it.
+void march_cube(const array<float, 8>& vertArr, float isovalue, int i, int j, int k, float min, float stepsize, vector<float>& vertices,
+                MCStats* stats = NULL) {
+
+    // An integer used as a bitmask to represent the cube configuration based on the isovalue.
+    int vertIndices = 0;
+
+    // Determines the configuration of the cube by comparing each vertex value to the isovalue
+    // and setting the corresponding bit in 'cubeindex'.
+    if (vertArr[0] < isovalue) vertIndices |= BOTTOM_BACK_LEFT;
+    if (vertArr[1] < isovalue) vertIndices |= BOTTOM_BACK_RIGHT;
+    if (vertArr[2] < isovalue) vertIndices |= BOTTOM_FRONT_RIGHT;
+    if (vertArr[3] < isovalue) vertIndices |= BOTTOM_FRONT_LEFT;
+    if (vertArr[4] < isovalue) vertIndices |= TOP_BACK_LEFT;
+    if (vertArr[5] < isovalue) vertIndices |= TOP_BACK_RIGHT;
+    if (vertArr[6] < isovalue) vertIndices |= TOP_FRONT_RIGHT;
+    if (vertArr[7] < isovalue) vertIndices |= TOP_FRONT_LEFT;
+
+    // Iterates over the edges of the cube that intersect the isosurface, based on the lookup table.
+    // 'marching_cubes_lut' is a predefined table that maps cube configurations to intersecting edges.
+    for (int v = 0; marching_cubes_lut[vertIndices][v] != -1; v += 3) {
+        // Retrieves the indices of the vertices that form each intersecting edge.
+        int edge0 = marching_cubes_lut[vertIndices][v];
+        int edge1 = marching_cubes_lut[vertIndices][v + 1];
+        int edge2 = marching_cubes_lut[vertIndices][v + 2];
+
+        // Calculates the positions of the vertices on the intersecting edges and adds them to the 'vertices' vector.
+        // The positions are interpolated based on the scalar values at the ends of each edge.
+        vertices.push_back((min + i * stepsize) + vertTable[edge0][0] * stepsize);
+        vertices.push_back((min + j * stepsize) + vertTable[edge0][1] * stepsize);
+        vertices.push_back((min + k * stepsize) + vertTable[edge0][2] * stepsize);
+
+        vertices.push_back((min + i * stepsize) + vertTable[edge1][0] * stepsize);
+        vertices.push_back((min + j * stepsize) + vertTable[edge1][1] * stepsize);
+        vertices.push_back((min + k * stepsize) + vertTable[edge1][2] * stepsize);
+
+        vertices.push_back((min + i * stepsize) + vertTable[edge2][0] * stepsize);
+        vertices.push_back((min + j * stepsize) + vertTable[edge2][1] * stepsize);
+        vertices.push_back((min + k * stepsize) + vertTable[edge2][2] * stepsize);
+    }
 
-// Defines the marching_cubes function that takes a scalar field function 'f', an isovalue for the isosurface,
-// the minimum and maximum bounds of the volume to be sampled, and the step size for sampling.
-vector<float> marching_cubes(function<float(float, float, float)> f, float isovalue, float min, float max, float stepsize) {
+    // Records the case of the cell and the number of triangles it produced.
+    if (stats != NULL) {
+        int triangles = 0;
+        while (marching_cubes_lut[vertIndices][3 * triangles] != -1) triangles++;
+        stats->recordCell(vertIndices, triangles);
+    }
+}
+
+// Polygonises the cells [i0, i1) x [j0, j1) x [k0, k1) of the grid with the given origin 'min' and step size.
+// Vertex positions depend only on the global cell index, so separately meshed blocks share identical seam vertices.
+// If 'stats' is not NULL, the cells, field evaluations and the time spent on each slab (value of i) are counted in it.
+vector<float> marching_cubes_range(const function<float(float, float, float)>& f, float isovalue, float min, float stepsize,
+                                   int i0, int i1, int j0, int j1, int k0, int k1, MCStats* stats = NULL) {
 
     // Initializes a vector to store the vertices of the resulting mesh.
     vector<float> vertices;
 
-    // Calculates the number of samples along one axis based on the volume bounds and step size.
-    int num = static_cast<int>((max - min) / stepsize);
-
     // Iterates through each point in the 3D volume based on the calculated number of samples.
-    for (int i = 0; i < num; i++) {
-        for (int j = 0; j < num; j++) {
-            for (int k = 0; k < num; k++) {
+    for (int i = i0; i < i1; i++) {
+        chrono::steady_clock::time_point slabStart = chrono::steady_clock::now();
+        for (int j = j0; j < j1; j++) {
+            for (int k = k0; k < k1; k++) {
 
                 // An array to hold the scalar values at the vertices of the current cube being evaluated.
                 array<float, 8> vertArr;
@@ -192,50 +267,445 @@ vector<float> marching_cubes(function<float(float, float, float)> f, float isova
                 vertArr[6] = f((min + i * stepsize) + stepsize, (min + j * stepsize) + stepsize, (min + k * stepsize) + stepsize);
                 vertArr[7] = f((min + i * stepsize), (min + j * stepsize) + stepsize, (min + k * stepsize) + stepsize);
 
-                // An integer used as a bitmask to represent the cube configuration based on the isovalue.
+                // Polygonises the cube and appends its triangles to 'vertices'.
+                march_cube(vertArr, isovalue, i, j, k, min, stepsize, vertices, stats);
+            }
+        }
+        if (stats != NULL) {
+            stats->fieldEvaluations += 8 * (uint64_t)(j1 - j0) * (k1 - k0);
+            stats->recordSlab(i, chrono::duration<double>(chrono::steady_clock::now() - slabStart).count());
+        }
+    }
+    // Returns the vector containing all the vertices that form the mesh of the isosurface.
+    return vertices;
+}
+
+// Polygonises every cell of one allocated brick of the sparse field cache and appends the triangles to 'vertices'.
+// If 'stats' is not NULL, the cells are counted in it.
+void march_brick(const SparseBrickGrid& grid, int id, vector<float>& vertices, MCStats* stats = NULL) {
+    int bx, by, bz;
+    grid.brickCoords(id, bx, by, bz);
+    const float* samples = grid.brickSamples(id);
+
+    // Number of cells of this brick along each axis (bricks on the far boundary may be cut short).
+    int ci = grid.cellsInBrick(bx), cj = grid.cellsInBrick(by), ck = grid.cellsInBrick(bz);
+
+    for (int li = 0; li < ci; li++) {
+        for (int lj = 0; lj < cj; lj++) {
+            for (int lk = 0; lk < ck; lk++) {
+
+                // Reads the corner values from the brick in the same corner order as marching_cubes_range().
+                array<float, 8> vertArr;
+                vertArr[0] = samples[SparseBrickGrid::brickSample(li, lj, lk)];
+                vertArr[1] = samples[SparseBrickGrid::brickSample(li + 1, lj, lk)];
+                vertArr[2] = samples[SparseBrickGrid::brickSample(li + 1, lj, lk + 1)];
+                vertArr[3] = samples[SparseBrickGrid::brickSample(li, lj, lk + 1)];
+                vertArr[4] = samples[SparseBrickGrid::brickSample(li, lj + 1, lk)];
+                vertArr[5] = samples[SparseBrickGrid::brickSample(li + 1, lj + 1, lk)];
+                vertArr[6] = samples[SparseBrickGrid::brickSample(li + 1, lj + 1, lk + 1)];
+                vertArr[7] = samples[SparseBrickGrid::brickSample(li, lj + 1, lk + 1)];
+
+                // Polygonises the cube at its global grid index.
+                march_cube(vertArr, grid.isovalue,
+                           bx * BRICK_SIZE + li, by * BRICK_SIZE + lj, bz * BRICK_SIZE + lk,
+                           grid.min, grid.stepsize, vertices, stats);
+            }
+        }
+    }
+}
+
+// Offsets of the eight cube corners in the order used by 'marching_cubes_lut'.
+const int cornerOffset[8][3] = {
+    {0, 0, 0}, {1, 0, 0}, {1, 0, 1}, {0, 0, 1},
+    {0, 1, 0}, {1, 1, 0}, {1, 1, 1}, {0, 1, 1}
+};
+
+// The two corners joined by each of the twelve cube edges used in 'marching_cubes_lut' (see 'vertTable').
+const int edgeCorners[12][2] = {
+    {0, 1}, {1, 2}, {2, 3}, {3, 0},
+    {4, 5}, {5, 6}, {6, 7}, {7, 4},
+    {0, 4}, {1, 5}, {2, 6}, {3, 7}
+};
+
+// Default ratio between the distance of an octree leaf to the focus point and its size below which it is split.
+#define LOD_DETAIL 1.5f
+
+// Everything needed to mesh one leaf of the LOD octree. Points are given as global indices on the finest grid.
+struct LodLeafContext {
+    function<float(float, float, float)> f; // Scalar field
+    float isovalue; // Isovalue of the surface
+    float min; // Minimum coordinate of the domain on every axis
+    float stepsize; // Size of a finest cell
+    int num; // Number of finest cells along one axis
+    LodLeaf leaf; // The leaf being meshed
+    int size; // Size of the leaf in finest cells
+    // Levels of the 26 neighbouring regions of the leaf's size (and the leaf itself at [1][1][1]).
+    // Regions covered by finer leaves are stored as -1 since only coarser neighbours change the leaf.
+    int neighbourLevel[3][3][3];
+    MCStats* stats; // Counters of the thread meshing the leaf, or NULL
+    const LodOctree* tree; // The octree the leaf belongs to
+
+    LodLeafContext(const LodOctree& tree, const function<float(float, float, float)>& f, float isovalue, float min, float stepsize, const LodLeaf& leaf,
+                   MCStats* stats = NULL)
+        : f(f), isovalue(isovalue), min(min), stepsize(stepsize), num(tree.num), leaf(leaf), stats(stats), tree(&tree) {
+        size = LodOctree::leafCells(leaf.level);
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dz = -1; dz <= 1; dz++) {
+                    int level = tree.leafLevelAt(leaf.x + dx * size, leaf.y + dy * size, leaf.z + dz * size);
+                    neighbourLevel[dx + 1][dy + 1][dz + 1] = level >= leaf.level ? level : -1;
+                }
+            }
+        }
+    }
+
+    // World-space position of the finest grid point p.
+    vec3 position(const int p[3]) const {
+        return vec3(min + p[0] * stepsize, min + p[1] * stepsize, min + p[2] * stepsize);
+    }
+
+    // Field value at the finest grid point p.
+    float field(const int p[3]) const {
+        if (stats != NULL) stats->fieldEvaluations++;
+        vec3 pos = position(p);
+        return f(pos.x, pos.y, pos.z);
+    }
+
+    // Level of the coarsest leaf touching the point whose coordinates, doubled, are d. Doubling lets the
+    // same function answer for grid points and for edge midpoints. The point must be on the leaf.
+    int coarsestLevelAround(const int d[3]) const {
+        // For each axis, the neighbouring regions the point touches: below, the leaf itself, or above.
+        int lo[3], hi[3];
+        for (int a = 0; a < 3; a++) {
+            int local = d[a] - 2 * (a == 0 ? leaf.x : a == 1 ? leaf.y : leaf.z);
+            lo[a] = local == 0 ? 0 : 1;
+            hi[a] = local == 2 * size ? 2 : 1;
+        }
+        int level = leaf.level;
+        for (int x = lo[0]; x <= hi[0]; x++) {
+            for (int y = lo[1]; y <= hi[1]; y++) {
+                for (int z = lo[2]; z <= hi[2]; z++) {
+                    level = std::max(level, neighbourLevel[x][y][z]);
+                }
+            }
+        }
+        return level;
+    }
+
+    // Value used for the grid point p. Points shared with a coarser leaf that are not samples of
+    // that leaf take values derived from the coarse samples instead of the field, so that both
+    // leaves see the same surface on their common boundary.
+    float sample(const int p[3]) const {
+        int d[3] = {2 * p[0], 2 * p[1], 2 * p[2]};
+        int coarse = coarsestLevelAround(d);
+        int s = 1 << coarse, h = s / 2;
+
+        // Axes along which p lies halfway between two coarse samples.
+        int offsetAxes[2], offsetCount = 0;
+        for (int a = 0; a < 3; a++) {
+            if (p[a] % s != 0) {
+                offsetAxes[offsetCount++] = a;
+            }
+        }
+        if (offsetCount == 0) {
+            return field(p);
+        }
+
+        if (offsetCount == 1) {
+            // Midpoint of a coarse edge: the coarse cell interpolates linearly along it.
+            int q0[3] = {p[0], p[1], p[2]}, q1[3] = {p[0], p[1], p[2]};
+            q0[offsetAxes[0]] -= h;
+            q1[offsetAxes[0]] += h;
+            return 0.5f * (field(q0) + field(q1));
+        }
+
+        // Centre of a coarse face. Its value must give the fine cells on the face the same contour topology as
+        // the coarse face, which depends on how many of the four coarse corners are below the isovalue.
+        float corners[4];
+        int below = 0;
+        for (int c = 0; c < 4; c++) {
+            int q[3] = {p[0], p[1], p[2]};
+            q[offsetAxes[0]] += (c == 1 || c == 2) ? h : -h;
+            q[offsetAxes[1]] += (c >= 2) ? h : -h;
+            corners[c] = field(q);
+            if (corners[c] < isovalue) below++;
+        }
+        float centre = 0.25f * (corners[0] + corners[1] + corners[2] + corners[3]);
+        float lowest = *std::min_element(corners, corners + 4), highest = *std::max_element(corners, corners + 4);
+
+        // On an ambiguous face (diagonal corners on the same side) 'marching_cubes_lut' always separates
+        // the corners below the isovalue, so the centre must be above it. With one corner on its own, the
+        // centre must be on the side of the other three. Two adjacent corners below work either way.
+        bool diagonal = below == 2 && ((corners[0] < isovalue) == (corners[2] < isovalue));
+        if ((below <= 1 || diagonal) && centre < isovalue) {
+            centre = isovalue + 0.01f * (highest - isovalue);
+        } else if (below >= 3 && centre >= isovalue) {
+            centre = isovalue - 0.01f * (isovalue - lowest);
+            if (centre >= isovalue) centre = nextafterf(isovalue, -std::numeric_limits<float>::infinity());
+        }
+        return centre;
+    }
+
+    // Surface crossing on the segment between grid points pa and pb with values va and vb, interpolated
+    // linearly. The endpoints are put in a fixed order first so that every cell sharing the segment,
+    // at any level, computes exactly the same position.
+    vec3 crossing(const int pa[3], const int pb[3], float va, float vb) const {
+        bool swap = pa[0] != pb[0] ? pa[0] > pb[0] : pa[1] != pb[1] ? pa[1] > pb[1] : pa[2] > pb[2];
+        if (swap) {
+            return crossing(pb, pa, vb, va);
+        }
+        float t = (isovalue - va) / (vb - va);
+        vec3 a = position(pa), b = position(pb);
+        return a + (b - a) * t;
+    }
+
+    // Position of the surface vertex on the edge pa-pb of a cell of this leaf. Edges lying on the face of a
+    // coarser neighbour are moved onto the coarse surface so that the two leaves meet without gaps.
+    vec3 edgeVertex(const int pa[3], const int pb[3], float va, float vb) const {
+        vec3 vertex = crossing(pa, pb, va, vb);
+
+        int d[3] = {pa[0] + pb[0], pa[1] + pb[1], pa[2] + pb[2]};
+        int coarse = coarsestLevelAround(d);
+        if (coarse == leaf.level) {
+            return vertex;
+        }
+        int s = 1 << coarse;
+
+        // Direction of the edge and the two other axes.
+        int a = pa[0] != pb[0] ? 0 : pa[1] != pb[1] ? 1 : 2;
+        int u = (a + 1) % 3, w = (a + 2) % 3;
+
+        if (pa[u] % s == 0 && pa[w] % s == 0) {
+            // The edge is half of a coarse edge: use the coarse edge's own crossing.
+            int q0[3] = {pa[0], pa[1], pa[2]}, q1[3] = {pa[0], pa[1], pa[2]};
+            q0[a] = std::min(pa[a], pb[a]) / s * s;
+            q1[a] = q0[a] + s;
+            return crossing(q0, q1, field(q0), field(q1));
+        }
+
+        vec3 start, end;
+        if (!coarseSegment(pa, pb, s, start, end)) {
+            return vertex;
+        }
+
+        // Projects the vertex onto the coarse segment.
+        vec3 segment = end - start;
+        float lengthSquared = dot(segment, segment);
+        if (lengthSquared == 0.0f) {
+            return start;
+        }
+        float t = glm::clamp(dot(vertex - start, segment) / lengthSquared, 0.0f, 1.0f);
+        return start + segment * t;
+    }
+
+    // For an edge pa-pb joining the midpoint of a coarse edge to the centre of a coarse face, where the coarse
+    // cells are 's' finest cells wide: the coarse contour segment on that face, between the crossings of two
+    // coarse face edges. Returns false if the coarse face has no contour.
+    bool coarseSegment(const int pa[3], const int pb[3], int s, vec3& start, vec3& end) const {
+        // Direction of the edge, the axis 'n' normal to the face and the other axis 'o' along which the
+        // edge is offset from the coarse grid.
+        int a = pa[0] != pb[0] ? 0 : pa[1] != pb[1] ? 1 : 2;
+        int u = (a + 1) % 3, w = (a + 2) % 3;
+        int n = pa[u] % s == 0 ? u : w, o = n == u ? w : u;
+        int origin[3];
+        origin[n] = pa[n];
+        origin[a] = std::min(pa[a], pb[a]) / s * s;
+        origin[o] = pa[o] / s * s;
+
+        // Coarse face corners in cyclic order, and which of them are below the isovalue.
+        int corners[4][3];
+        float values[4];
+        bool below[4];
+        int belowCount = 0;
+        for (int c = 0; c < 4; c++) {
+            corners[c][0] = origin[0]; corners[c][1] = origin[1]; corners[c][2] = origin[2];
+            corners[c][a] += (c == 1 || c == 2) ? s : 0;
+            corners[c][o] += (c >= 2) ? s : 0;
+            values[c] = field(corners[c]);
+            below[c] = values[c] < isovalue;
+            if (below[c]) belowCount++;
+        }
+
+        // Coarse face edge e joins corners e and e + 1.
+        int e0 = -1, e1 = -1;
+        if (belowCount == 2 && below[0] == below[2]) {
+            // Ambiguous face: the coarse cell separates each corner below the isovalue. The fine edge
+            // belongs to the contour around the corner below the isovalue on the coarse edge it starts from.
+            const int* mid = (pa[a] % s == 0) ? pa : pb;
+            int edge = mid[a] % s != 0 ? (mid[o] == origin[o] ? 0 : 2) : (mid[a] == origin[a] ? 3 : 1);
+            int corner = below[edge] ? edge : (edge + 1) % 4;
+            e0 = (corner + 3) % 4;
+            e1 = corner;
+        } else {
+            for (int e = 0; e < 4; e++) {
+                if (below[e] != below[(e + 1) % 4]) {
+                    if (e0 < 0) e0 = e; else e1 = e;
+                }
+            }
+        }
+        if (e0 < 0 || e1 < 0) {
+            return false;
+        }
+        start = crossing(corners[e0], corners[(e0 + 1) % 4], values[e0], values[(e0 + 1) % 4]);
+        end = crossing(corners[e1], corners[(e1 + 1) % 4], values[e1], values[(e1 + 1) % 4]);
+        return true;
+    }
+
+    // Vertices that a finer neighbour places strictly inside the edge start-end of a triangle of this leaf,
+    // ordered from 'start' to 'end'. The edge must join the crossings of two edges of one cell face lying on
+    // the leaf's boundary, with lowest corner 'lo' and normal axis 'n'. The finer leaf meshes that face as four
+    // cells and moves its vertices onto the edge (see edgeVertex()); splitting the edge at the same points
+    // leaves no T-junctions between the two leaves.
+    void finerVertices(const int lo[3], int n, vec3 start, vec3 end, vector<vec3>& points) const {
+        points.clear();
+        int s = 1 << leaf.level, h = s / 2;
+        if (h == 0) {
+            return;
+        }
+
+        // The leaf across the face, if it is the finer one and is meshed.
+        int origin[3] = {leaf.x, leaf.y, leaf.z};
+        int q[3] = {lo[0] + h, lo[1] + h, lo[2] + h};
+        q[n] = lo[n] == origin[n] ? lo[n] - 1 : lo[n];
+        if (q[n] < 0 || q[n] >= num || tree->leafLevelAt(q[0], q[1], q[2]) != leaf.level - 1) {
+            return;
+        }
+        int cells = LodOctree::leafCells(leaf.level - 1);
+        LodLeaf finerLeaf = {leaf.level - 1, q[0] / cells * cells, q[1] / cells * cells, q[2] / cells * cells};
+        LodLeafContext finer(*tree, f, isovalue, min, stepsize, finerLeaf, stats);
+
+        // The finer leaf's edges from the midpoints of the face edges to the face centre.
+        int centre[3] = {lo[0] + h, lo[1] + h, lo[2] + h};
+        centre[n] = lo[n];
+        float centreValue = finer.sample(centre);
+        for (int m = 0; m < 4; m++) {
+            int along = (n + 1 + m / 2) % 3, across = (n + 2 - m / 2) % 3;
+            int mid[3] = {lo[0], lo[1], lo[2]};
+            mid[along] += h;
+            mid[across] += (m % 2) * s;
+            float midValue = finer.sample(mid);
+            vec3 segmentStart, segmentEnd;
+            if ((midValue < isovalue) == (centreValue < isovalue) || !finer.coarseSegment(mid, centre, s, segmentStart, segmentEnd)) {
+                continue;
+            }
+            // On an ambiguous face the finer leaf has two segments; only the points on this one are kept.
+            if (!((segmentStart == start && segmentEnd == end) || (segmentStart == end && segmentEnd == start))) {
+                continue;
+            }
+            vec3 point = finer.edgeVertex(mid, centre, midValue, centreValue);
+            if (point != start && point != end && std::find(points.begin(), points.end(), point) == points.end()) {
+                points.push_back(point);
+            }
+        }
+        std::sort(points.begin(), points.end(), [&](const vec3& x, const vec3& y) {
+            return dot(x - start, end - start) < dot(y - start, end - start);
+        });
+    }
+};
+
+// Polygonises one leaf of the LOD octree and appends the triangles to 'vertices'. Cells are (1 << level)
+// finest cells wide and vertices are placed by linear interpolation of the field along the cell edges.
+void march_lod_leaf(const LodLeafContext& ctx, vector<float>& vertices) {
+    int step = 1 << ctx.leaf.level;
+    int origin[3] = {ctx.leaf.x, ctx.leaf.y, ctx.leaf.z};
+
+    // Samples of the leaf. Only points on its boundary can be shared with a coarser leaf.
+    const int samplesPerAxis = LOD_LEAF_CELLS + 1;
+    vector<float> samples(samplesPerAxis * samplesPerAxis * samplesPerAxis);
+    for (int li = 0; li < samplesPerAxis; li++) {
+        for (int lj = 0; lj < samplesPerAxis; lj++) {
+            for (int lk = 0; lk < samplesPerAxis; lk++) {
+                int p[3] = {origin[0] + li * step, origin[1] + lj * step, origin[2] + lk * step};
+                bool boundary = li == 0 || lj == 0 || lk == 0 || li == LOD_LEAF_CELLS || lj == LOD_LEAF_CELLS || lk == LOD_LEAF_CELLS;
+                samples[(li * samplesPerAxis + lj) * samplesPerAxis + lk] = boundary ? ctx.sample(p) : ctx.field(p);
+            }
+        }
+    }
+
+    vector<vec3> polygon, points;
+    for (int li = 0; li < LOD_LEAF_CELLS; li++) {
+        for (int lj = 0; lj < LOD_LEAF_CELLS; lj++) {
+            for (int lk = 0; lk < LOD_LEAF_CELLS; lk++) {
+                // Cells starting outside the domain are not meshed. No cell crosses its edge (see LodOctree::refine()).
+                if (origin[0] + li * step >= ctx.num || origin[1] + lj * step >= ctx.num || origin[2] + lk * step >= ctx.num) {
+                    continue;
+                }
+
+                // Corner points and values in the corner order of 'marching_cubes_lut'.
+                int corner[8][3];
+                float value[8];
                 int vertIndices = 0;
+                for (int c = 0; c < 8; c++) {
+                    int l[3] = {li + cornerOffset[c][0], lj + cornerOffset[c][1], lk + cornerOffset[c][2]};
+                    for (int a = 0; a < 3; a++) {
+                        corner[c][a] = origin[a] + l[a] * step;
+                    }
+                    value[c] = samples[(l[0] * samplesPerAxis + l[1]) * samplesPerAxis + l[2]];
+                    if (value[c] < ctx.isovalue) vertIndices |= 1 << c;
+                }
 
-                // Determines the configuration of the cube by comparing each vertex value to the isovalue
-                // and setting the corresponding bit in 'cubeindex'.
-                if (vertArr[0] < isovalue) vertIndices |= BOTTOM_BACK_LEFT;
-                if (vertArr[1] < isovalue) vertIndices |= BOTTOM_BACK_RIGHT;
-                if (vertArr[2] < isovalue) vertIndices |= BOTTOM_FRONT_RIGHT;
-                if (vertArr[3] < isovalue) vertIndices |= BOTTOM_FRONT_LEFT;
-                if (vertArr[4] < isovalue) vertIndices |= TOP_BACK_LEFT;
-                if (vertArr[5] < isovalue) vertIndices |= TOP_BACK_RIGHT;
-                if (vertArr[6] < isovalue) vertIndices |= TOP_FRONT_RIGHT;
-                if (vertArr[7] < isovalue) vertIndices |= TOP_FRONT_LEFT;
-
-                // An array to temporarily hold the vertices generated from the current cube configuration.
-                array<array<float, 3>, 8> verts;
-
-                // Iterates over the edges of the cube that intersect the isosurface, based on the lookup table.
-                // 'marching_cubes_lut' is a predefined table that maps cube configurations to intersecting edges.
+                int triangles = 0;
                 for (int v = 0; marching_cubes_lut[vertIndices][v] != -1; v += 3) {
-                    // Retrieves the indices of the vertices that form each intersecting edge.
-                    int edge0 = marching_cubes_lut[vertIndices][v];
-                    int edge1 = marching_cubes_lut[vertIndices][v + 1];
-                    int edge2 = marching_cubes_lut[vertIndices][v + 2];
-
-                    // Calculates the positions of the vertices on the intersecting edges and adds them to the 'vertices' vector.
-                    // The positions are interpolated based on the scalar values at the ends of each edge.
-                    vertices.push_back((min + i * stepsize) + vertTable[edge0][0] * stepsize);
-                    vertices.push_back((min + j * stepsize) + vertTable[edge0][1] * stepsize);
-                    vertices.push_back((min + k * stepsize) + vertTable[edge0][2] * stepsize);
-
-                    vertices.push_back((min + i * stepsize) + vertTable[edge1][0] * stepsize);
-                    vertices.push_back((min + j * stepsize) + vertTable[edge1][1] * stepsize);
-                    vertices.push_back((min + k * stepsize) + vertTable[edge1][2] * stepsize);
-
-                    vertices.push_back((min + i * stepsize) + vertTable[edge2][0] * stepsize);
-                    vertices.push_back((min + j * stepsize) + vertTable[edge2][1] * stepsize);
-                    vertices.push_back((min + k * stepsize) + vertTable[edge2][2] * stepsize);
+                    vec3 triangle[3];
+                    for (int t = 0; t < 3; t++) {
+                        int edge = marching_cubes_lut[vertIndices][v + t];
+                        int c0 = edgeCorners[edge][0], c1 = edgeCorners[edge][1];
+                        triangle[t] = ctx.edgeVertex(corner[c0], corner[c1], value[c0], value[c1]);
+                    }
+
+                    // Stitching can collapse a triangle onto a line; such triangles cover nothing and have no normal.
+                    vec3 normal = cross(triangle[1] - triangle[0], triangle[2] - triangle[0]);
+                    if (dot(normal, normal) == 0.0f) {
+                        continue;
+                    }
+
+                    // The triangle as a polygon, with the vertices a finer neighbour adds to its edges on the
+                    // leaf's faces.
+                    polygon.clear();
+                    for (int t = 0; t < 3; t++) {
+                        polygon.push_back(triangle[t]);
+                        int edges[2] = {marching_cubes_lut[vertIndices][v + t], marching_cubes_lut[vertIndices][v + (t + 1) % 3]};
+                        for (int n = 0; n < 3; n++) {
+                            // Both cell edges must lie on the same face of the cell, on the leaf's boundary.
+                            int plane = corner[edgeCorners[edges[0]][0]][n];
+                            bool onFace = plane == origin[n] || plane == origin[n] + ctx.size;
+                            for (int e = 0; e < 2; e++) {
+                                for (int c = 0; c < 2; c++) {
+                                    onFace = onFace && corner[edgeCorners[edges[e]][c]][n] == plane;
+                                }
+                            }
+                            if (onFace) {
+                                int lo[3] = {corner[0][0], corner[0][1], corner[0][2]};
+                                lo[n] = plane;
+                                ctx.finerVertices(lo, n, triangle[t], triangle[(t + 1) % 3], points);
+                                polygon.insert(polygon.end(), points.begin(), points.end());
+                                break;
+                            }
+                        }
+                    }
+
+                    // A split triangle is drawn as a fan around its centroid, which keeps every piece in its plane.
+                    if (polygon.size() == 3) {
+                        for (int t = 0; t < 3; t++) {
+                            vertices.insert(vertices.end(), {triangle[t].x, triangle[t].y, triangle[t].z});
+                        }
+                        triangles++;
+                        continue;
+                    }
+                    vec3 centroid = (triangle[0] + triangle[1] + triangle[2]) / 3.0f;
+                    for (size_t p = 0; p < polygon.size(); p++) {
+                        const vec3& a = polygon[p];
+                        const vec3& b = polygon[(p + 1) % polygon.size()];
+                        vertices.insert(vertices.end(), {centroid.x, centroid.y, centroid.z, a.x, a.y, a.z, b.x, b.y, b.z});
+                        triangles++;
+                    }
+                }
+                if (ctx.stats != NULL) {
+                    ctx.stats->recordCell(vertIndices, triangles);
                 }
             }
         }
     }
-    // Returns the vector containing all the vertices that form the mesh of the isosurface.
-    return vertices;
 }
 
 // Function to compute normals for a set of vertices, where each group of 9 floats (3 vertices) represents a triangle.
@@ -276,54 +746,703 @@ vector<float> compute_normals(const vector<float>& vertices) {
     return normals;
 }
 
-// Function to write the vertices and normals of a 3D mesh into a PLY file.
-void writePLY(const vector<float>& vertices, const vector<float>& normals, const string& fileName) {
+// Number of cells along one edge of a mesh chunk. It is a multiple of BRICK_SIZE so that every chunk is made of whole bricks.
+#define CHUNK_SIZE 32
+
+// A piece of the extracted surface that covers one CHUNK_SIZE^3 block of cells.
+struct MeshChunk {
+    vector<float> vertices; // Triangle vertices of this chunk, 9 floats per triangle.
+    vector<float> normals; // Normals matching 'vertices'.
+    vec3 boundsMin, boundsMax; // Tight bounding box of the chunk's vertices, used for frustum culling.
+    int first = 0; // Index of the chunk's first vertex in the shared vertex buffer.
+    int count = 0; // Number of vertices the chunk contributes to the shared vertex buffer.
+
+    // Computes the tight bounding box of the chunk's vertices.
+    void computeBounds() {
+        boundsMin = vec3(std::numeric_limits<float>::max());
+        boundsMax = vec3(-std::numeric_limits<float>::max());
+        for (size_t v = 0; v < vertices.size(); v += 3) {
+            vec3 p(vertices[v], vertices[v + 1], vertices[v + 2]);
+            boundsMin = glm::min(boundsMin, p);
+            boundsMax = glm::max(boundsMax, p);
+        }
+    }
+};
+
+// The extracted isosurface split into spatial chunks. All chunks share one vertex buffer and one normal buffer;
+// each chunk owns a contiguous vertex range in them so it can be drawn (or skipped) on its own.
+class ChunkedMesh {
+    private:
+        GLuint VAO = 0; // Vertex Array Object describing the shared buffers.
+        GLuint VBO = 0; // Vertex Buffer Object holding the positions of all chunks.
+        GLuint NBO = 0; // Normal Buffer Object holding the normals of all chunks.
+        bool dirty = true; // Whether the chunks changed since the last upload.
+
+        // Re-extracts one chunk, triangles and normals, from the active bricks inside it.
+        void extractChunk(const SparseBrickGrid& grid, int cx, int cy, int cz) {
+            MeshChunk& chunk = chunks[chunkId(cx, cy, cz)];
+            extractTriangles(grid, cx, cy, cz, chunk);
+            chunk.normals = compute_normals(chunk.vertices);
+            dirty = true;
+        }
+
+    public:
+        int chunksPerAxis; // Number of chunks along one axis of the domain.
+        vector<MeshChunk> chunks; // All chunks, indexed by chunkId().
+
+        // Creates the (still empty) chunks covering a domain of 'num' cells per axis.
+        ChunkedMesh(int num) {
+            chunksPerAxis = (num + CHUNK_SIZE - 1) / CHUNK_SIZE;
+            chunks.resize((size_t)chunksPerAxis * chunksPerAxis * chunksPerAxis);
+        }
+
+        // Creates the (still empty) chunks covering the domain of 'grid'. They are filled by extract_pipelined().
+        ChunkedMesh(const SparseBrickGrid& grid) : ChunkedMesh(grid.num) {}
+
+        // Returns the index in 'chunks' of the chunk at chunk coordinates (cx, cy, cz).
+        int chunkId(int cx, int cy, int cz) const {
+            return (cx * chunksPerAxis + cy) * chunksPerAxis + cz;
+        }
+
+        // Extracts the triangles of one chunk from the active bricks inside it and computes its bounding box.
+        // Normals are left to the caller so that they can be computed in a separate pipeline stage.
+        // If 'stats' is not NULL, the cells are counted in it.
+        static void extractTriangles(const SparseBrickGrid& grid, int cx, int cy, int cz, MeshChunk& chunk, MCStats* stats = NULL) {
+            chunk.vertices.clear();
+
+            // A chunk covers (CHUNK_SIZE / BRICK_SIZE)^3 bricks; only the allocated ones can contain triangles.
+            int bricksPerChunk = CHUNK_SIZE / BRICK_SIZE;
+            for (int bx = cx * bricksPerChunk; bx < std::min((cx + 1) * bricksPerChunk, grid.bricksPerAxis); bx++) {
+                for (int by = cy * bricksPerChunk; by < std::min((cy + 1) * bricksPerChunk, grid.bricksPerAxis); by++) {
+                    for (int bz = cz * bricksPerChunk; bz < std::min((cz + 1) * bricksPerChunk, grid.bricksPerAxis); bz++) {
+                        int id = grid.brickId(bx, by, bz);
+                        if (grid.isActive(id)) {
+                            march_brick(grid, id, chunk.vertices, stats);
+                        }
+                    }
+                }
+            }
+
+            chunk.computeBounds();
+        }
+
+        // Replaces a chunk with one produced elsewhere (e.g. by the extraction pipeline).
+        void setChunk(int id, MeshChunk chunk) {
+            chunks[id] = std::move(chunk);
+            dirty = true;
+        }
+
+        // Applies an edit of the field inside the world-space box [editMin, editMax]: 'f' is the edited field.
+        // The bricks in the box are re-sampled and only the chunks whose cells touch them are re-meshed.
+        void applyEdit(SparseBrickGrid& grid, const function<float(float, float, float)>& f, vec3 editMin, vec3 editMax) {
+            // Converts the box to the range of cells it covers.
+            int lo[3], hi[3];
+            for (int a = 0; a < 3; a++) {
+                lo[a] = std::max(0, static_cast<int>(std::floor((editMin[a] - grid.min) / grid.stepsize)));
+                hi[a] = std::min(grid.num, static_cast<int>(std::ceil((editMax[a] - grid.min) / grid.stepsize)));
+            }
+            grid.resample(f, lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]);
+
+            // The edit changed samples [lo, hi]; every cell that uses one of them is in [lo - 1, hi].
+            int c0[3], c1[3];
+            for (int a = 0; a < 3; a++) {
+                c0[a] = std::max(0, lo[a] - 1) / CHUNK_SIZE;
+                c1[a] = std::min(chunksPerAxis - 1, hi[a] / CHUNK_SIZE);
+            }
+            for (int cx = c0[0]; cx <= c1[0]; cx++) {
+                for (int cy = c0[1]; cy <= c1[1]; cy++) {
+                    for (int cz = c0[2]; cz <= c1[2]; cz++) {
+                        extractChunk(grid, cx, cy, cz);
+                    }
+                }
+            }
+        }
+
+        // Uploads the chunks into the shared buffers if they changed since the last upload.
+        void upload() {
+            if (!dirty) {
+                return;
+            }
+            if (VAO == 0) {
+                glGenVertexArrays(1, &VAO);
+                glGenBuffers(1, &VBO);
+                glGenBuffers(1, &NBO);
+            }
+
+            // Assigns each chunk its vertex range in the shared buffers.
+            size_t total = 0;
+            for (MeshChunk& chunk : chunks) {
+                chunk.first = static_cast<int>(total);
+                chunk.count = static_cast<int>(chunk.vertices.size() / 3);
+                total += chunk.count;
+            }
+
+            glBindVertexArray(VAO);
+
+            // Allocates the vertex buffer and copies each chunk into its range.
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferData(GL_ARRAY_BUFFER, total * 3 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+            for (const MeshChunk& chunk : chunks) {
+                if (chunk.count > 0) {
+                    glBufferSubData(GL_ARRAY_BUFFER, chunk.first * 3 * sizeof(float), chunk.vertices.size() * sizeof(float), chunk.vertices.data());
+                }
+            }
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+
+            // Same for the normal buffer.
+            glBindBuffer(GL_ARRAY_BUFFER, NBO);
+            glBufferData(GL_ARRAY_BUFFER, total * 3 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+            for (const MeshChunk& chunk : chunks) {
+                if (chunk.count > 0) {
+                    glBufferSubData(GL_ARRAY_BUFFER, chunk.first * 3 * sizeof(float), chunk.normals.size() * sizeof(float), chunk.normals.data());
+                }
+            }
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(1);
+
+            glBindVertexArray(0);
+            dirty = false;
+        }
+
+        // Draws the chunks whose bounding box intersects the view frustum and returns how many were drawn.
+        int draw(const Frustum& frustum) {
+            upload();
+            glBindVertexArray(VAO);
+            int drawn = 0;
+            for (const MeshChunk& chunk : chunks) {
+                if (chunk.count > 0 && frustum.intersectsAABB(chunk.boundsMin, chunk.boundsMax)) {
+                    glDrawArrays(GL_TRIANGLES, chunk.first, chunk.count);
+                    drawn++;
+                }
+            }
+            glBindVertexArray(0);
+            return drawn;
+        }
+};
+
+// Radius of the ball cut out of the field by one edit.
+#define EDIT_RADIUS 0.5f
+
+// Returns the field 'f' with a ball cut out of its isosurface: inside the ball the field is raised above
+// 'isovalue', outside it the field is unchanged.
+function<float(float, float, float)> cut_ball(function<float(float, float, float)> f, float isovalue, vec3 centre, float radius) {
+    return [f, isovalue, centre, radius](float x, float y, float z) {
+        float inside = radius - length(vec3(x, y, z) - centre);
+        return inside > 0.0f ? std::max(f(x, y, z), isovalue + inside) : f(x, y, z);
+    };
+}
+
+// Finds the first point where the segment from 'from' to 'to' crosses the isosurface of 'f', sampling it every
+// 'stepsize'. Returns false if it doesn't cross it.
+bool first_crossing(const function<float(float, float, float)>& f, float isovalue, vec3 from, vec3 to, float stepsize, vec3& hit) {
+    int steps = std::max(1, static_cast<int>(length(to - from) / stepsize));
+    bool below = f(from.x, from.y, from.z) < isovalue;
+    for (int s = 1; s <= steps; s++) {
+        vec3 p = from + (to - from) * (static_cast<float>(s) / steps);
+        if ((f(p.x, p.y, p.z) < isovalue) != below) {
+            hit = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Number of digits reserved in the PLY header for the element counts, which are only known once streaming ends.
+#define PLY_COUNT_DIGITS 10
+
+// Writes a triangle soup into an ASCII PLY file incrementally. Vertices are appended batch by batch as they
+// become available, and the element counts in the header are filled in by finish() once the total is known.
+class PLYWriter {
+    private:
+        ofstream file; // The output file.
+        streampos vertexCountPos; // Position of the vertex count placeholder in the header.
+        streampos faceCountPos; // Position of the face count placeholder in the header.
+        size_t verticesNum = 0; // Number of vertices written so far.
+
+        // Formats a count with leading zeros so that it always fills the space reserved for it in the header.
+        static string paddedCount(size_t count) {
+            string digits = to_string(count);
+            return string(PLY_COUNT_DIGITS - digits.size(), '0') + digits;
+        }
+
+    public:
+        // Open or create a file with the provided file name and write the PLY file header with
+        // placeholders for the element counts.
+        PLYWriter(const string& fileName) : file(fileName) {
+            // Check if the file was successfully opened/created.
+            if (file.fail()) {
+                printf("ERROR: Can't create file :(");
+                return;
+            }
+
+            // Write the PLY file header with format specifications and element properties.
+            file << "ply" << "\n";
+            file << "format ascii 1.0" << "\n";
+            file << "element vertex ";
+            vertexCountPos = file.tellp();
+            file << paddedCount(0) << "\n";
+            file << "property float x" << "\n";
+            file << "property float y" << "\n";
+            file << "property float z" << "\n";
+            file << "property float nx" << "\n"; // x-component of the normal
+            file << "property float ny" << "\n"; // y-component of the normal
+            file << "property float nz" << "\n"; // z-component of the normal
+            file << "element face ";
+            faceCountPos = file.tellp();
+            file << paddedCount(0) << "\n";
+            file << "property list uchar uint vertex_indices" << "\n"; // Face property indicating the indices of the vertices that form the face
+            file << "end_header" << "\n";
+        }
+
+        // Whether the file could be created.
+        bool isOpen() const {
+            return file.is_open();
+        }
+
+        // Write vertex positions and normals to the file. Every 9 floats (3 vertices) form one triangle.
+        void appendVertices(const vector<float>& vertices, const vector<float>& normals) {
+            for (size_t i = 0; i < vertices.size(); i += 3) {
+                // For each vertex, write its position (x, y, z) followed by its normal (nx, ny, nz).
+                file << vertices[i] << " " << vertices[i + 1] << " " << vertices[i + 2] << " ";
+                file << normals[i] << " " << normals[i + 1] << " " << normals[i + 2] << "\n";
+            }
+            verticesNum += vertices.size() / 3;
+        }
+
+        // Write the faces, fill in the element counts and close the file.
+        void finish() {
+            if (!isOpen()) {
+                return;
+            }
+
+            // Write face data to the file. Each face is defined by 3 consecutive vertices.
+            for (size_t i = 0; i < verticesNum; i += 3) {
+                // The '3' indicates that each face is a triangle composed of 3 vertices.
+                file << "3 " << i << " " << i + 1 << " " << i + 2 << "\n";
+            }
+
+            // Go back to the header and replace the placeholders with the real counts.
+            file.seekp(vertexCountPos);
+            file << paddedCount(verticesNum);
+            file.seekp(faceCountPos);
+            file << paddedCount(verticesNum / 3);
+
+            // Close the file.
+            file.close();
+        }
+};
+
+// A slab of chunks (all chunks with the same x chunk coordinate) travelling through the extraction pipeline.
+struct SlabBatch {
+    vector<int> ids; // Chunk ids of the chunks in the slab.
+    vector<MeshChunk> chunks; // The chunks themselves.
+};
+
+// Number of slabs each pipeline queue may hold; bounds the memory used by slabs in flight.
+#define PIPELINE_QUEUE_SLABS 4
+
+// Extracts the isosurface stored in 'grid' into 'mesh' and, if 'fileName' is not empty, exports it as a PLY file.
+// Extraction, normal computation and file writing run as three concurrent stages connected by bounded queues of
+// slab-sized batches, so normals and export of earlier slabs overlap with the extraction of later ones.
+// If 'stats' is not NULL, the extraction stage (the only thread marching cells) counts into it.
+void extract_pipelined(const SparseBrickGrid& grid, ChunkedMesh& mesh, const string& fileName, MCStats* stats = NULL) {
+    BoundedQueue<SlabBatch> extracted(PIPELINE_QUEUE_SLABS); // Slabs waiting for normals.
+    BoundedQueue<SlabBatch> shaded(PIPELINE_QUEUE_SLABS); // Slabs waiting to be written.
+
+    // Stage 1: marching cubes, one slab of chunks at a time.
+    thread extractStage([&]() {
+        for (int cx = 0; cx < mesh.chunksPerAxis; cx++) {
+            chrono::steady_clock::time_point slabStart = chrono::steady_clock::now();
+            SlabBatch batch;
+            for (int cy = 0; cy < mesh.chunksPerAxis; cy++) {
+                for (int cz = 0; cz < mesh.chunksPerAxis; cz++) {
+                    MeshChunk chunk;
+                    ChunkedMesh::extractTriangles(grid, cx, cy, cz, chunk, stats);
+                    batch.ids.push_back(mesh.chunkId(cx, cy, cz));
+                    batch.chunks.push_back(std::move(chunk));
+                }
+            }
+            if (stats != NULL) {
+                stats->recordSlab(cx, chrono::duration<double>(chrono::steady_clock::now() - slabStart).count());
+            }
+            extracted.push(std::move(batch));
+        }
+        extracted.close();
+    });
+
+    // Stage 2: normals for every chunk of a slab.
+    thread normalStage([&]() {
+        SlabBatch batch;
+        while (extracted.pop(batch)) {
+            for (MeshChunk& chunk : batch.chunks) {
+                chunk.normals = compute_normals(chunk.vertices);
+            }
+            shaded.push(std::move(batch));
+        }
+        shaded.close();
+    });
+
+    // Stage 3 (this thread): append each slab to the PLY file and hand its chunks to the mesh.
+    unique_ptr<PLYWriter> writer(fileName.empty() ? NULL : new PLYWriter(fileName));
+    SlabBatch batch;
+    while (shaded.pop(batch)) {
+        for (size_t c = 0; c < batch.chunks.size(); c++) {
+            if (writer != NULL) {
+                writer->appendVertices(batch.chunks[c].vertices, batch.chunks[c].normals);
+            }
+            mesh.setChunk(batch.ids[c], std::move(batch.chunks[c]));
+        }
+    }
+
+    extractStage.join();
+    normalStage.join();
+    if (writer != NULL) {
+        writer->finish();
+    }
+}
+
+// Extracts the isosurface of 'f' over a LOD octree into 'mesh' and, if 'fileName' is not empty, exports it as a PLY file.
+// Each leaf's triangles go to the chunk containing the leaf's lowest corner; leaves coarser than a chunk span several
+// chunks, which only widens that chunk's bounding box. Chunks are meshed in parallel. If 'stats' is not NULL, every
+// thread counts into its own MCStats (time per slab of chunks along x) and the counters are merged into 'stats'.
+void extract_lod(const LodOctree& tree, const function<float(float, float, float)>& f, float isovalue, float min, float stepsize,
+                 ChunkedMesh& mesh, const string& fileName, MCStats* stats = NULL) {
+    // Groups the leaves by chunk.
+    vector<vector<LodLeaf>> chunkLeaves(mesh.chunks.size());
+    for (const LodLeaf& leaf : tree.leaves()) {
+        chunkLeaves[mesh.chunkId(leaf.x / CHUNK_SIZE, leaf.y / CHUNK_SIZE, leaf.z / CHUNK_SIZE)].push_back(leaf);
+    }
+
+    vector<MeshChunk> chunks(mesh.chunks.size());
+    unsigned int threadCount = std::max(1u, thread::hardware_concurrency());
+    vector<MCStats> threadStats(stats != NULL ? threadCount : 0);
+    std::atomic<int> nextChunk(0);
+    auto worker = [&](unsigned int t) {
+        MCStats* local = stats != NULL ? &threadStats[t] : NULL;
+        for (int id = nextChunk++; id < (int)chunks.size(); id = nextChunk++) {
+            chrono::steady_clock::time_point chunkStart = chrono::steady_clock::now();
+            for (const LodLeaf& leaf : chunkLeaves[id]) {
+                march_lod_leaf(LodLeafContext(tree, f, isovalue, min, stepsize, leaf, local), chunks[id].vertices);
+            }
+            chunks[id].normals = compute_normals(chunks[id].vertices);
+            chunks[id].computeBounds();
+            if (local != NULL) {
+                local->recordSlab(id / (mesh.chunksPerAxis * mesh.chunksPerAxis),
+                                  chrono::duration<double>(chrono::steady_clock::now() - chunkStart).count());
+            }
+        }
+    };
+    vector<thread> threads;
+    for (unsigned int t = 0; t < threadCount; t++) {
+        threads.emplace_back(worker, t);
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    for (const MCStats& local : threadStats) {
+        stats->merge(local);
+    }
+
+    // Writes the chunks in order and hands them to the mesh.
+    unique_ptr<PLYWriter> writer(fileName.empty() ? NULL : new PLYWriter(fileName));
+    for (size_t id = 0; id < chunks.size(); id++) {
+        if (writer != NULL) {
+            writer->appendVertices(chunks[id].vertices, chunks[id].normals);
+        }
+        mesh.setChunk(id, std::move(chunks[id]));
+    }
+    if (writer != NULL) {
+        writer->finish();
+    }
+}
+
+// Function to write an indexed mesh (shared vertices with normals, and triangles as vertex index triples) into a PLY file.
+void writeIndexedPLY(const vector<float>& vertices, const vector<float>& normals, const vector<unsigned int>& indices, const string& fileName) {
     // Open or create a file with the provided file name.
     ofstream file(fileName);
 
     // Check if the file was successfully opened/created.
-    if(file.fail()) {
+    if (file.fail()) {
         printf("ERROR: Can't create file :(");
-        return; // Exit the function if file creation/opening fails.
+        return;
     }
 
-    // Calculate the number of vertices and faces.
-    // Each vertex is represented by 3 floats (x, y, z), so the total number of vertices is the size of the vertices vector divided by 3.
-    // Each face is represented by 9 floats (3 vertices per face), so the total number of faces is the size of the vertices vector divided by 9.
-    int verticesNum = vertices.size() / 3;
-    int facesNum = vertices.size() / 9;
-
     // Write the PLY file header with format specifications and element properties.
     file << "ply" << "\n";
     file << "format ascii 1.0" << "\n";
-    file << "element vertex " << verticesNum << "\n";
+    file << "element vertex " << vertices.size() / 3 << "\n";
     file << "property float x" << "\n";
     file << "property float y" << "\n";
     file << "property float z" << "\n";
-    file << "property float nx" << "\n"; // x-component of the normal
-    file << "property float ny" << "\n"; // y-component of the normal
-    file << "property float nz" << "\n"; // z-component of the normal
-    file << "element face " << facesNum << "\n";
-    file << "property list uchar uint vertex_indices" << "\n"; // Face property indicating the indices of the vertices that form the face
+    file << "property float nx" << "\n";
+    file << "property float ny" << "\n";
+    file << "property float nz" << "\n";
+    file << "element face " << indices.size() / 3 << "\n";
+    file << "property list uchar uint vertex_indices" << "\n";
     file << "end_header" << "\n";
 
-    // Write vertex positions and normals to the file.
+    // Write the shared vertices, each followed by its normal.
     for (size_t i = 0; i < vertices.size(); i += 3) {
-        // For each vertex, write its position (x, y, z) followed by its normal (nx, ny, nz).
         file << vertices[i] << " " << vertices[i + 1] << " " << vertices[i + 2] << " ";
         file << normals[i] << " " << normals[i + 1] << " " << normals[i + 2] << "\n";
     }
 
-    // Write face data to the file. Each face is defined by 3 vertices.
-    for (size_t i = 0; i < vertices.size(); i += 9) {
-        // The '3' indicates that each face is a triangle composed of 3 vertices.
-        // The following numbers are the indices of the vertices that form each face.
-        file << "3 " << i / 3 << " " << i / 3 + 1 << " " << i / 3 + 2 << "\n";
+    // Write the triangles as indices into the vertex list.
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        file << "3 " << indices[i] << " " << indices[i + 1] << " " << indices[i + 2] << "\n";
     }
 
     // Close the file.
     file.close();
 }
+
+// Number of cells along one edge of the block meshed by one distributed job.
+#define JOB_CELLS 32
+
+// Returns the scalar field with the given name, so that worker processes can be told which field to mesh.
+function<float(float, float, float)> fieldByName(const string& name) {
+    if (name == "f1") return f1;
+    if (name == "f2") return f2;
+    if (name == "f3") return f3;
+    return NULL;
+}
+
+// Seconds a claim may be held without a result before the coordinator gives the job to another worker.
+// Claims of dead local workers are put back at once; this covers workers on other hosts.
+#define JOB_TIMEOUT_SECONDS 60
+
+// Meshes one claimed job and publishes the result, with its statistics if the job asks for them. If 'stats' is
+// not NULL, the statistics are also added to it. Returns false if the job can't be meshed here, which is then
+// published as its failure so that the coordinator stops waiting for it, or if the result can't be written.
+bool run_job(const JobSpool& spool, const MeshJob& job, MCStats* stats = NULL) {
+    function<float(float, float, float)> f = fieldByName(job.field);
+    if (!f) {
+        string error = "unknown field " + job.field;
+        printf("ERROR: Job %s: %s\n", job.name.c_str(), error.c_str());
+        if (!spool.fail(job, error)) {
+            printf("ERROR: Can't publish the failure of job %s\n", job.name.c_str());
+        }
+        return false;
+    }
+    MCStats jobStats;
+    MCStats* jobStatsPointer = job.stats || stats != NULL ? &jobStats : NULL;
+    vector<float> vertices = marching_cubes_range(f, job.isovalue, job.min, job.stepsize, job.i0, job.i1, job.j0, job.j1, job.k0, job.k1,
+                                                  jobStatsPointer);
+    if (!spool.complete(job, vertices, job.stats ? &jobStats : NULL)) {
+        printf("ERROR: Can't write the result of job %s\n", job.name.c_str());
+        return false;
+    }
+    if (stats != NULL) {
+        stats->merge(jobStats);
+    }
+    return true;
+}
+
+// Worker mode: meshes jobs from the spool until none is left, or until one fails. If 'statsFile' is not empty,
+// the statistics of the jobs this worker meshed are written to it.
+int run_worker(const string& spoolDir, const string& statsFile) {
+    JobSpool spool(spoolDir);
+    MeshJob job;
+    int jobs = 0;
+    MCStats stats;
+    while (spool.claim(job)) {
+        if (!run_job(spool, job, statsFile.empty() ? NULL : &stats)) {
+            return -1;
+        }
+        jobs++;
+    }
+    printf("Worker %d: %d jobs\n", (int)getpid(), jobs);
+    if (!statsFile.empty()) {
+        stats.print();
+        stats.writeJSON(statsFile);
+    }
+    return 0;
+}
+
+// A vertex produced by march_cube, identified by the cell edge it lies on rather than by its position: its
+// coordinates in half cells from the domain's minimum. Every such vertex is the midpoint of a cell edge, so one
+// coordinate is odd and the other two even. Both blocks on a seam give the same key for a shared vertex, even
+// though their float positions can differ in the last bits.
+struct WeldKey {
+    int32_t halfCells[3];
+
+    bool operator==(const WeldKey& other) const {
+        return halfCells[0] == other.halfCells[0] && halfCells[1] == other.halfCells[1] && halfCells[2] == other.halfCells[2];
+    }
+};
+
+struct WeldKeyHash {
+    size_t operator()(const WeldKey& key) const {
+        return (size_t)key.halfCells[0] * 73856093u ^ (size_t)key.halfCells[1] * 19349663u ^ (size_t)key.halfCells[2] * 83492791u;
+    }
+};
+
+// Coordinator mode: splits the domain into blocks of JOB_CELLS^3 cells, queues one job per block in the spool,
+// starts 'workers' local worker processes, then merges their meshes and welds the seam vertices. More workers
+// can join from other machines by running "meshgen --worker <spool>" on the same (shared) spool directory.
+// If 'statsFile' is not empty, every job's statistics are sent back with its result and merged into it.
+int run_coordinator(int workers, const string& spoolDir, const string& fieldName, float isovalue, float min, float max,
+                    float stepsize, const string& fileName, const string& statsFile) {
+    JobSpool spool(spoolDir);
+    if (!spool.create()) {
+        return -1;
+    }
+    if (!fieldByName(fieldName)) {
+        printf("ERROR: Unknown field %s\n", fieldName.c_str());
+        return -1;
+    }
+
+    // Queues the jobs, under names of their own so that other runs sharing the spool are left alone.
+    string prefix = JobSpool::runPrefix();
+    int num = static_cast<int>((max - min) / stepsize);
+    vector<string> names;
+    for (int i = 0; i < num; i += JOB_CELLS) {
+        for (int j = 0; j < num; j += JOB_CELLS) {
+            for (int k = 0; k < num; k += JOB_CELLS) {
+                char block[64];
+                snprintf(block, sizeof(block), "job_%05d_%05d_%05d", i, j, k);
+                string name = prefix + block;
+                MeshJob job = {name, fieldName, isovalue, min, stepsize,
+                               i, std::min(i + JOB_CELLS, num), j, std::min(j + JOB_CELLS, num), k, std::min(k + JOB_CELLS, num),
+                               statsFile.empty() ? 0 : 1, ""};
+                if (!spool.submit(job)) {
+                    printf("ERROR: Can't queue job %s\n", name.c_str());
+                    return -1;
+                }
+                names.push_back(name);
+            }
+        }
+    }
+    printf("Coordinator: %zu jobs, %d local workers, spool %s\n", names.size(), workers, spoolDir.c_str());
+
+    // Waits for the result of every job, wherever it is meshed. A job is put back in the queue when the worker
+    // holding it is known to have died, or has held it for JOB_TIMEOUT_SECONDS without a result. Once no local
+    // worker is left, the coordinator meshes the jobs still queued itself. If a job fails, the run is given up.
+    vector<pid_t> local = launchWorkers(workers, {"--worker", spoolDir});
+    // Gives up the run: withdraws the jobs still queued, so that the local workers run out of them, waits for
+    // those workers and removes every file of the run. A worker on another host that is still meshing one of
+    // the jobs leaves its result behind in 'done/'.
+    auto abandon = [&]() {
+        for (const string& name : names) {
+            spool.remove(name);
+        }
+        for (pid_t pid : local) {
+            int status;
+            waitpid(pid, &status, 0);
+        }
+        for (const string& name : names) {
+            spool.remove(name);
+        }
+        return -1;
+    };
+    unordered_map<string, chrono::steady_clock::time_point> claimSeen; // When each claim was first seen
+    size_t done = 0;
+    while (done < names.size()) {
+        while (done < names.size() && spool.hasResult(names[done])) {
+            done++;
+        }
+        if (done == names.size()) {
+            break;
+        }
+        string error;
+        if (spool.failure(names[done], error)) {
+            printf("ERROR: Job %s failed on %s\n", names[done].c_str(), error.c_str());
+            return abandon();
+        }
+
+        for (size_t w = 0; w < local.size();) {
+            int status;
+            if (waitpid(local[w], &status, WNOHANG) == local[w]) {
+                local.erase(local.begin() + w);
+            } else {
+                w++;
+            }
+        }
+
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        for (const JobClaim& claim : spool.claims(prefix)) {
+            if (spool.hasResult(claim.name)) {
+                continue;
+            }
+            chrono::steady_clock::time_point seen = claimSeen.emplace(claim.file, now).first->second;
+            bool dead = JobSpool::ownerDead(claim);
+            if (dead || now - seen > chrono::seconds(JOB_TIMEOUT_SECONDS)) {
+                printf("Coordinator: job %s of worker %s:%d put back (%s)\n", claim.name.c_str(), claim.host.c_str(), claim.pid,
+                       dead ? "worker died" : "no result in time");
+                spool.requeue(claim);
+                claimSeen.erase(claim.file);
+            }
+        }
+
+        MeshJob job;
+        if (local.empty() && spool.claim(job, prefix)) {
+            if (!run_job(spool, job)) {
+                return abandon();
+            }
+            continue;
+        }
+        this_thread::sleep_for(chrono::milliseconds(20));
+    }
+
+    // Merges the partial meshes, welding the vertices that lie on the same cell edge.
+    unordered_map<WeldKey, unsigned int, WeldKeyHash> welded;
+    vector<float> vertices;
+    vector<unsigned int> indices;
+    vector<float> part;
+    size_t inputVertices = 0;
+    MCStats stats;
+    for (const string& name : names) {
+        if (!spool.result(name, part, statsFile.empty() ? NULL : &stats)) {
+            printf("ERROR: Job %s has no result\n", name.c_str());
+            return -1;
+        }
+        spool.remove(name);
+        inputVertices += part.size() / 3;
+        for (size_t v = 0; v < part.size(); v += 3) {
+            WeldKey key;
+            for (int a = 0; a < 3; a++) {
+                key.halfCells[a] = static_cast<int32_t>(std::lround((part[v + a] - min) / stepsize * 2.0f));
+            }
+            auto found = welded.find(key);
+            if (found == welded.end()) {
+                found = welded.emplace(key, (unsigned int)(vertices.size() / 3)).first;
+                vertices.insert(vertices.end(), {part[v], part[v + 1], part[v + 2]});
+            }
+            indices.push_back(found->second);
+        }
+    }
+
+    // Smooth normals: each vertex averages the (area weighted) normals of the triangles around it.
+    vector<float> normals(vertices.size(), 0.0f);
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        vec3 p0(vertices[3 * indices[t]], vertices[3 * indices[t] + 1], vertices[3 * indices[t] + 2]);
+        vec3 p1(vertices[3 * indices[t + 1]], vertices[3 * indices[t + 1] + 1], vertices[3 * indices[t + 1] + 2]);
+        vec3 p2(vertices[3 * indices[t + 2]], vertices[3 * indices[t + 2] + 1], vertices[3 * indices[t + 2] + 2]);
+        vec3 normal = cross(p1 - p0, p2 - p0);
+        for (int c = 0; c < 3; c++) {
+            for (int a = 0; a < 3; a++) {
+                normals[3 * indices[t + c] + a] += normal[a];
+            }
+        }
+    }
+    for (size_t v = 0; v < normals.size(); v += 3) {
+        vec3 n(normals[v], normals[v + 1], normals[v + 2]);
+        if (dot(n, n) > 0.0f) {
+            n = normalize(n);
+        }
+        normals[v] = n.x; normals[v + 1] = n.y; normals[v + 2] = n.z;
+    }
+
+    writeIndexedPLY(vertices, normals, indices, fileName);
+    printf("Coordinator: %zu triangles, %zu vertices welded into %zu\n", indices.size() / 3, inputVertices, vertices.size() / 3);
+    if (!statsFile.empty()) {
+        stats.print();
+        stats.writeJSON(statsFile);
+    }
+    return 0;
+}
+
 // The 'render' function is responsible for rendering 3D geometry.
 void render (std::vector<float> vertices, std::vector<float> normalVertices, glm::mat4 MVP) {
 
@@ -542,6 +1661,10 @@ void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int
     if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
         camera.updateRadius(0.1f); // Increase the camera's radius to zoom out.
     }
+    // Cut a ball out of the field when the E key is pressed.
+    if (key == GLFW_KEY_E && action == GLFW_PRESS) {
+        editRequested = true;
+    }
 }
 
 // Callback function for handling mouse button events.
@@ -561,7 +1684,34 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+
+    // Command line options:
+    //   --lod                  extract at full resolution near the camera and coarser further away
+    //   --coordinator N        mesh through a job spool with N local worker processes, write output3.ply and exit
+    //   --spool DIR            spool directory used by --coordinator (default "meshgen-spool")
+    //   --worker DIR           mesh jobs from the spool DIR until none is left, then exit
+    //   --stats FILE           collect marching cubes statistics and write them to FILE as JSON (with --coordinator,
+    //                          those of all jobs; with --worker, those of the jobs this worker meshed)
+    bool useLod = false;
+    string statsFile;
+    int coordinatorWorkers = -1;
+    string spoolDir = "meshgen-spool";
+    bool worker = false;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--lod") == 0) {
+            useLod = true;
+        } else if (strcmp(argv[a], "--coordinator") == 0 && a + 1 < argc) {
+            coordinatorWorkers = atoi(argv[++a]);
+        } else if (strcmp(argv[a], "--spool") == 0 && a + 1 < argc) {
+            spoolDir = argv[++a];
+        } else if (strcmp(argv[a], "--worker") == 0 && a + 1 < argc) {
+            worker = true;
+            spoolDir = argv[++a];
+        } else if (strcmp(argv[a], "--stats") == 0 && a + 1 < argc) {
+            statsFile = argv[++a];
+        }
+    }
 
     // Set an isovalue for the marching cubes algorithm. This value determines the threshold at which the surface is created.
     float isoval = 1;
@@ -573,6 +1723,14 @@ int main() {
     // Define the step size for the marching cubes algorithm. This affects the resolution of the generated mesh.
     float stepsize = 0.1f;
 
+    // The distributed modes run without a window.
+    if (worker) {
+        return run_worker(spoolDir, statsFile);
+    }
+    if (coordinatorWorkers >= 0) {
+        return run_coordinator(coordinatorWorkers, spoolDir, "f3", -1.5, min, max, stepsize, "output3.ply", statsFile);
+    }
+
     // Initialize GLFW, a library for creating windows, contexts, and managing input and events.
     if( !glfwInit() ) {
         getchar(); // Wait for user input before closing, in case of initialization failure.
@@ -613,20 +1771,51 @@ int main() {
     // Set the depth function to GL_LESS, which means that closer objects will obscure further ones.
     glDepthFunc(GL_LESS);
 
-    // Call the marching cubes algorithm to generate vertices for a 3D shape based on a scalar field, using the parameters defined earlier.
-    std::vector<float> vertices = marching_cubes(
-        f3, // Scalar field function or data
-        -1.5, // Number of divisions along each axis. Higher numbers increase resolution but also computational cost.
-        min, // Minimum value of the scalar field
-        max, // Maximum value of the scalar field
-        stepsize // Step size for the algorithm
-    );
+    // Number of cells along one axis of the domain at the finest resolution.
+    int num = static_cast<int>((max - min) / stepsize);
 
-    // Calculate normals for the vertices of the mesh. Normals are essential for lighting calculations in 3D graphics.
-    std::vector<float> normals = compute_normals(vertices);
+    // The isosurface, split into spatial chunks that can be culled (and, for the sparse field, re-meshed) independently.
+    ChunkedMesh mesh(num);
+
+    // The field being meshed and its sparse cache, kept to apply edits (the LOD octree is not edited).
+    function<float(float, float, float)> field = f3;
+    float isovalue = -1.5f;
+    unique_ptr<SparseBrickGrid> grid;
+
+    // Counters of the extraction, only collected when asked for.
+    MCStats stats;
+    MCStats* statsPointer = statsFile.empty() ? NULL : &stats;
+
+    if (useLod) {
+        // Choose a resolution for each part of the domain from its distance to the camera, then mesh every
+        // octree leaf at its own resolution and export the result as a PLY (Polygon File Format) file.
+        LodOctree tree(num, (camera.getPosition() - vec3(min)) / stepsize, LOD_DETAIL);
+        vector<LodLeaf> leaves = tree.leaves();
+        printf("LOD octree: %zu leaves, levels 0 to %d\n", leaves.size(), tree.maxLevel);
+        extract_lod(tree, field, isovalue, min, stepsize, mesh, "output3.ply", statsPointer);
+    } else {
+        // Sample the scalar field into a sparse brick cache. Only the bricks the isosurface passes through are
+        // allocated, the rest are stored as a single value, so memory follows the surface rather than the volume.
+        grid.reset(new SparseBrickGrid(
+            field, // Scalar field function or data
+            isovalue, // Isovalue of the surface to extract
+            min, // Minimum value of the scalar field
+            max, // Maximum value of the scalar field
+            stepsize // Step size for the algorithm
+        ));
+        printf("Sparse field: %zu of %zu bricks active, %zu bytes (dense: %zu bytes)\n",
+               grid->activeBricks.size(), grid->brickIndex.size(), grid->memoryBytes(), grid->denseBytes());
+
+        // Extract the isosurface from the active bricks. Normals and the PLY (Polygon File Format) export are
+        // computed in pipeline stages that overlap with the extraction.
+        extract_pipelined(*grid, mesh, "output3.ply", statsPointer);
+        stats.fieldEvaluations += grid->fieldEvaluations; // The field is only called while sampling the bricks.
+    }
 
-    // Write the vertices and their normals to a PLY (Polygon File Format) file. This format is commonly used for storing 3D data.
-    writePLY(vertices, normals, "output3.ply");
+    if (statsPointer != NULL) {
+        stats.print();
+        stats.writeJSON(statsFile);
+    }
 
     // Declare a 4x4 matrix for the Model-View-Projection transformation, which is used to transform vertices from model space to screen space.
     mat4 mvp;
@@ -640,16 +1829,6 @@ int main() {
     // Set the direction of the light source. Normalizing the vector ensures it has a length of 1, making it a direction vector.
     vec3 lightDir = normalize(vec3(5.0f, 5.0f, 5.0f));
 
-    // Declare a Vertex Array Object (VAO). VAOs store pointers to vertex buffer objects and the configuration of vertex attributes.
-    GLuint VAO;
-
-    // Declare a Vertex Buffer Object (VBO) for storing vertex data (positions, colors, etc.) in GPU memory for efficient access by the vertex shader.
-    GLuint VBO;
-
-    // Declare a Normal Buffer Object (NBO) for storing vertex normals. Normals are used in lighting calculations to determine how light interacts with the surface of the model.
-    GLuint NBO;
-
-
 	// Continuously check if the window should close or if the ESC key is pressed. If neither is true, the loop continues.
     while(glfwWindowShouldClose(window) == 0 && glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS) {
         // Clear the color and depth buffers to reset the frame and prepare for new drawing.
@@ -689,56 +1868,6 @@ int main() {
         // Here, the model matrix is an identity matrix, implying no transformation to the model coordinates.
         mvp = projectionMatrix * v * (mat4(1.0f));
 
-        // Generate a single Vertex Array Object (VAO). The VAO stores the layout of our vertex data and is bound before drawing.
-        glGenVertexArrays(1, &VAO);
-
-        // Generate a Vertex Buffer Object (VBO) to store the vertex data.
-        glGenBuffers(1, &VBO);
-
-        // Generate a Normal Buffer Object (NBO) to store the normals for the vertices.
-        glGenBuffers(1, &NBO);
-
-        // Bind the VAO as the current vertex array to be used.
-        glBindVertexArray(VAO);
-
-        // Bind the VBO as the current GL_ARRAY_BUFFER. Subsequent buffer data operations will affect this VBO.
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-        // Upload the vertex data to the VBO. The data is dynamic, as it might change (hence GL_DYNAMIC_DRAW).
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_DYNAMIC_DRAW);
-
-        // Define an array of generic vertex attribute data. The parameters specify the location (0), number of components (3, for x/y/z),
-        // type of data (GL_FLOAT), normalization flag (GL_FALSE), stride (distance between consecutive vertex attributes),
-        // and the offset within the buffer (0 in this case).
-        glVertexAttribPointer(0,
-                              3,
-                              GL_FLOAT,
-                              GL_FALSE,
-                              3 * sizeof(float),
-                              (void*)0
-        );
-
-        // Enable the vertex attribute array for location 0, making it available for rendering.
-        glEnableVertexAttribArray(0);
-
-        // Bind the NBO as the current GL_ARRAY_BUFFER to upload normal data.
-        glBindBuffer(GL_ARRAY_BUFFER, NBO);
-
-        // Upload the normal data to the NBO. This data is also dynamic, hence GL_DYNAMIC_DRAW.
-        glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(float), normals.data(), GL_DYNAMIC_DRAW);
-
-        // Define another array of generic vertex attribute data for normals, using location 1.
-        glVertexAttribPointer(1,
-                              3,
-                              GL_FLOAT,
-                              GL_FALSE,
-                              3 * sizeof(float),
-                              (void*)0
-        );
-
-        // Enable the vertex attribute array for location 1, making the normals available for rendering.
-        glEnableVertexAttribArray(1);
-
         // Activate the shader program to be used in rendering.
         glUseProgram(shaderProgram);
 
@@ -777,16 +1906,21 @@ int main() {
         // Enable lighting by setting the corresponding uniform variable in the shader.
         glUniform1i(glGetUniformLocation(shaderProgram, "enableLighting"), 1);
 
-        // Bind the VAO containing the vertex attributes for drawing.
-        glBindVertexArray(VAO);
-
-        // Draw the vertices as triangles starting from index 0.
-        glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 3);
+        // Apply a requested edit: cut a ball out of the surface where the camera's line of sight to the origin
+        // first meets it, and re-mesh only the chunks the ball touches.
+        if (editRequested) {
+            editRequested = false;
+            vec3 centre;
+            if (!grid) {
+                printf("Edits are not available with --lod\n");
+            } else if (first_crossing(field, isovalue, camera.getPosition(), vec3(0.0f), stepsize, centre)) {
+                field = cut_ball(field, isovalue, centre, EDIT_RADIUS);
+                mesh.applyEdit(*grid, field, centre - vec3(EDIT_RADIUS), centre + vec3(EDIT_RADIUS));
+            }
+        }
 
-        // Clean up by deleting the VAO and VBOs after drawing is done.
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &NBO);
+        // Draw only the chunks inside the view frustum of the camera.
+        mesh.draw(Frustum(projectionMatrix * v));
 
         // Disable lighting after drawing is complete.
         glUniform1i(glGetUniformLocation(shaderProgram, "enableLighting"), 0);
@@ -0,0 +1,105 @@
+// Bakes BMP textures into the mesh cache ahead of time, compressed to BC1/BC3 with every mip level, so
+// the programs using them start without encoding anything. Run it from the folder of the program, with
+// the texture paths exactly as the program names them, e.g. from water-simulation:
+//
+//     ../texture-baker/texbake Assets/boat.bmp Assets/head.bmp Assets/eyes.bmp
+//
+// Each texture is rebaked even if its entry is up to date. --rgba bakes uncompressed RGBA8 instead. --array
+// bakes all the files as the layers of one array texture, in the order given, as the Linked House Navigator
+// loads them:
+//
+//     ../texture-baker/texbake --array ./files/*.bmp
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../common/BmpLoader.hpp"
+#include "../common/TextureCompress.hpp"
+#include "../common/MeshCache.hpp"
+
+static const char* formatName(TextureFormat format) {
+    return format == TEXTURE_BC1 ? "BC1" : format == TEXTURE_BC3 ? "BC3" : "RGBA8";
+}
+
+// Bakes the texture entry for 'sources' (one file, or the layers of an array texture) and prints its sizes,
+// error and the time taken. Returns false if a file can't be read or the entry can't be written.
+static bool bakeTexture(const std::vector<std::string>& sources, bool compress, size_t& totalBefore, size_t& totalAfter) {
+    std::vector<unsigned char> texels;
+    unsigned int width = 0, height = 0;
+    uint32_t layers = (uint32_t)sources.size();
+    if (layers == 1 ? !loadBMP(sources[0], texels, width, height) : !loadBMPLayers(sources, texels, width, height)) {
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    TextureFormat format = compress ? compressedFormat(texels.data(), (size_t)width * height * layers) : TEXTURE_RGBA8;
+    MeshCache cache;
+    if (!MeshCache::bake(sources, CompactMesh(), texels.data(), width, height, 4, format, layers) || !cache.open(sources, sizeof(CompactVertex))) {
+        printf("ERROR: Can't write the cache entry for %s\n", sources[0].c_str());
+        return false;
+    }
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Sizes of the whole mip chain, uncompressed and as stored
+    size_t before = 0, after = 0;
+    for (uint32_t level = 0; level < cache.mipCount(); level++) {
+        before += (size_t)cache.mipWidth(level) * cache.mipHeight(level) * 4 * layers;
+        after += cache.mipBytes(level) * layers;
+    }
+    totalBefore += before;
+    totalAfter += after;
+
+    // Error of the full-size level over all four channels, decoded as the GPU would
+    double rmse = 0.0;
+    if (format != TEXTURE_RGBA8) {
+        std::vector<unsigned char> decoded(texels.size());
+        size_t layerTexels = (size_t)width * height * 4;
+        for (uint32_t layer = 0; layer < layers; layer++) {
+            decompressTexture(cache.mip(0) + cache.mipBytes(0) * layer, width, height, format, decoded.data() + layerTexels * layer);
+        }
+        double sum = 0.0;
+        for (size_t n = 0; n < texels.size(); n++) {
+            double d = (double)decoded[n] - texels[n];
+            sum += d * d;
+        }
+        rmse = std::sqrt(sum / texels.size());
+    }
+    std::string name = layers == 1 ? sources[0] : "Array of " + std::to_string(layers) + " layers";
+    printf("%s: %ux%u %s, %u mips, %.1f KB -> %.1f KB, RMSE %.2f, %.1f ms\n", name.c_str(), width, height,
+           formatName(format), cache.mipCount(), before / 1024.0, after / 1024.0, rmse, milliseconds);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    bool compress = true, array = false;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rgba") == 0) {
+            compress = false;
+        } else if (strcmp(argv[i], "--array") == 0) {
+            array = true;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        printf("Usage: %s [--rgba] [--array] texture.bmp...\n", argv[0]);
+        return 1;
+    }
+
+    size_t totalBefore = 0, totalAfter = 0;
+    int failed = 0;
+    if (array) {
+        failed += bakeTexture(paths, compress, totalBefore, totalAfter) ? 0 : 1;
+    } else {
+        for (const std::string& path : paths) {
+            failed += bakeTexture({path}, compress, totalBefore, totalAfter) ? 0 : 1;
+        }
+    }
+    if (totalAfter > 0) {
+        printf("Total: %.1f KB -> %.1f KB (%.1fx smaller)\n", totalBefore / 1024.0, totalAfter / 1024.0, (double)totalBefore / totalAfter);
+    }
+    return failed == 0 ? 0 : 1;
+}
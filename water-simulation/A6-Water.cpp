@@ -16,6 +16,13 @@
 #include <vector>  // Dynamic array
 #include <map>  // Associative arrays
 #include "PlaneMesh.hpp"  // Custom class for plane mesh operations
+#include "../common/PlyLoader.hpp"  // Shared PLY loader, parsing mesh files in place from a memory mapping
+#include "../common/MeshCache.hpp"  // Baked GPU-ready copies of meshes and textures, reused between runs
+#include "../common/MeshOptimize.hpp"  // Triangle and vertex reordering for the GPU's vertex caches
+#include "../common/Meshlets.hpp"  // Small triangle clusters culled on the CPU every frame
+#include "../common/CompactVertex.hpp"  // Quantized 16-byte vertices and 16-bit indices, the form meshes are uploaded in
+#include "../common/AssetManager.hpp"  // Loads each mesh, texture and shader program once and shares it
+#include "../common/DrawQueue.hpp"  // Draws objects sorted by state and depth, opaque before transparent
 
 // Additional utilities for file and string operations
 #include <string.h>
@@ -45,6 +52,9 @@ struct VertexData {
         color(col),           // Initializes color with col argument.
         texturePoints(tex)    // Initializes texturePoints with tex argument.
     {}
+
+    // Default vertex used by the PLY loader for properties a file doesn't have: white, everything else zero.
+    VertexData() : pos(0.0f), normal(0.0f), color(1.0f), texturePoints(0.0f) {}
 };
 
 
@@ -62,8 +72,8 @@ private:
     GLuint VID;  // Uniform location for the View matrix in the shader
     GLuint LightPosID;  // Uniform location for the light position in the shader
     GLfloat offset = 0;  // Offset of the plane from the origin, initialized to 0
-    GLuint texID = 0;  // Texture ID for applying a texture to the plane, initialized to 0 (no texture)
-    GLuint programID;  // ID for the shader program used to render the plane
+    GLTexture texID;  // Texture applied to the plane, deleted with it; empty until loaded
+    GLProgram programID;  // Shader program used to render the plane, deleted with it
     GLuint colorID;  // Uniform location for the plane's color in the shader
     GLuint alphaID;  // Uniform location for the plane's alpha (transparency) in the shader
     GLuint MVPID;  // Uniform location for the Model-View-Projection matrix in the shader
@@ -71,28 +81,28 @@ private:
 public:
     // Constructor for the Plane class that initializes a plane with a specific size and texture
     Plane(GLfloat sz, string textureFile) : size(sz) {  // size of the plane, 'textureFile' is the path to the texture image
-        unsigned char* data;  // Pointer to hold the raw texture data
-        unsigned int width, height;  // Variables to hold the dimensions of the texture image
+        vector<unsigned char> data;  // Texture data, RGBA8
+        unsigned int width = 0, height = 0;  // Variables to hold the dimensions of the texture image
 
-        loadBMP(textureFile.c_str(), &data, &width, &height);  // Load the bitmap image and get the texture data along with its dimensions
+        loadBMP(textureFile, data, width, height);  // Load the bitmap image and get the texture data along with its dimensions
         fprintf(stderr, "w: %d, h: %d\n", width, height);
 
-        glGenTextures(1, &texID);  // Generate one texture object and store its ID in 'texID'
+        texID = GLTexture::create();  // Generate one texture object, owned by 'texID'
         glBindTexture(GL_TEXTURE_2D, texID);  // Bind the newly created texture as the current 2D texture
         // Placeholder for texture data loading; actual loading happens after 'loadBMP'
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);  // Allocate memory for the texture
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.empty() ? NULL : data.data());  // Allocate memory for the texture
         glGenerateMipmap(GL_TEXTURE_2D);  // Generate mipmaps for the texture
         glBindTexture(GL_TEXTURE_2D, 0);  // Unbind the texture
 
 
-        programID = LoadShaders( "WaterShader.vertexshader", "WaterShader.fragmentshader" ); // Load and compiler shaders
+        programID.reset(LoadShaders( "WaterShader.vertexshader", "WaterShader.fragmentshader" )); // Load and compiler shaders
 
         MID = glGetUniformLocation(programID, "M");  // Get the location of the Model matrix uniform variable in the shader
         VID = glGetUniformLocation(programID, "V");  // Get the location of the View matrix uniform variable in the shader
         colorID = glGetUniformLocation(programID, "modelcolor");  // Get the location of the model color uniform variable in the shader
         alphaID = glGetUniformLocation(programID, "alpha");  // Get the location of the alpha (transparency) uniform variable in the shader
         LightPosID = glGetUniformLocation(programID, "LightPosition_worldspace");  // Get the location of the light position uniform variable in the shader
-        programID = LoadShaders("WaterShader.vertexshader", "WaterShader.fragmentshader");  // Load and compile the vertex and fragment shaders
+        programID.reset(LoadShaders("WaterShader.vertexshader", "WaterShader.fragmentshader"));  // Load and compile the vertex and fragment shaders; the first program is deleted
         MVPID = glGetUniformLocation(programID, "MVP");  // Get the location of the MVP uniform variable in the shader
 
         glUseProgram(programID);  // Use the shader program
@@ -355,225 +365,110 @@ void processInput(GLFWwindow* window) {
 
 // Function to read vertex and face data from a PLY file
 void readPLYFile(const std::string& fname, std::vector<VertexData>& vertices, std::vector<TriData>& faces) {
-    // Attempt to open the PLY file
-    std::ifstream file(fname);
-    if (!file) { // If file not found or inaccessible, log an error and exit
+    // Where each PLY vertex property goes in VertexData. Colors are stored as 0-255 and converted to [0, 1], and
+    // texture coordinates are also accepted as s/t or texture_u/texture_v.
+    static const std::vector<PlyAttribute> attributes = {
+        {"x", offsetof(VertexData, pos), 1.0f},
+        {"y", offsetof(VertexData, pos) + sizeof(float), 1.0f},
+        {"z", offsetof(VertexData, pos) + 2 * sizeof(float), 1.0f},
+        {"nx", offsetof(VertexData, normal), 1.0f},
+        {"ny", offsetof(VertexData, normal) + sizeof(float), 1.0f},
+        {"nz", offsetof(VertexData, normal) + 2 * sizeof(float), 1.0f},
+        {"red", offsetof(VertexData, color), 1.0f / 255.0f},
+        {"green", offsetof(VertexData, color) + sizeof(float), 1.0f / 255.0f},
+        {"blue", offsetof(VertexData, color) + 2 * sizeof(float), 1.0f / 255.0f},
+        {"u|s|texture_u", offsetof(VertexData, texturePoints), 1.0f},
+        {"v|t|texture_v", offsetof(VertexData, texturePoints) + sizeof(float), 1.0f},
+    };
+
+    // Memory-maps the file and parses it in place; vertices missing a property keep VertexData's defaults
+    if (!loadPLY(fname, attributes, vertices, faces)) {
         std::cerr << "Error opening file: " << fname << std::endl;
-        return;
-    }
-
-    std::string line; // Variable to store each line read from the file
-    int numVerts = 0, numFaces = 0; // Variables to store the count of vertices and faces
-    std::vector<std::string> properties; // Vector to store the properties of each vertex
-
-    // Loop through the header lines to parse metadata
-    while (std::getline(file, line) && line != "end_header") {
-        std::istringstream stream(line); // Stream to parse each line
-        std::string token; // Variable to store each word in a line
-        stream >> token; // Read the first word to determine the line type
-
-        if (token == "element") { // If the line defines an element...
-            stream >> token; // Read the type of element (vertex or face)
-            if (token == "vertex") stream >> numVerts; // If element is a vertex, store its count
-            else if (token == "face") stream >> numFaces; // If element is a face, store its count
-        } else if (token == "property") { // If the line defines a property...
-            stream >> token; // Skip the data type of the property
-            stream >> token; // Read the actual property name
-            properties.push_back(token); // Store the property name for later use
-        }
     }
-
-    // Loop through each vertex in the file
-    for (int i = 0; i < numVerts; ++i) {
-        std::getline(file, line); // Read a line of vertex data
-        std::istringstream stream(line); // Stream to parse the vertex data line
-
-        // Variables to store vertex properties. Default color to white.
-        vec3 position, normal, color(1.0f);
-        vec2 textureCoords;
-
-        // Loop through each property of the vertex
-        for (size_t i = 0; i < properties.size(); ++i) {
-            const auto& prop = properties[i];
-            if (prop == "x") stream >> position.x; // Extract x-coordinate
-            else if (prop == "red") {
-                float r;
-                stream >> r;
-                color.r = r / 255.0f; // Extract red color component and convert to range [0, 1]
-            }
-            else if (prop == "green") {
-                float g;
-                stream >> g;
-                color.g = g / 255.0f; // Extract green color component and convert to range [0, 1]
-            }
-            else if (prop == "ny") stream >> normal.y; // Extract y-coordinate of normal
-            else if (prop == "y") stream >> position.y; // Extract y-coordinate
-            else if (prop == "nx") stream >> normal.x; // Extract x-coordinate of normal
-            else if (prop == "z") stream >> position.z; // Extract z-coordinate
-            else if (prop == "blue") {
-                float b;
-                stream >> b;
-                color.b = b / 255.0f; // Extract blue color component and convert to range [0, 1]
-            }
-            else if (prop == "u") stream >> textureCoords.x; // Extract u-coordinate of texture
-            else if (prop == "nz") stream >> normal.z; // Extract z-coordinate of normal
-            else if (prop == "v") stream >> textureCoords.y; // Extract v-coordinate of texture
-        }
-
-        // Use the parsed data to construct a VertexData object and add it to the vertices vector
-        vertices.emplace_back(position, normal, color, textureCoords);
 }
 
+class TexturedMesh {
+private:
+    MeshHandle mesh; // Shared GPU copy of the mesh: compact vertices and indices in a VAO, plus the meshlets used for culling.
+    TextureHandle texture; // Shared texture to be applied on the mesh, with all of its mip levels.
+    std::shared_future<MeshHandle> pendingMesh; // The mesh and texture loading in the background, picked up once uploaded.
+    std::shared_future<TextureHandle> pendingTexture;
+    ProgramHandle program; // Shader program used for rendering the mesh.
+    bool cullBackfaces; // Whether clusters facing away from the camera are skipped; only for closed meshes.
+    vector<GLsizei> drawCounts; // Index ranges of the clusters that survived culling this frame, for glMultiDrawElements.
+    vector<const void*> drawOffsets;
 
-    // Parse face data
-    for (int i = 0; i < numFaces; ++i) {
-        getline(file, line); // Read a line of face data
-        istringstream stream(line); // Stream to parse the face data line
-        unsigned int numVertices;
-        stream >> numVertices;
+public:
 
-        TriData tri;
-        for (int j = 0; j < 3; ++j) { // Assume triangular faces, parse each vertex index
-            stream >> tri.vertex_indices[j];
+    // Queues the textured mesh on 'queue', with a given transformation matrix; 'view' places it in front of the camera,
+    // for the queue to sort opaque meshes front to back
+    void submit(DrawQueue& queue, mat4 MVP, mat4 view) {
+        // Pick up the mesh and texture once they have been uploaded; nothing is drawn before the mesh is
+        if (!mesh && isLoaded(pendingMesh)) {
+            mesh = pendingMesh.get();
+        }
+        if (!texture && isLoaded(pendingTexture)) {
+            texture = pendingTexture.get();
+        }
+        if (!mesh || !program) {
+            return;
         }
-        faces.push_back(tri); // Add the parsed face to the faces vector
-    }
-    file.close(); // Close the file once parsing is complete
-}
 
-class TexturedMesh {
-private:
-    vector<VertexData> vertices; // Stores the vertices of the mesh, each containing position, normal, color, and texture coordinates.
-    vector<TriData> faces; // Stores triangles of the mesh, each containing indices to three vertices.
-    GLuint vboNormalPos; // ID for the buffer storing vertices' normal vector data.
-    GLuint vboVertexPos; // ID for the buffer storing vertices' position data.
-    GLuint vboTexturePoints; // ID for the buffer storing vertices' texture coordinate data.
-    GLuint eboFacesIndices; // ID for the buffer storing indices that define each triangle (face) of the mesh.
-    GLuint textureID; // ID for the texture to be applied on the mesh.
-    GLuint shaderID; // ID for the shader program used for rendering the mesh.
-    GLuint vao; // ID for the Vertex Array Object that encapsulates vertex buffer object bindings and vertex attribute configurations.
+        // Keep the clusters inside the view frustum (and, if enabled, not facing away); the mesh is drawn untransformed,
+        // so the MVP matrix also gives the camera's position in mesh space
+        cullMeshlets(mesh->meshlets, Frustum(MVP), cullBackfaces, drawCounts, drawOffsets, mesh->indexSize);
+        if (drawCounts.empty()) {
+            return;
+        }
 
-public:
+        // The queue binds the shader program, the mesh's texture to texture unit 0 and its vertex array object (VAO)
+        DrawState state;
+        state.program = program->id;
+        state.texture = texture ? texture->id.id() : 0;
+        state.vao = mesh->vao;
+        vec3 center = mesh->positionOffset + mesh->positionScale * 0.5f;
+        queue.submit(state, viewDepth(view, center), false, [this, MVP]() { draw(MVP); });
+    }
 
-    // Renders the textured mesh with a given transformation matrix
+    // Renders the clusters kept by submit() with a given transformation matrix, once the queue has bound the mesh's state
     void draw(mat4 MVP) {
-        // Enable alpha blending for transparency
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        GLuint shaderID = program->id;
 
-        // Use the shader program and set the MVP matrix uniform
-        glUseProgram(shaderID);
+        // Set the MVP matrix uniform
         GLuint MatrixID = glGetUniformLocation(shaderID, "MVP");
         glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
 
-        // Enable texture mapping and bind the mesh's texture
-        glEnable(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        // The vertices are compact (see CompactVertex); tell the shader how to decode their positions and normals
+        glUniform3fv(glGetUniformLocation(shaderID, "positionOffset"), 1, &mesh->positionOffset[0]);
+        glUniform3fv(glGetUniformLocation(shaderID, "positionScale"), 1, &mesh->positionScale[0]);
+        glUniform1i(glGetUniformLocation(shaderID, "octahedralNormals"), 1);
 
-        // Bind the mesh's vertex array object (VAO) to set up drawing states
-        glBindVertexArray(vao);
+        // Sample the mesh's texture from texture unit 0
+        glUniform1i(glGetUniformLocation(shaderID, "texture"), 0);
 
-        // Draw the mesh as a series of triangles using the indices in the element buffer and unbind the VAO to clean up
-        size_t num_faces = faces.size() * 3;
-        glDrawElements(GL_TRIANGLES, num_faces, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // Reset state by unbinding the shader program and texture, and disable blending
-        glUseProgram(0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glDisable(GL_BLEND);
+        // Draw the surviving clusters in one call, neighbouring ones merged into one index range
+        glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), mesh->indexType, drawOffsets.data(), (GLsizei)drawCounts.size());
     }
 
-    // Constructor for the TexturedMesh class
-    TexturedMesh(const char* plyFilePath, const char* filePath, GLuint shaderID) {
-        // Prepare vectors for OpenGL attribute data
-        vector<GLfloat> vertexPos;
-        vector<GLfloat> vertexTexturePoints;
-        vector<GLfloat> normalPos;
-
-        // Load vertex and triangle data from a PLY file
-        readPLYFile(plyFilePath, vertices, faces);
-
-        // Store the shader ID
-        this->shaderID = shaderID;
-
-        // Load texture data from a BMP file
-        unsigned char* data;
-        GLuint width, height;
-        loadARGB_BMP(filePath, &data, &width, &height);
-
-        // Convert texture coordinates from VertexData to a flat vector
-        vertexTexturePoints.reserve(vertices.size() * 2);
-        for (size_t i = 0; i < vertices.size(); ++i) {
-            vertexTexturePoints.push_back(vertices[i].texturePoints.x);
-            vertexTexturePoints.push_back(vertices[i].texturePoints.y);
-        }
-
-        // Convert vertex normals from VertexData to a flat vector
-        for (size_t i = 0; i < vertices.size(); ++i) {
-            normalPos.push_back(vertices[i].normal.x);
-            normalPos.push_back(vertices[i].normal.y);
-            normalPos.push_back(vertices[i].normal.z);
-        }
-
-        // Convert vertex positions from VertexData to a flat vector
-        vertexPos.reserve(vertices.size() * 3);
-        for (size_t i = 0; i < vertices.size(); ++i) {
-            vertexPos.push_back(vertices[i].pos.x);
-            vertexPos.push_back(vertices[i].pos.y);
-            vertexPos.push_back(vertices[i].pos.z);
-        }
-
-        // Generate and set up the texture
-        glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        // Bind texture to the shader
-        glUseProgram(shaderID);
-        glUniform1i(glGetUniformLocation(shaderID, "texture"), 0); // Texture unit 0
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glUseProgram(0);
-
-        // Setup the vertex array object (VAO)
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-
-        // Setup and enable the texture coordinate attribute
-        size_t num_vertexTexPoints = vertexTexturePoints.size();
-        glGenBuffers(1, &vboTexturePoints);
-        glBindBuffer(GL_ARRAY_BUFFER, vboTexturePoints);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * num_vertexTexPoints, vertexTexturePoints.data(), GL_STATIC_DRAW);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-        // Setup and enable the vertex position attribute
-        size_t num_vertexPositions = vertexPos.size();
-        glGenBuffers(1, &vboVertexPos);
-        glBindBuffer(GL_ARRAY_BUFFER, vboVertexPos);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * num_vertexPositions, vertexPos.data(), GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-        // Setup and bind the element buffer for face indices
-        size_t num_faces = faces.size();
-        glGenBuffers(1, &eboFacesIndices);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboFacesIndices);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 3 * num_faces , faces.data(), GL_STATIC_DRAW);
-        glBindVertexArray(0);
-
-        // Setup and enable the normal position attribute
-        size_t num_normalPositions = normalPos.size();
-        glGenBuffers(1, &vboNormalPos);
-        glBindBuffer(GL_ARRAY_BUFFER, vboNormalPos);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * num_normalPositions, normalPos.data(), GL_STATIC_DRAW);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_TRUE, 0, (void*)0);
+    // Constructor for the TexturedMesh class. The mesh and texture come from 'assets', which loads each file once
+    // however many meshes use it, and releases what it read from disk once it is on the GPU. Both load in the
+    // background, so the scene is drawn while they load and the mesh appears once it is ready.
+    TexturedMesh(AssetManager& assets, const char* plyFilePath, const char* filePath, ProgramHandle program, bool cullBackfaces = false) {
+        this->program = program;
+        this->cullBackfaces = cullBackfaces;
+
+        // The first load parses the PLY file, reorders triangles for post-transform cache hits, groups them into culling
+        // clusters, reorders vertices for fetch locality and quantizes them; the baked copy keeps all of it
+        pendingMesh = assets.meshAsync<VertexData, TriData>(plyFilePath, readPLYFile, offsetof(VertexData, normal), offsetof(VertexData, texturePoints));
+        pendingTexture = assets.textureAsync(filePath);
     }
 
+    // Moved, never copied, like the GL objects behind its handles
+    TexturedMesh(TexturedMesh&&) = default;
+    TexturedMesh& operator=(TexturedMesh&&) = default;
+    TexturedMesh(const TexturedMesh&) = delete;
+    TexturedMesh& operator=(const TexturedMesh&) = delete;
+
 };
 
 
@@ -638,8 +533,8 @@ int main( int argc, char* argv[]) {
 		glfwTerminate();
 		return -1;
 	}
-    // Load and compile the shaders to create a shader program
-    GLuint shaderProgram =  LoadShaders("WaterShader.vertexshader", "WaterShader.geoshader", "WaterShader.fragmentshader");
+    // Load and compile the shaders to create a shader program, deleted when main() returns
+    GLProgram shaderProgram(LoadShaders("WaterShader.vertexshader", "WaterShader.geoshader", "WaterShader.fragmentshader"));
 
     // Set up the projection matrix using perspective projection
     mat4 Projection = perspective(radians(45.0f), (float)screenW / (float)screenH, 0.1f, 1000.0f);
@@ -681,8 +576,14 @@ int main( int argc, char* argv[]) {
     glUniformMatrix4fv(ModelID, 1, GL_FALSE, &mat4(1.0f)[0][0]);
     glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
 
+    // Loads each file once and shares it between the objects using it; declared before them so it outlives them
+    AssetManager assets;
+
     // Load the shader program for the PLY object
-    GLuint plyShader = LoadShaders("WaterShader.vertexshader", "WaterShader.fragmentshader");
+    ProgramHandle plyProgram = assets.program("WaterShader.vertexshader|WaterShader.fragmentshader", []() {
+        return LoadShaders("WaterShader.vertexshader", "WaterShader.fragmentshader");
+    });
+    GLuint plyShader = plyProgram ? plyProgram->id : 0;
 
     // Set uniform variables for PLY shader program
     GLuint plyspecularColorID = glGetUniformLocation(plyShader, "specularColor");
@@ -734,9 +635,13 @@ int main( int argc, char* argv[]) {
     lightDir = normalize(camera.getPosition());
 
     // Create TexturedMesh objects for the boat, eyes, and head
-    TexturedMesh boat("Assets/boat.ply", "Assets/boat.bmp", plyShader);
-    TexturedMesh head("Assets/head.ply", "Assets/head.bmp", plyShader);
-    TexturedMesh eyes("Assets/eyes.ply", "Assets/eyes.bmp", plyShader);
+    TexturedMesh boat(assets, "Assets/boat.ply", "Assets/boat.bmp", plyProgram);
+    // Clusters facing away are skipped for the head and eyes only; the boat's open hull is seen from inside too
+    TexturedMesh head(assets, "Assets/head.ply", "Assets/head.bmp", plyProgram, true);
+    TexturedMesh eyes(assets, "Assets/eyes.ply", "Assets/eyes.bmp", plyProgram, true);
+    // The objects in view each frame, drawn opaque ones first, grouped by state and front to back
+    DrawQueue objectQueue;
+    bool loading = true; // Until every asset has been uploaded
 
     // Ensure we can capture the escape key being pressed below
     glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
@@ -758,6 +663,13 @@ int main( int argc, char* argv[]) {
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		processInput(window);
 
+        // Upload the assets that finished loading in the background, and report what is resident once all have
+        assets.update();
+        if (loading && assets.pendingLoads() == 0) {
+            assets.printResidency();
+            loading = false;
+        }
+
         // Loads the projection matrix into projection matrix
         glMatrixMode(GL_PROJECTION);
         glPushMatrix();
@@ -783,10 +695,12 @@ int main( int argc, char* argv[]) {
         // Set the uniform variable for the MVP matrix in the shader program.
         glUniformMatrix4fv(plyMatrixID, 1, GL_FALSE, &MVP[0][0]);
 
-        // Draw boat, eyes, and mesh
-		boat.draw(MVP);
-		head.draw(MVP);
-		eyes.draw(MVP);
+        // Draw boat, eyes, and mesh; the queue sorts them by their state and draws the nearest first, with blending off
+        objectQueue.clear();
+		boat.submit(objectQueue, MVP, camera.getViewMatrix());
+		head.submit(objectQueue, MVP, camera.getViewMatrix());
+		eyes.submit(objectQueue, MVP, camera.getViewMatrix());
+        objectQueue.flush();
 
         // Draw the plane
         plane.draw(glfwGetTime(), perspective(radians(45.0f), 1400.0f / 900.0f, 0.1f, 1000.0f), camera.getViewMatrix(), inverse(mat4(1.0f)), lightpos, vec2(1.0f, 1.0f), vec2(0.0f, 0.0f), 16.0f, 16.0f, 0.0f);
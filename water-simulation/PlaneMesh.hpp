@@ -7,6 +7,8 @@
 #include <sstream> // For string stream operations
 #include <stdlib.h> // For general utilities like memory management
 #include <string.h> // For C string manipulation functions
+#include "../common/BmpLoader.hpp" // For loading BMP textures as RGBA8
+#include "../common/GLHandle.hpp" // For GL objects deleted with their owner
 
 using namespace std;
 using namespace glm;
@@ -177,160 +179,11 @@ GLuint LoadShaders(const char* vertex_file_path, const char* geo_file_path, cons
     return ProgramID; // Return the ID
 }
 
-/**
- * Given a file path imagepath, read the data in that bitmapped image
- * and return the raw bytes of color in the data pointer.
- * The width and height of the image are returned in the weight and height pointers,
- * respectively.
- *
- * usage:
- *
- * unsigned char* imageData;
- * unsigned int width, height;
- * loadARGB_BMP("mytexture.bmp", &imageData, &width, &height);
- *
- * Modified from https://github.com/opengl-tutorials/ogl.
- */
-void loadARGB_BMP(const char* imagepath, unsigned char** data, unsigned int* width, unsigned int* height) {
-
-    printf("Reading image %s\n", imagepath);
-
-    // Data read from the header of the BMP file
-    unsigned char header[54];
-    unsigned int dataPos;
-    unsigned int imageSize;
-    // Actual RGBA data
-
-    // Open the file
-    FILE * file = fopen(imagepath,"rb");
-    if (!file){
-        printf("%s could not be opened. Are you in the right directory?\n", imagepath);
-        getchar();
-        return;
-    }
-
-    // Read the header, i.e. the 54 first bytes
-
-    // If less than 54 bytes are read, problem
-    if ( fread(header, 1, 54, file)!=54 ){
-        printf("Not a correct BMP file1\n");
-        fclose(file);
-        return;
-    }
-
-    // Read the information about the image
-    dataPos    = *(int*)&(header[0x0A]);
-    imageSize  = *(int*)&(header[0x22]);
-    *width      = *(int*)&(header[0x12]);
-    *height     = *(int*)&(header[0x16]);
-    // A BMP files always begins with "BM"
-    if ( header[0]!='B' || header[1]!='M' ){
-        printf("Not a correct BMP file2\n");
-        fclose(file);
-        return;
-    }
-    // Make sure this is a 32bpp file
-    if ( *(int*)&(header[0x1E])!=3  ) {
-        printf("Not a correct BMP file3\n");
-        fclose(file);
-        return;
-    }
-    // fprintf(stderr, "header[0x1c]: %d\n", *(int*)&(header[0x1c]));
-    // if ( *(int*)&(header[0x1C])!=32 ) {
-    //     printf("Not a correct BMP file4\n");
-    //     fclose(file);
-    //     return;
-    // }
-
-    // Some BMP files are misformatted, guess missing information
-    if (imageSize==0)    imageSize=(*width)* (*height)*4; // 4 : one byte for each Red, Green, Blue, Alpha component
-    if (dataPos==0)      dataPos=54; // The BMP header is done that way
-
-    // Create a buffer
-    *data = new unsigned char [imageSize];
-
-    if (dataPos != 54) {
-        fread(header, 1, dataPos - 54, file);
-    }
-
-    // Read the actual data from the file into the buffer
-    fread(*data,1,imageSize,file);
-
-    // Everything is in memory now, the file can be closed.
-    fclose (file);
-}
-
-void loadBMP(const char* imagepath, unsigned char** data, unsigned int* width, unsigned int* height) {
-
-    // printf("Reading image %s\n", imagepath);
-
-    // Data read from the header of the BMP file
-    unsigned char header[54];
-    unsigned int dataPos;
-    unsigned int imageSize;
-    // Actual RGB data
-
-    // Open the file
-    FILE * file = fopen(imagepath,"rb");
-    if (!file){
-        printf("%s could not be opened. Are you in the right directory?\n", imagepath);
-        getchar();
-        return;
-    }
-
-    // Read the header, i.e. the 54 first bytes
-
-    // If less than 54 bytes are read, problem
-    if ( fread(header, 1, 54, file)!=54 ){
-        printf("Not a correct BMP file\n");
-        fclose(file);
-        return;
-    }
-    // A BMP files always begins with "BM"
-    if ( header[0]!='B' || header[1]!='M' ){
-        printf("Not a correct BMP file\n");
-        fclose(file);
-        return;
-    }
-    // Make sure this is a 24bpp file
-    if ( *(int*)&(header[0x1E])!=0  ) {
-    	printf("Not a correct BMP file\n");
-	    fclose(file);
-	    return;
-	}
-    if ( *(int*)&(header[0x1C])!=24 ) {
-    	printf("Not a correct BMP file\n");
-	    fclose(file);
-	    return;
-	}
-
-    // Read the information about the image
-    dataPos    = *(int*)&(header[0x0A]);
-    imageSize  = *(int*)&(header[0x22]);
-    *width      = *(int*)&(header[0x12]);
-    *height     = *(int*)&(header[0x16]);
-
-    // Some BMP files are misformatted, guess missing information
-    if (imageSize==0)    imageSize=(*width)* (*height)*3; // 3 : one byte for each Red, Green and Blue component
-    if (dataPos==0)      dataPos=54; // The BMP header is done that way
-
-    // Create a buffer
-    *data = new unsigned char [imageSize];
-
-    // Read the actual data from the file into the buffer
-    fread(*data,1,imageSize,file);
-
-    fprintf(stderr, "Done reading!\n");
-
-    // Everything is in memory now, the file can be closed.
-    fclose (file);
-
-}
 class PlaneMesh {
 private:
-    // IDs for texture resources.
-    GLuint waterTexture, displacementTexture;
-    GLuint shaderProgram; // ID for the GPU shader program.
+    // Texture resources, deleted with the mesh.
+    GLTexture waterTexture, displacementTexture;
+    GLuint shaderProgram; // ID for the GPU shader program, owned by the caller.
     // Uniform variables' locations in the shader.
     GLuint modelLoc, viewLoc, projectionLoc, lightPosLoc, cameraViewPos;
     GLuint waterTextureLoc, displacementTextureLoc, timeLoc;
@@ -339,14 +192,14 @@ private:
 
 
     void setupTextures() {
-        GLuint width, height;  // Variables to store texture dimensions.
-        unsigned char* data;  // Pointer to hold texture data.
+        GLuint width = 0, height = 0;  // Variables to store texture dimensions.
+        vector<unsigned char> data;  // Texture data, RGBA8, reused for both textures.
 
         // Load the water surface texture.
-        loadBMP("Assets/water.bmp", &data, &width, &height);
+        loadBMP("Assets/water.bmp", data, width, height);
 
         // Generate a texture ID and bind it as a 2D texture.
-        glGenTextures(1, &waterTexture);
+        waterTexture = GLTexture::create();
         glBindTexture(GL_TEXTURE_2D, waterTexture);
 
         // Set texture wrapping and filtering modes.
@@ -356,7 +209,7 @@ private:
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
         // Specify the texture image, including level, internal format, dimensions, and pixel data.
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.empty() ? NULL : data.data());
         glGenerateMipmap(GL_TEXTURE_2D);  // Automatically generate mipmaps for the texture.
 
         glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture.
@@ -381,14 +234,11 @@ private:
         // Stop using the shader program.
         glUseProgram(0);
 
-        // Free the memory allocated for the water texture data.
-        free(data);
-
-        // Load the displacement map texture data from a BMP file.
-        loadBMP("Assets/displacement-map1.bmp", &data, &width, &height);
+        // Load the displacement map texture data from a BMP file, into the same buffer.
+        loadBMP("Assets/displacement-map1.bmp", data, width, height);
 
         // Generate a new OpenGL texture object and assign it to 'displacementTexture'.
-        glGenTextures(1, &displacementTexture);
+        displacementTexture = GLTexture::create();
 
         // Bind the newly created 'displacementTexture' as the current 2D texture.
         glBindTexture(GL_TEXTURE_2D, displacementTexture);
@@ -404,7 +254,7 @@ private:
 
         // Upload the texture data to the currently bound texture object.
         // Parameters: target, mipmap level, internal format, width, height, border, format, data type, data pointer.
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.empty() ? NULL : data.data());
         // Automatically generate mipmaps for the currently bound texture.
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -428,20 +278,16 @@ private:
 
         // Stop using the shader program.
         glUseProgram(0);
-
-        // Free the memory allocated for the displacement texture data.
-        free(data);
-
     }
 
     void setupBuffers() {
 
         // Generate a vertex array object (VAO) to store the configuration.
-        glGenVertexArrays(1, &VAO);
+        VAO = GLVertexArray::create();
         // Generate buffer objects for vertex positions (VBO), normals (NBO), and element indices (EBO).
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &NBO);
-        glGenBuffers(1, &EBO);
+        VBO = GLBuffer::create();
+        NBO = GLBuffer::create();
+        EBO = GLBuffer::create();
 
         // Bind the VAO to configure it.
         glBindVertexArray(VAO);
@@ -509,8 +355,9 @@ public:
     vector<float> normals;
     vector<unsigned int> indices;
 
-    // OpenGL IDs for the Vertex Array Object, Vertex Buffer Object, Element Buffer Object, and Normal Buffer Object.
-    GLuint VAO, VBO, EBO, NBO;
+    // OpenGL Vertex Array Object, Vertex Buffer Object, Element Buffer Object, and Normal Buffer Object, deleted with the mesh.
+    GLVertexArray VAO;
+    GLBuffer VBO, EBO, NBO;
 
     // Constructor for the PlaneMesh class.
     PlaneMesh(float min, float max, float stepsize, GLuint shaderProgram) {